@@ -4,6 +4,8 @@
 
 #include "semantics.h"
 
+#include <iostream>
+
 #include "stdext/bindmem.hpp"
 #include "stdext/exception.h"
 
@@ -27,6 +29,8 @@ Semantics::Semantics()
     _graphFunctions["addEdge"] = stdext::bindmem(this, &Semantics::addEdge);
 
     _graphFunctions["v"] = stdext::bindmem(this, &Semantics::query);
+
+    _graphFunctions["memoryStats"] = stdext::bindmem(this, &Semantics::memoryStats);
 }
 
 void Semantics::evaluate(std::shared_ptr<ParseTree> p)
@@ -111,4 +115,9 @@ void Semantics::addEdge(std::shared_ptr<StrGraph> g, std::shared_ptr<ParseTree>
 void Semantics::query(std::shared_ptr<StrGraph>, std::shared_ptr<ParseTree>)
 {
 
-}
\ No newline at end of file
+}
+
+void Semantics::memoryStats(std::shared_ptr<StrGraph> g, std::shared_ptr<ParseTree> t)
+{
+    std::cout << g->memoryStats();
+}
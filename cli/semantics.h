@@ -22,7 +22,7 @@ namespace semantics {
 
     class Semantics {
         using StrGraphConfig = ugly::model::ConfigBuilder<
-            ugly::model::DataCoreConfigBuilder<std::string, std::string>,
+            ugly::model::SymbolDataConfigBuilder,
             ugly::model::StorageConfigBuilder<ugly::storage::SimpleStorage>
         >;
         using StrGraph = ugly::model::PathPropertyGraph< StrGraphConfig >;
@@ -49,5 +49,8 @@ namespace semantics {
     // Query
         void query(std::shared_ptr<StrGraph>, std::shared_ptr<ParseTree>);
 
+    // Introspection
+        void memoryStats(std::shared_ptr<StrGraph>, std::shared_ptr<ParseTree>);
+
     };
 }
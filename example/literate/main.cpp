@@ -23,13 +23,22 @@
  * This is the core of any graph and is relatively flexible. Instead of a value a pointer to an 
  * abstract base type could be used, or one of the mixins that provides better support for diverse
  * types.
+ *
+ * The strings are interned: the graph stores 32-bit `ugly::Symbol`s and each distinct string is kept
+ * once in a shared dictionary. RDF predicates repeat on almost every edge, so this saves most of the
+ * string memory, and comparing two symbols is an integer compare.
  */
 using StrGraphConfig = ugly::model::ConfigBuilder<
-    ugly::model::DataCoreConfigBuilder<std::string, std::string>,
-    ugly::model::StorageConfigBuilder<ugly::storage::SimpleStorage>
+    ugly::model::SymbolDataConfigBuilder,
+    ugly::model::StorageConfigBuilder<ugly::storage::SimpleStorage>,
+    ugly::model::IndexConfigBuilder<true>
 >;
 using StrGraph = ugly::model::PathPropertyGraph< StrGraphConfig >;
 
+/* The optional third parameter configures secondary indexes. Here we enable the unique node data
+ * index, which `findNode` and `requireNode` use automatically, keeping the loader below linear.
+ */
+
 /* TODO For a more complex example we will create a simple tagged record and use it as part of a typed
  * graph. The design of our data model allows for an arbitrary number of orthoganol mixins, though
  * performance may suffer due to memory layout if care is not taken, and mixins must cooperate if
@@ -63,7 +72,8 @@ int main(int argc, char** argv)
                 if (label != nullptr)
                 {
                     auto l = ugly::requireLabel(g, *label);
-                    //g.attachLabel(, l);
+                    g.attachLabel(s, l);
+                    g.attachLabel(o, l);
                 }
                 entry_count++;
             });
@@ -83,24 +93,27 @@ int main(int argc, char** argv)
     {
         auto thor = ugly::findNode(g, "thor");
 
+        // comparing against a symbol made up front avoids a dictionary lookup per edge
+        ugly::Symbol parents("parents"), creator("creator"), licked("licked-into-being");
+
         // thor's parents and grandparents
         auto r_thorsParentsAndGrandparents = ugly::query(&g)
             .v(thor)
-            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .out( [&](auto n, auto e) { return e->data == parents; } )
             .as("parent")
-            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .out( [&](auto n, auto e) { return e->data == parents; } )
             .as("grand-parent")
             .merge({ "parent", "grand-parent" })
             .unique()
             .run();
 
-        std::cout << fmt::format("Thor's parents and grand-parents: {0}.", r_thorsParentsAndGrandparents[0]->data) << std::endl;
+        std::cout << fmt::format("Thor's parents and grand-parents: {0}.", r_thorsParentsAndGrandparents[0]->data.str()) << std::endl;
 
         // thor is related to someone licked into being
         auto r_thorsWeirdCousin = ugly::query(&g)
             .v(ugly::findNode(g, "thor"))
             .repeat_breadth(
-                [](auto _) { return _.out( [](auto e) { return e->data == "parents"; } ); },
+                [&](auto _) { return _.out( [&](auto e) { return e->data == parents; } ); },
                 [&](auto n) { return true; },
                 [&](auto n, auto r)
                 {
@@ -108,20 +121,20 @@ int main(int argc, char** argv)
                     bool found = false;
                     g.forEdgesOnNode(n, [&](auto e)
                     {
-                        if (e->data != "creator") return true;
+                        if (e->data != creator) return true;
                         g.forPropsOnEdge(e, [&](auto p)
                         {
-                            found = p->data == "licked-into-being";
+                            found = p->data == licked;
                             return !found;
                         });
                         return !found;
                     });
-                    g.forPropsOnNode(n, [&](auto p) { return !(found = p->data == "licked-into-being"); });
+                    g.forPropsOnNode(n, [&](auto p) { return !(found = p->data == licked); });
                     return found;
                 })
             .run();
 
-        std::cout << fmt::format("Thor's weird cousin: {0}.", r_thorsWeirdCousin[0]->data) << std::endl;
+        std::cout << fmt::format("Thor's weird cousin: {0}.", r_thorsWeirdCousin[0]->data.str()) << std::endl;
     }
     catch (std::exception const& ex)
     {
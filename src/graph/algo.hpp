@@ -35,6 +35,9 @@ namespace ugly
     template<typename TGraph>
     typename TGraph::Node const* findNode(TGraph const& g, typename TGraph::NodeData const& v)
     {
+        if constexpr (TGraph::hasNodeDataIndex)
+            return g.findIndexedNode(v);
+
         typename TGraph::Node const* res = nullptr;
         g.forAllNodes([&](auto n)
         {
@@ -0,0 +1,416 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+
+namespace ugly
+{
+    // A compressed set of 32-bit values in the style of roaring bitmaps. Values are grouped into
+    // containers by their high 16 bits, sparse containers are sorted arrays of the low bits and
+    // dense ones are bitsets.
+    class Bitmap
+    {
+    protected:
+        static constexpr size_t _arrayLimit = 4096;
+        static constexpr size_t _bitsetWords = 1024;
+
+        struct _Container
+        {
+            uint16_t _key;
+            uint32_t _cardinality = 0;
+
+            // exactly one of these is in use, `_bits` once the container is dense
+            std::vector<uint16_t> _array;
+            std::vector<uint64_t> _bits;
+
+            inline bool dense() const { return !_bits.empty(); }
+
+            inline bool contains(uint16_t low) const
+            {
+                if (dense())
+                    return (_bits[low >> 6] >> (low & 63)) & 1;
+                return std::binary_search(_array.begin(), _array.end(), low);
+            }
+
+            inline bool add(uint16_t low)
+            {
+                if (dense())
+                {
+                    auto& word = _bits[low >> 6];
+                    auto mask = uint64_t(1) << (low & 63);
+                    if (word & mask)
+                        return false;
+                    word |= mask;
+                    ++_cardinality;
+                    return true;
+                }
+
+                auto it = std::lower_bound(_array.begin(), _array.end(), low);
+                if (it != _array.end() && *it == low)
+                    return false;
+                _array.insert(it, low);
+                ++_cardinality;
+
+                if (_array.size() > _arrayLimit)
+                    _toBitset();
+                return true;
+            }
+
+            inline bool remove(uint16_t low)
+            {
+                if (dense())
+                {
+                    auto& word = _bits[low >> 6];
+                    auto mask = uint64_t(1) << (low & 63);
+                    if (!(word & mask))
+                        return false;
+                    word &= ~mask;
+                    --_cardinality;
+
+                    if (_cardinality <= _arrayLimit)
+                        _toArray();
+                    return true;
+                }
+
+                auto it = std::lower_bound(_array.begin(), _array.end(), low);
+                if (it == _array.end() || *it != low)
+                    return false;
+                _array.erase(it);
+                --_cardinality;
+                return true;
+            }
+
+            // Picks the representation for the cardinality, after bulk operations.
+            inline void normalize()
+            {
+                if (dense() && _cardinality <= _arrayLimit)
+                    _toArray();
+                else if (!dense() && _cardinality > _arrayLimit)
+                    _toBitset();
+            }
+
+            inline void _toBitset()
+            {
+                _bits.assign(_bitsetWords, 0);
+                for (auto low : _array)
+                    _bits[low >> 6] |= uint64_t(1) << (low & 63);
+                _array.clear();
+                _array.shrink_to_fit();
+            }
+
+            inline void _toArray()
+            {
+                std::vector<uint16_t> array;
+                array.reserve(_cardinality);
+                for (size_t i = 0; i < _bitsetWords; ++i)
+                {
+                    for (auto word = _bits[i]; word != 0; word &= word - 1)
+                        array.push_back((uint16_t)(i * 64 + _countTrailingZeros(word)));
+                }
+                _array.swap(array);
+                _bits.clear();
+                _bits.shrink_to_fit();
+            }
+        };
+
+        std::vector<_Container> _containers;
+
+    public:
+        class const_iterator
+        {
+            Bitmap const* _bitmap;
+            size_t _container;
+            uint32_t _low;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = uint32_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = uint32_t const*;
+            using reference = uint32_t;
+
+            inline const_iterator()
+                : _bitmap(nullptr), _container(0), _low(0)
+            { }
+            inline const_iterator(Bitmap const* bitmap, size_t container)
+                : _bitmap(bitmap), _container(container), _low(0)
+            {
+                _settle();
+            }
+
+            inline reference operator*() const
+            {
+                auto& container = _bitmap->_containers[_container];
+                uint32_t low = container.dense() ? _low : container._array[_low];
+                return ((uint32_t)container._key << 16) | low;
+            }
+
+            inline const_iterator& operator++()
+            {
+                ++_low;
+                _settle();
+                return *this;
+            }
+            inline const_iterator operator++(int)
+            {
+                const_iterator res = *this;
+                ++*this;
+                return res;
+            }
+
+            inline bool operator==(const_iterator const& that) const { return _container == that._container && _low == that._low; }
+            inline bool operator!=(const_iterator const& that) const { return !(*this == that); }
+
+        private:
+            // Moves to the next value at or after the current position, or to the end.
+            inline void _settle()
+            {
+                auto& containers = _bitmap->_containers;
+                while (_container < containers.size())
+                {
+                    auto& container = containers[_container];
+                    if (container.dense())
+                    {
+                        while (_low < 65536)
+                        {
+                            auto word = container._bits[_low >> 6] >> (_low & 63);
+                            if (word != 0)
+                            {
+                                _low += _countTrailingZeros(word);
+                                return;
+                            }
+                            _low = (_low | 63) + 1;
+                        }
+                    }
+                    else if (_low < container._array.size())
+                        return;
+
+                    ++_container;
+                    _low = 0;
+                }
+            }
+        };
+
+        using iterator = const_iterator;
+
+    public:
+        inline bool add(uint32_t value)
+        {
+            return _findOrInsert((uint16_t)(value >> 16)).add((uint16_t)value);
+        }
+
+        inline bool remove(uint32_t value)
+        {
+            auto it = _find((uint16_t)(value >> 16));
+            if (it == _containers.end() || !it->remove((uint16_t)value))
+                return false;
+
+            if (it->_cardinality == 0)
+                _containers.erase(it);
+            return true;
+        }
+
+        inline bool contains(uint32_t value) const
+        {
+            auto it = const_cast<Bitmap*>(this)->_find((uint16_t)(value >> 16));
+            return it != _containers.end() && it->contains((uint16_t)value);
+        }
+
+        inline size_t cardinality() const
+        {
+            size_t res = 0;
+            for (auto& container : _containers)
+                res += container._cardinality;
+            return res;
+        }
+
+        inline bool empty() const { return _containers.empty(); }
+        inline void clear() { _containers.clear(); }
+
+        // The bytes held by the containers, counting their capacity.
+        inline size_t memoryBytes() const
+        {
+            size_t res = _containers.capacity() * sizeof(_Container);
+            for (auto& container : _containers)
+                res += container._array.capacity() * sizeof(uint16_t) + container._bits.capacity() * sizeof(uint64_t);
+            return res;
+        }
+
+        inline const_iterator begin() const { return const_iterator(this, 0); }
+        inline const_iterator end() const { return const_iterator(this, _containers.size()); }
+
+        template<typename Func>
+        inline void forEach(Func func) const
+        {
+            for (auto value : *this)
+                func(value);
+        }
+
+    // set operations
+    public:
+        inline Bitmap& operator&=(Bitmap const& that)
+        {
+            std::vector<_Container> res;
+            auto a = _containers.begin();
+            auto b = that._containers.begin();
+            while (a != _containers.end() && b != that._containers.end())
+            {
+                if (a->_key < b->_key)
+                    ++a;
+                else if (b->_key < a->_key)
+                    ++b;
+                else
+                {
+                    auto container = _intersect(*a, *b);
+                    if (container._cardinality != 0)
+                        res.push_back(std::move(container));
+                    ++a;
+                    ++b;
+                }
+            }
+            _containers.swap(res);
+            return *this;
+        }
+
+        inline Bitmap& operator|=(Bitmap const& that)
+        {
+            std::vector<_Container> res;
+            auto a = _containers.begin();
+            auto b = that._containers.begin();
+            while (a != _containers.end() || b != that._containers.end())
+            {
+                if (b == that._containers.end() || (a != _containers.end() && a->_key < b->_key))
+                    res.push_back(std::move(*(a++)));
+                else if (a == _containers.end() || b->_key < a->_key)
+                    res.push_back(*(b++));
+                else
+                    res.push_back(_unite(*(a++), *(b++)));
+            }
+            _containers.swap(res);
+            return *this;
+        }
+
+        friend inline Bitmap operator&(Bitmap lhs, Bitmap const& rhs) { return lhs &= rhs; }
+        friend inline Bitmap operator|(Bitmap lhs, Bitmap const& rhs) { return lhs |= rhs; }
+
+    // helpers
+    protected:
+        static inline uint32_t _countTrailingZeros(uint64_t word)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return (uint32_t)__builtin_ctzll(word);
+#else
+            uint32_t res = 0;
+            while (!(word & 1))
+            {
+                word >>= 1;
+                ++res;
+            }
+            return res;
+#endif
+        }
+
+        inline std::vector<_Container>::iterator _find(uint16_t key)
+        {
+            auto it = std::lower_bound(_containers.begin(), _containers.end(), key,
+                [](_Container const& container, uint16_t key) { return container._key < key; });
+            return (it != _containers.end() && it->_key == key) ? it : _containers.end();
+        }
+
+        inline _Container& _findOrInsert(uint16_t key)
+        {
+            auto it = std::lower_bound(_containers.begin(), _containers.end(), key,
+                [](_Container const& container, uint16_t key) { return container._key < key; });
+            if (it == _containers.end() || it->_key != key)
+            {
+                it = _containers.insert(it, _Container());
+                it->_key = key;
+            }
+            return *it;
+        }
+
+        static inline _Container _intersect(_Container const& a, _Container const& b)
+        {
+            _Container res;
+            res._key = a._key;
+
+            if (a.dense() && b.dense())
+            {
+                res._bits.resize(_bitsetWords);
+                for (size_t i = 0; i < _bitsetWords; ++i)
+                {
+                    res._bits[i] = a._bits[i] & b._bits[i];
+                    res._cardinality += (uint32_t)_popCount(res._bits[i]);
+                }
+                res.normalize();
+            }
+            else if (a.dense() || b.dense())
+            {
+                auto& array = a.dense() ? b._array : a._array;
+                auto& bitset = a.dense() ? a : b;
+                for (auto low : array)
+                {
+                    if (bitset.contains(low))
+                        res._array.push_back(low);
+                }
+                res._cardinality = (uint32_t)res._array.size();
+            }
+            else
+            {
+                std::set_intersection(a._array.begin(), a._array.end(), b._array.begin(), b._array.end(), std::back_inserter(res._array));
+                res._cardinality = (uint32_t)res._array.size();
+            }
+            return res;
+        }
+
+        static inline _Container _unite(_Container const& a, _Container const& b)
+        {
+            _Container res;
+            res._key = a._key;
+
+            if (!a.dense() && !b.dense() && a._array.size() + b._array.size() <= _arrayLimit)
+            {
+                std::set_union(a._array.begin(), a._array.end(), b._array.begin(), b._array.end(), std::back_inserter(res._array));
+                res._cardinality = (uint32_t)res._array.size();
+                return res;
+            }
+
+            res._bits.assign(_bitsetWords, 0);
+            for (auto const* container : { &a, &b })
+            {
+                if (container->dense())
+                {
+                    for (size_t i = 0; i < _bitsetWords; ++i)
+                        res._bits[i] |= container->_bits[i];
+                }
+                else
+                {
+                    for (auto low : container->_array)
+                        res._bits[low >> 6] |= uint64_t(1) << (low & 63);
+                }
+            }
+            for (auto word : res._bits)
+                res._cardinality += (uint32_t)_popCount(word);
+            res.normalize();
+            return res;
+        }
+
+        static inline size_t _popCount(uint64_t word)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return (size_t)__builtin_popcountll(word);
+#else
+            size_t res = 0;
+            for (; word != 0; word &= word - 1)
+                ++res;
+            return res;
+#endif
+        }
+    };
+}
@@ -21,4 +21,5 @@ namespace filter
 
 #include "constant.hpp"
 #include "value.hpp"
+#include "prop.hpp"
 
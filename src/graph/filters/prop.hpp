@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <optional>
+#include <type_traits>
+
+#include "filters.hpp"
+
+namespace ugly {
+namespace filter
+{
+    template<typename TKey, typename TValue>
+    struct PropFilterGeneric
+    {
+    protected:
+        std::decay_t<TKey> _key;
+        std::optional<std::decay_t<TValue>> _value;
+
+        template<typename TGraph>
+        friend struct PropFilterSpecialized;
+
+    public:
+        inline PropFilterGeneric(std::decay_t<TKey> key, std::optional<std::decay_t<TValue>> value)
+            : _key(std::move(key)), _value(std::move(value))
+        {
+
+        }
+    };
+
+    // Filters nodes on a keyed prop, reading the prop's column instead of the node's prop list.
+    template<typename TGraph>
+    struct PropFilterSpecialized
+    {
+    protected:
+        typename TGraph::PropKey _key;
+        std::optional<typename TGraph::PropData> _value;
+
+        // keys are interned once a node has them, looked up until then
+        typename TGraph::PropKeyId _keyId = TGraph::noPropKey;
+
+    public:
+        template<typename TKey, typename TValue>
+        inline PropFilterSpecialized(PropFilterGeneric<TKey, TValue> && filter)
+            : _key(std::move(filter._key))
+        {
+            if (filter._value)
+                _value = std::move(*filter._value);
+        }
+
+    public:
+        inline bool operator()(TGraph const* graph, typename TGraph::Node const* node)
+        {
+            if (_keyId == TGraph::noPropKey)
+            {
+                _keyId = graph->findPropKey(_key);
+                if (_keyId == TGraph::noPropKey)
+                    return false;
+            }
+
+            auto data = graph->getPropWithKeyId(node, _keyId);
+            return data != nullptr && (!_value || *data == *_value);
+        }
+    };
+
+    template<typename TKey, typename TValue>
+    PropFilterGeneric<TKey, TValue> byProp(TKey && key, TValue && value)
+    {
+        return PropFilterGeneric<TKey, TValue>(std::forward<TKey>(key), std::forward<TValue>(value));
+    }
+
+    template<typename TKey>
+    PropFilterGeneric<TKey, TKey> hasProp(TKey && key)
+    {
+        return PropFilterGeneric<TKey, TKey>(std::forward<TKey>(key), std::nullopt);
+    }
+
+    template<typename TGraph, typename TKey, typename TValue>
+    struct specialize_filter<TGraph, PropFilterGeneric<TKey, TValue>>
+    {
+        using type = PropFilterSpecialized<TGraph>;
+
+        static inline PropFilterSpecialized<TGraph> specialize(PropFilterGeneric<TKey, TValue> && t)
+        {
+            return PropFilterSpecialized<TGraph>(std::move(t));
+        }
+    };
+}}
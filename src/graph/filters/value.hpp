@@ -47,12 +47,28 @@ namespace filter
         }
 
     public:
+        inline typename TGraph::EdgeData const& value() const
+        {
+            return _value;
+        }
+
         inline bool operator()(typename TGraph::Edge const* c)
         {
             return c->data == _value;
         }
     };
 
+    // Recognizes specialized value filters, e.g. so edge pipes can use the edge partition index.
+    template<typename TType>
+    struct is_value_filter
+        : std::false_type
+    { };
+
+    template<typename TGraph>
+    struct is_value_filter<ValueFilterSpecialized<TGraph>>
+        : std::true_type
+    { };
+
     template<typename TType>
     ValueFilterGeneric<TType> byValue(TType && v)
     {
@@ -0,0 +1,91 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <string>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+#include "graph/util.hpp"
+#include "graph/symbol.hpp"
+#include "config.hpp"
+
+namespace ugly {
+namespace model
+{
+    // How graph data is written to binary snapshots. Trivially copyable data is written as is,
+    // specialize this for other data types.
+    template<typename T, typename = void>
+    struct BinaryCodec
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Graph data needs a BinaryCodec specialization.");
+
+        static inline void write(std::ostream& out, T const& value)
+        {
+            out.write((char const*)&value, sizeof(T));
+        }
+
+        static inline T read(std::istream& in)
+        {
+            T value;
+            in.read((char*)&value, sizeof(T));
+            return value;
+        }
+    };
+
+    template<>
+    struct BinaryCodec<Empty>
+    {
+        static inline void write(std::ostream& out, Empty const& value) { }
+        static inline Empty read(std::istream& in) { return Empty(); }
+    };
+
+    template<typename TChar, typename TTraits, typename TAlloc>
+    struct BinaryCodec<std::basic_string<TChar, TTraits, TAlloc>>
+    {
+        using String = std::basic_string<TChar, TTraits, TAlloc>;
+
+        static inline void write(std::ostream& out, String const& value)
+        {
+            BinaryCodec<uint64_t>::write(out, (uint64_t)value.size());
+            out.write((char const*)value.data(), value.size() * sizeof(TChar));
+        }
+
+        static inline String read(std::istream& in)
+        {
+            auto size = BinaryCodec<uint64_t>::read(in);
+            if (!in)
+                return String();
+
+            String value;
+            // grow as the data arrives, a corrupt size must not allocate up front
+            const size_t chunk = 4096;
+            for (uint64_t done = 0; done < size && in; done += chunk)
+            {
+                auto part = (size_t)std::min<uint64_t>(chunk, size - done);
+                auto at = value.size();
+                value.resize(at + part);
+                in.read((char*)(value.data() + at), part * sizeof(TChar));
+            }
+            return value;
+        }
+    };
+
+    // Symbols are written as their strings, ids differ between processes.
+    template<>
+    struct BinaryCodec<Symbol>
+    {
+        static inline void write(std::ostream& out, Symbol const& value)
+        {
+            BinaryCodec<std::string>::write(out, value.str());
+        }
+
+        static inline Symbol read(std::istream& in)
+        {
+            return Symbol(BinaryCodec<std::string>::read(in));
+        }
+    };
+}}
@@ -0,0 +1,364 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <functional>
+
+#include "graph/util.hpp"
+
+/*
+ * This file contains the bulk loader, which adds large batches to a graph at once:
+ * - Nodes, edges, and props are buffered, edges and props refer to nodes by caller chosen local
+ *   ids (and props on edges to edges by the number `addEdge` returned).
+ * - `build()` resolves the nodes first: a local id added twice keeps its first node, and with the
+ *   node data index a node whose data is already in the graph (or earlier in the batch) is reused.
+ * - On storages supporting it the edges are then made without touching the nodes, the slots are
+ *   counted per node, and each node's edge list is built in a single exactly sized allocation.
+ *   Other storages add the edges one by one.
+ * - The counting is split across worker threads: each takes a chunk of the edges and buckets their
+ *   slots by the worker owning the slot's node, then each worker counts, prefix sums, and scatters
+ *   the slots of its own nodes. No two workers write the same node, and the result does not depend
+ *   on the number of workers.
+ *
+ * Local ids stay resolved across batches, later batches can connect nodes of earlier ones.
+ */
+
+namespace ugly {
+namespace model
+{
+    template<typename TGraph>
+    class GraphBulkLoader
+    {
+    public:
+        using Graph = TGraph;
+        using Node = typename TGraph::Node;
+        using Edge = typename TGraph::Edge;
+        using Prop = typename TGraph::Prop;
+        using NodeData = typename TGraph::NodeData;
+        using EdgeData = typename TGraph::EdgeData;
+        using PropData = typename TGraph::PropData;
+
+        using LocalId = uint64_t;
+
+    protected:
+        struct _Edge
+        {
+            EdgeData _data;
+            bool _inverted;
+            // range into `_edgeNodes`
+            size_t _nodes;
+            size_t _nodesEnd;
+        };
+
+        // an edge on one of its nodes, during the parallel passes
+        struct _Slot
+        {
+            Node const* _node;
+            void* _edge;
+            bool _outgoing;
+        };
+
+        TGraph& _graph;
+
+        std::vector<std::pair<LocalId, NodeData>> _nodes;
+        std::vector<_Edge> _edges;
+        std::vector<LocalId> _edgeNodes;
+        std::vector<std::pair<LocalId, PropData>> _nodeProps;
+        std::vector<std::pair<size_t, PropData>> _edgeProps;
+
+        std::unordered_map<LocalId, Node*> _resolved;
+
+    public:
+        inline GraphBulkLoader(TGraph& graph)
+            : _graph(graph)
+        { }
+
+        inline GraphBulkLoader(GraphBulkLoader const&) = delete;
+
+        inline TGraph& graph() const
+        {
+            return _graph;
+        }
+
+    // batching
+    public:
+        inline void reserve(size_t nodes, size_t edges, size_t slots = 0, size_t props = 0)
+        {
+            _nodes.reserve(nodes);
+            _edges.reserve(edges);
+            _edgeNodes.reserve(slots);
+            _nodeProps.reserve(props);
+        }
+
+        inline void addNode(LocalId id, NodeData const& data)
+        {
+            _nodes.emplace_back(id, data);
+        }
+
+        // Returns the number of the edge in this batch, for `addEdgeProp`.
+        inline size_t addEdge(EdgeData const& data, std::vector<LocalId> const& nodes, bool invert = false)
+        {
+            if (nodes.size() < 2)
+                throw graph_error("Edges must connect at least two nodes.");
+
+            auto begin = _edgeNodes.size();
+            _edgeNodes.insert(_edgeNodes.end(), nodes.begin(), nodes.end());
+            _edges.push_back(_Edge { data, invert, begin, _edgeNodes.size() });
+
+            return _edges.size() - 1;
+        }
+
+        inline void addNodeProp(LocalId id, PropData const& data)
+        {
+            _nodeProps.emplace_back(id, data);
+        }
+
+        inline void addEdgeProp(size_t edge, PropData const& data)
+        {
+            _edgeProps.emplace_back(edge, data);
+        }
+
+        inline bool empty() const
+        {
+            return _nodes.empty() && _edges.empty() && _nodeProps.empty() && _edgeProps.empty();
+        }
+
+    // resolving
+    public:
+        // The node a local id was resolved to by an earlier `build()`, or null.
+        inline Node* resolve(LocalId id) const
+        {
+            auto it = _resolved.find(id);
+            return it != _resolved.end() ? it->second : nullptr;
+        }
+
+    // building
+    public:
+        // Adds the batch to the graph and starts a new one. The batch is checked before anything is
+        // added, an edge or prop referring to an unknown local id (or edge) throws and keeps it.
+        // With bulk adjacency the edge lists are built by `threads` workers, 0 uses every core.
+        inline void build(size_t threads = 1)
+        {
+            if (threads == 0)
+                threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+            _check();
+
+            _buildNodes();
+            auto edges = _buildEdges(threads);
+            _buildProps(edges);
+
+            _nodes.clear();
+            _edges.clear();
+            _edgeNodes.clear();
+            _nodeProps.clear();
+            _edgeProps.clear();
+        }
+
+    protected:
+        inline void _check() const
+        {
+            std::unordered_set<LocalId> pending;
+            for (auto& node : _nodes)
+                pending.insert(node.first);
+
+            auto require = [&](LocalId id)
+            {
+                if (_resolved.find(id) == _resolved.end() && pending.find(id) == pending.end())
+                    throw graph_error("Bulk load refers to an unknown node.");
+            };
+
+            for (auto id : _edgeNodes)
+                require(id);
+            for (auto& prop : _nodeProps)
+                require(prop.first);
+            for (auto& prop : _edgeProps)
+                if (prop.first >= _edges.size())
+                    throw graph_error("Bulk load refers to an unknown edge.");
+        }
+
+        inline void _buildNodes()
+        {
+            _resolved.reserve(_resolved.size() + _nodes.size());
+
+            for (auto& node : _nodes)
+            {
+                if (_resolved.find(node.first) != _resolved.end())
+                    continue;
+
+                Node* ref = nullptr;
+                if constexpr (TGraph::hasNodeDataIndex)
+                    ref = const_cast<Node*>(_graph.findIndexedNode(node.second));
+                if (ref == nullptr)
+                    ref = _graph.addNode(node.second);
+
+                _resolved.emplace(node.first, ref);
+            }
+        }
+
+        // Runs `func(0)` to `func(threads - 1)`, the first on the calling thread.
+        template<typename Func>
+        static inline void _parallel(size_t threads, Func func)
+        {
+            std::vector<std::thread> workers;
+            workers.reserve(threads - 1);
+            for (size_t t = 1; t < threads; ++t)
+                workers.emplace_back(func, t);
+
+            func(0);
+
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        // The worker owning a node, pointers are mixed so neighboring nodes spread out.
+        static inline size_t _owner(Node const* node, size_t threads)
+        {
+            return (size_t)((std::hash<Node const*>()(node) * 0x9E3779B97F4A7C15ull) >> 32) % threads;
+        }
+
+        inline std::vector<Edge*> _buildEdges(size_t threads)
+        {
+            std::vector<Edge*> edges;
+            edges.reserve(_edges.size());
+
+            if constexpr (TGraph::hasBulkAdjacency)
+            {
+                auto& storage = _graph._storage;
+                using Store = std::decay_t<decltype(storage)>;
+
+                // the primary store is not thread safe, the edges are made up front
+                for (auto& edge : _edges)
+                {
+                    Edge* ref = storage.template makeEdge<Edge>(edge._data);
+                    ref->inverted = edge._inverted;
+                    edges.push_back(ref);
+                }
+
+                threads = std::max<size_t>(1, std::min(threads, _edges.size()));
+
+                // partition pass: worker `c` takes a contiguous chunk of edges, sets their nodes, and
+                // sorts their slots into buckets by the worker owning the slot's node
+                std::vector<std::vector<std::vector<_Slot>>> buckets(threads, std::vector<std::vector<_Slot>>(threads));
+                _parallel(threads, [&](size_t c)
+                {
+                    std::vector<Node const*> nodes;
+                    auto& chunk_buckets = buckets[c];
+                    for (auto e = _edges.size() * c / threads, end = _edges.size() * (c + 1) / threads; e < end; ++e)
+                    {
+                        auto& edge = _edges[e];
+                        nodes.clear();
+                        for (auto i = edge._nodes; i < edge._nodesEnd; ++i)
+                            nodes.push_back(_resolved.find(_edgeNodes[i])->second);
+
+                        storage.setEdgeListOfNodesOnly(edges[e], edges[e]->store, nodes.begin(), nodes.end());
+
+                        for (size_t i = 0; i < nodes.size(); ++i)
+                            chunk_buckets[_owner(nodes[i], threads)].push_back(_Slot { nodes[i], (void*)edges[e], Store::isOutgoingSlot(i == 0, edge._inverted) });
+                    }
+                });
+
+                // count, prefix sum, and scatter pass: worker `t` owns a set of nodes and walks the
+                // buckets in chunk order, so every node lists its new edges in the order they were added
+                _parallel(threads, [&](size_t t)
+                {
+                    std::unordered_map<Node const*, size_t> touched;
+                    std::vector<Node const*> touched_nodes;
+                    std::vector<size_t> out_offsets, in_offsets;
+
+                    for (auto& chunk_buckets : buckets)
+                        for (auto& slot : chunk_buckets[t])
+                        {
+                            auto inserted = touched.emplace(slot._node, touched_nodes.size());
+                            if (inserted.second)
+                            {
+                                touched_nodes.push_back(slot._node);
+                                out_offsets.push_back(0);
+                                in_offsets.push_back(0);
+                            }
+                            ++(slot._outgoing ? out_offsets : in_offsets)[inserted.first->second];
+                        }
+
+                    // counts to offsets into one flat array per role
+                    size_t out_total = 0, in_total = 0;
+                    for (size_t i = 0; i < touched_nodes.size(); ++i)
+                    {
+                        out_total += std::exchange(out_offsets[i], out_total);
+                        in_total += std::exchange(in_offsets[i], in_total);
+                    }
+                    out_offsets.push_back(out_total);
+                    in_offsets.push_back(in_total);
+
+                    std::vector<void*> out_edges(out_total), in_edges(in_total);
+                    std::vector<size_t> out_cursors(out_offsets.begin(), out_offsets.end() - 1), in_cursors(in_offsets.begin(), in_offsets.end() - 1);
+                    for (auto& chunk_buckets : buckets)
+                        for (auto& slot : chunk_buckets[t])
+                        {
+                            auto i = touched.find(slot._node)->second;
+                            if (slot._outgoing)
+                                out_edges[out_cursors[i]++] = slot._edge;
+                            else
+                                in_edges[in_cursors[i]++] = slot._edge;
+                        }
+
+                    for (size_t i = 0; i < touched_nodes.size(); ++i)
+                    {
+                        storage.appendNodeListOfEdges(
+                            touched_nodes[i], touched_nodes[i]->store,
+                            out_edges.data() + out_offsets[i], out_edges.data() + out_offsets[i + 1],
+                            in_edges.data() + in_offsets[i], in_edges.data() + in_offsets[i + 1]
+                        );
+                    }
+                });
+
+                for (auto edge : edges)
+                {
+                    auto nodes = storage.template getEdgeListOfNodes<Node>(edge, edge->store);
+                    _graph._indexEdge(edge, nodes.begin(), nodes.end());
+                }
+
+                _graph._commit();
+            }
+            else
+            {
+                std::vector<Node const*> nodes;
+                for (auto& edge : _edges)
+                {
+                    nodes.clear();
+                    for (auto i = edge._nodes; i < edge._nodesEnd; ++i)
+                        nodes.push_back(_resolved.find(_edgeNodes[i])->second);
+
+                    edges.push_back(_graph.addEdge(edge._data, nodes, edge._inverted));
+                }
+            }
+
+            return edges;
+        }
+
+        inline void _buildProps(std::vector<Edge*> const& edges)
+        {
+            if constexpr (TGraph::hasBulkAdjacency)
+            {
+                std::unordered_map<Node const*, size_t> counts;
+                for (auto& prop : _nodeProps)
+                    ++counts[_resolved.find(prop.first)->second];
+                for (auto& count : counts)
+                    _graph._storage.reserveNodeListOfProps(count.first, count.first->store, count.second);
+            }
+
+            for (auto& prop : _nodeProps)
+                _graph.addProp(prop.second, _resolved.find(prop.first)->second);
+            for (auto& prop : _edgeProps)
+                _graph.addProp(prop.second, edges[prop.first]);
+        }
+    };
+}}
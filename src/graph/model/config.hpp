@@ -9,6 +9,7 @@
 #include <string>
 
 #include "../util.hpp"
+#include "../symbol.hpp"
 
 namespace ugly {
 namespace model
@@ -28,6 +29,10 @@ namespace model
         using PropKey = TPropKeyData;
     };
 
+    // String data stored as interned 32-bit symbols, repeated strings (e.g. predicates) are stored
+    // once in the global `SymbolTable`.
+    using SymbolDataConfigBuilder = DataCoreConfigBuilder<Symbol, Symbol>;
+
     template<typename TPropData, typename TPropKeyData, typename TOtherData=Empty>
     struct DataPropDataConfigBuilder
     {
@@ -47,10 +52,28 @@ namespace model
         using Store = TStore;
     };
 
-    template<typename TDataConfig, typename TStorageConfig>
+    // Secondary indexes maintained by the graph, all off by default.
+    // - `TNodeData`: a unique hash index from node data to node (requires `std::hash` of the data).
+    // - `TEdgePartitions`: edges on each node grouped by interned edge data (requires `std::hash` of
+    //   the data), used by value filtered traversals.
+    // - `TPropValues`: nodes ordered by the data of their props (requires `operator<` of the data),
+    //   and by keyed prop value per key, used by equality, range, and prefix lookups.
+    // - `TEdgeData`: the edges carrying each edge data (requires `std::hash` of the data), used to
+    //   start from every edge of one kind.
+    template<bool TNodeData = false, bool TEdgePartitions = false, bool TPropValues = false, bool TEdgeData = false>
+    struct IndexConfigBuilder
+    {
+        static constexpr bool NodeData = TNodeData;
+        static constexpr bool EdgePartitions = TEdgePartitions;
+        static constexpr bool PropValues = TPropValues;
+        static constexpr bool EdgeData = TEdgeData;
+    };
+
+    template<typename TDataConfig, typename TStorageConfig, typename TIndexConfig = IndexConfigBuilder<>>
     struct ConfigBuilder
     {
         using Data = TDataConfig;
         using Storage = TStorageConfig;
+        using Index = TIndexConfig;
     };
 }}
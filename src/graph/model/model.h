@@ -7,4 +7,10 @@
 #include "config.hpp"
 
 #include "ppg_model.hpp"
+#include "snapshot.hpp"
+#include "bulk_loader.hpp"
+
+#ifndef _WIN32
+#include "write_ahead_log.hpp"
+#endif
 
@@ -7,13 +7,43 @@
 #include <vector>
 #include <deque>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <type_traits>
+#include <limits>
+#include <tuple>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <istream>
+#include <ostream>
 
 #include "graph/util.hpp"
+#include "graph/bitmap.hpp"
 #include "graph/storage/storage.h"
+#include "config.hpp"
+#include "binary.hpp"
+#include "prop_column.hpp"
+#include "bulk_loader.hpp"
 
 namespace ugly {
 namespace model
 {
+    template <typename TGraph>
+    class GraphSnapshot;
+
+    // The node layouts `reorder()` can produce.
+    enum class NodeOrder
+    {
+        // breadth first from each node not reached yet, in the current order
+        BreadthFirst,
+        // breadth first from the lowest degree nodes, neighbors by ascending degree, reversed
+        ReverseCuthillMcKee,
+        // highest degree first, hubs end up together
+        DegreeDescending
+    };
+
     template <typename TConfig>
     class PathPropertyGraph
     {
@@ -23,6 +53,7 @@ namespace model
         using PathData = typename TConfig::Data::Path; 
         using LabelData = typename TConfig::Data::Label; 
         using PropData = typename TConfig::Data::Prop; 
+        using PropKey = typename TConfig::Data::PropKey;
 
     public:
         struct Node
@@ -33,7 +64,7 @@ namespace model
             Store store;
 
             Node(NodeData const& data, Store && store)
-                : data(data), store(store)
+                : data(data), store(std::move(store))
             { }
         };
         struct Edge
@@ -45,7 +76,7 @@ namespace model
             bool inverted;
 
             Edge(EdgeData const& data, Store && store)
-                : data(data), store(store), inverted(false)
+                : data(data), store(std::move(store)), inverted(false)
             { }
         };
         struct Path
@@ -56,7 +87,7 @@ namespace model
             Store store;
 
             Path(PathData const& data, Store && store)
-                : data(data), store(store)
+                : data(data), store(std::move(store))
             { }
         };
 
@@ -68,7 +99,7 @@ namespace model
             Store store;
 
             Label(LabelData const& data, Store && store)
-                : data(data), store(store)
+                : data(data), store(std::move(store))
             { }
         };
         struct Prop
@@ -79,26 +110,493 @@ namespace model
             Store store;
 
             Prop(PropData const& data, Store && store)
-                : data(data), store(store)
+                : data(data), store(std::move(store))
             { }
         };
 
+    public:
+        static constexpr bool hasNodeDataIndex = TConfig::Index::NodeData;
+        static constexpr bool hasEdgePartitionIndex = TConfig::Index::EdgePartitions;
+        static constexpr bool hasPropValueIndex = TConfig::Index::PropValues;
+        static constexpr bool hasEdgeDataIndex = TConfig::Index::EdgeData;
+        static constexpr bool hasDenseHandles = TConfig::Storage::Store::denseHandles;
+        static constexpr bool isConcurrent = TConfig::Storage::Store::concurrent;
+        static constexpr bool isVersioned = TConfig::Storage::Store::versioned;
+        static constexpr bool hasLabelMembership = TConfig::Storage::Store::labelMembership;
+        static constexpr bool hasNodeIndices = TConfig::Storage::Store::nodeIndices;
+        static constexpr bool hasBulkAdjacency = TConfig::Storage::Store::bulkAdjacency;
+        static constexpr bool hasPathLists = TConfig::Storage::Store::pathLists;
+        static constexpr bool hasRemoval = TConfig::Storage::Store::removal;
+        static constexpr bool hasKeyedProps = hasNodeIndices && std::is_default_constructible_v<std::hash<PropKey>>;
+        static constexpr bool hasIndexes = hasNodeDataIndex || hasEdgePartitionIndex || hasPropValueIndex || hasEdgeDataIndex;
+
+        // Interned edge data, the key of an edge partition. The id of edge data no edge carries
+        // anymore is reused.
+        using PredicateId = uint32_t;
+        static constexpr PredicateId noPredicate = std::numeric_limits<PredicateId>::max();
+
+        // Interned prop key, the column of a keyed prop.
+        using PropKeyId = uint32_t;
+        static constexpr PropKeyId noPropKey = std::numeric_limits<PropKeyId>::max();
+
+    private:
+        // The edges on a node sharing edge data, partitioned by role like the storage lists.
+        struct _EdgePartition
+        {
+            std::vector<void*> _edges;
+            size_t _outEdgeCount = 0;
+        };
+
+        struct _EdgePartitionKeyHash
+        {
+            inline size_t operator()(std::pair<Node const*, PredicateId> const& key) const
+            {
+                return std::hash<Node const*>()(key.first) ^ ((size_t)key.second * 0x9e3779b97f4a7c15ull);
+            }
+        };
+
+        // Partitions and predicates without edges are dropped.
+        struct _EdgePartitionIndex
+        {
+            std::unordered_map<EdgeData, PredicateId> _predicates;
+            // edges per predicate id, and the ids free for reuse
+            std::vector<size_t> _edgeCounts;
+            std::vector<PredicateId> _freePredicates;
+            std::unordered_map<std::pair<Node const*, PredicateId>, _EdgePartition, _EdgePartitionKeyHash> _partitions;
+        };
+
+        struct _EdgeDataIndex
+        {
+            std::unordered_map<EdgeData, std::vector<void*>> _edges;
+            // where each edge sits in its data's list, so removal swaps it out without a scan
+            std::unordered_map<void const*, size_t> _positions;
+        };
+
+        // Orders (value, node) entries by value, and finds them by value alone.
+        struct _PropValueLess
+        {
+            using is_transparent = void;
+            using Entry = std::pair<PropData, Node const*>;
+
+            inline bool operator()(Entry const& a, Entry const& b) const
+            {
+                if (a.first < b.first)
+                    return true;
+                if (b.first < a.first)
+                    return false;
+                return std::less<Node const*>()(a.second, b.second);
+            }
+            inline bool operator()(Entry const& a, PropData const& b) const { return a.first < b; }
+            inline bool operator()(PropData const& a, Entry const& b) const { return a < b.first; }
+        };
+
+        using _PropValueSet = std::multiset<std::pair<PropData, Node const*>, _PropValueLess>;
+
+        struct _PropValueIndex
+        {
+            // props on nodes
+            _PropValueSet _values;
+            // keyed props, by key id
+            std::vector<_PropValueSet> _keyed;
+        };
+
+        struct _KeyedProps
+        {
+            std::unordered_map<PropKey, PropKeyId> _keys;
+            std::vector<PropColumn<PropData>> _columns;
+        };
+
     private:
+        friend class GraphSnapshot<PathPropertyGraph>;
+        friend class GraphBulkLoader<PathPropertyGraph>;
 
         typename TConfig::Storage::Store _storage;
 
+        std::conditional_t<hasNodeDataIndex, std::unordered_map<NodeData, Node*>, Empty> _nodeDataIndex;
+        std::conditional_t<hasEdgePartitionIndex, _EdgePartitionIndex, Empty> _edgePartitionIndex;
+        std::conditional_t<hasEdgeDataIndex, _EdgeDataIndex, Empty> _edgeDataIndex;
+        std::conditional_t<hasKeyedProps, _KeyedProps, Empty> _keyedProps;
+        std::conditional_t<hasPropValueIndex, _PropValueIndex, Empty> _propValueIndex;
+        // the paths visiting each node and edge, so removal does not scan every path
+        std::conditional_t<hasPathLists, std::unordered_map<void const*, std::vector<Path const*>>, Empty> _pathIndex;
+
+        // guards the indexes above when adds can run concurrently
+        std::conditional_t<isConcurrent, std::mutex, Empty> _indexLock;
+
+        // set while the indexes of an opened storage are not built yet, see `_requireIndexes()`
+        mutable std::atomic<bool> _indexesStale { false };
+        mutable std::mutex _indexesBuildLock;
+
     public:
 
         inline PathPropertyGraph()
         {
-            _storage.template initPrimaryNodeStore<Node>();
-            _storage.template initPrimaryEdgeStore<Edge>();
-            _storage.template initPrimaryPathStore<Path>();
-            _storage.template initPrimaryLabelStore<Label>();
-            _storage.template initPrimaryPropStore<Prop>();
+            _initStorage();
+        }
 
-            // TODO: run storage "config" lambda here
+        // The arguments are passed on to the storage, e.g. the file of a `MmapStorage`. Storages
+        // opened with elements in them have the indexes built on first use.
+        template<typename... TArgs, typename = std::enable_if_t<(sizeof...(TArgs) > 0)>>
+        inline explicit PathPropertyGraph(TArgs&&... storage_args)
+            : _storage(std::forward<TArgs>(storage_args)...)
+        {
+            _initStorage();
+
+            if (hasIndexes && nodeCount() > 0)
+                _indexesStale.store(true, std::memory_order_relaxed);
+        }
+    // Maintenance functions
+    public:
+        // Compacts the graph into its read only layout, for storages that support it.
+        inline void freeze()
+        {
+            _storage.template freeze<Node, Edge>();
+        }
+
+        // Reclaims the space of removed elements, for storages that support it. Invalidates all node,
+        // edge, and prop pointers.
+        inline void compact()
+        {
+            static_assert(hasRemoval, "Graph storage does not support compaction.");
+
+            // the storage renumbers live nodes by their rank, keyed props follow
+            std::vector<uint32_t> renumbered;
+            if constexpr (hasKeyedProps)
+            {
+                std::vector<uint32_t> live;
+                forAllNodes([&](Node const* node) { live.push_back(_storage.indexOfNode(node->store)); });
+                std::sort(live.begin(), live.end());
+                renumbered.assign(live.empty() ? 0 : (size_t)live.back() + 1, PropColumn<PropData>::npos);
+                for (size_t i = 0; i < live.size(); ++i)
+                    renumbered[live[i]] = (uint32_t)i;
+            }
+
+            _storage.template compact<Node, Edge, Path, Label, Prop>();
+
+            if constexpr (hasKeyedProps)
+            {
+                for (auto& column : _keyedProps._columns)
+                    column.remap(renumbered, nodeCount());
+            }
+
+            _rebuildIndexes();
+        }
+
+        // Moves nodes next to their neighbors in memory, for storages that support `compact()`. Edges
+        // follow the first node listing them and props their parent. Also reclaims the space of removed
+        // elements, and invalidates all node, edge, and prop pointers.
+        inline void reorder(NodeOrder order = NodeOrder::BreadthFirst)
+        {
+            static_assert(hasRemoval, "Graph storage does not support compaction.");
+
+            auto nodes = _nodeOrder(order);
+
+            // the storage renumbers nodes by their position in the order, keyed props follow
+            std::vector<uint32_t> renumbered;
+            if constexpr (hasKeyedProps)
+            {
+                for (size_t i = 0; i < nodes.size(); ++i)
+                {
+                    auto index = _storage.indexOfNode(nodes[i]->store);
+                    if (index >= renumbered.size())
+                        renumbered.resize((size_t)index + 1, PropColumn<PropData>::npos);
+                    renumbered[index] = (uint32_t)i;
+                }
+            }
+
+            _storage.template reorder<Node, Edge, Path, Label, Prop>(nodes);
+
+            if constexpr (hasKeyedProps)
+            {
+                for (auto& column : _keyedProps._columns)
+                    column.remap(renumbered, nodeCount());
+            }
+
+            _rebuildIndexes();
+        }
+
+    private:
+        inline std::vector<Node const*> _nodeOrder(NodeOrder order) const
+        {
+            std::vector<Node const*> nodes;
+            forAllNodes([&](Node const* node) { nodes.push_back(node); });
+
+            auto by_degree = [&](Node const* a, Node const* b) { return edgesOnNode(a).size() < edgesOnNode(b).size(); };
+            if (order == NodeOrder::DegreeDescending)
+            {
+                std::stable_sort(nodes.begin(), nodes.end(), [&](Node const* a, Node const* b) { return by_degree(b, a); });
+                return nodes;
+            }
+
+            auto cuthill_mckee = order == NodeOrder::ReverseCuthillMcKee;
+            if (cuthill_mckee)
+                std::stable_sort(nodes.begin(), nodes.end(), by_degree);
+
+            std::vector<Node const*> res;
+            res.reserve(nodes.size());
+            std::unordered_set<Node const*> visited;
+            std::vector<Node const*> neighbors;
+            for (Node const* start : nodes)
+            {
+                if (!visited.insert(start).second)
+                    continue;
+
+                // `res` doubles as the queue
+                size_t head = res.size();
+                res.push_back(start);
+                while (head < res.size())
+                {
+                    neighbors.clear();
+                    for (Edge const* edge : edgesOnNode(res[head++]))
+                    {
+                        for (Node const* neighbor : nodesInEdge(edge))
+                        {
+                            if (visited.insert(neighbor).second)
+                                neighbors.push_back(neighbor);
+                        }
+                    }
+
+                    if (cuthill_mckee)
+                        std::stable_sort(neighbors.begin(), neighbors.end(), by_degree);
+                    res.insert(res.end(), neighbors.begin(), neighbors.end());
+                }
+            }
+
+            if (cuthill_mckee)
+                std::reverse(res.begin(), res.end());
+            return res;
+        }
+
+    // Snapshot functions
+    public:
+        // A consistent read only view of the graph as of the last add, for versioned storages. Adds
+        // made afterwards are not visible through it. The snapshot must not outlive the graph.
+        inline GraphSnapshot<PathPropertyGraph> snapshot() const
+        {
+            static_assert(isVersioned, "Graph storage does not support snapshots.");
+
+            return GraphSnapshot<PathPropertyGraph>(this);
+        }
+
+    // Persistence functions
+    // Binary snapshots hold labels, nodes, edges, props, label members, and keyed props, relationships
+    // are written as indices into the element lists. Data is written through `BinaryCodec`.
+    public:
+        // 2 added the label members, 3 the keyed props, older snapshots load without them
+        static constexpr uint32_t binarySnapshotVersion = 3;
+
+        inline void saveSnapshot(std::ostream& out) const
+        {
+            std::vector<Node const*> nodes;
+            std::unordered_map<Node const*, uint64_t> node_indices;
+            forAllNodes([&](Node const* node)
+            {
+                node_indices.emplace(node, nodes.size());
+                nodes.push_back(node);
+            });
+
+            // every edge has a node, edges are numbered as they are first seen
+            std::vector<Edge const*> edges;
+            std::unordered_map<Edge const*, uint64_t> edge_indices;
+            for (Node const* node : nodes)
+            {
+                for (Edge const* edge : edgesOnNode(node))
+                {
+                    if (edge_indices.emplace(edge, edges.size()).second)
+                        edges.push_back(edge);
+                }
+            }
+
+            out.write(_binarySnapshotMagic, sizeof(_binarySnapshotMagic));
+            BinaryCodec<uint32_t>::write(out, binarySnapshotVersion);
+
+            BinaryCodec<uint64_t>::write(out, (uint64_t)labelCount());
+            forAllLabels([&](Label const* label) { BinaryCodec<LabelData>::write(out, label->data); });
+
+            BinaryCodec<uint64_t>::write(out, (uint64_t)nodes.size());
+            for (Node const* node : nodes)
+                BinaryCodec<NodeData>::write(out, node->data);
+
+            BinaryCodec<uint64_t>::write(out, (uint64_t)edges.size());
+            for (Edge const* edge : edges)
+            {
+                BinaryCodec<EdgeData>::write(out, edge->data);
+                BinaryCodec<uint8_t>::write(out, (uint8_t)edge->inverted);
+
+                auto edge_nodes = nodesInEdge(edge);
+                BinaryCodec<uint32_t>::write(out, (uint32_t)edge_nodes.size());
+                for (Node const* node : edge_nodes)
+                    BinaryCodec<uint64_t>::write(out, node_indices.at(node));
+            }
+
+            uint64_t prop_count = 0;
+            for (Node const* node : nodes)
+                prop_count += propsOnNode(node).size();
+            for (Edge const* edge : edges)
+                prop_count += propsOnEdge(edge).size();
+
+            BinaryCodec<uint64_t>::write(out, prop_count);
+            for (uint64_t i = 0; i < nodes.size(); ++i)
+            {
+                for (Prop const* prop : propsOnNode(nodes[i]))
+                    _writeBinaryProp(out, prop, GraphKind::Node, i);
+            }
+            for (uint64_t i = 0; i < edges.size(); ++i)
+            {
+                for (Prop const* prop : propsOnEdge(edges[i]))
+                    _writeBinaryProp(out, prop, GraphKind::Edge, i);
+            }
+
+            // in label order, storages without label membership have none
+            forAllLabels([&](Label const* label)
+            {
+                if constexpr (hasLabelMembership)
+                {
+                    auto members = nodesInLabel(label);
+                    BinaryCodec<uint64_t>::write(out, (uint64_t)members.size());
+                    for (Node const* node : members)
+                        BinaryCodec<uint64_t>::write(out, node_indices.at(node));
+                }
+                else
+                    BinaryCodec<uint64_t>::write(out, 0);
+            });
+
+            // per key in id order: the key and its (node, value) entries
+            if constexpr (hasKeyedProps)
+            {
+                BinaryCodec<uint64_t>::write(out, (uint64_t)_keyedProps._columns.size());
+                std::vector<PropKey const*> keys(_keyedProps._columns.size());
+                for (auto const& [key, id] : _keyedProps._keys)
+                    keys[id] = &key;
+
+                for (PropKeyId id = 0; id < keys.size(); ++id)
+                {
+                    auto const& column = _keyedProps._columns[id];
+                    BinaryCodec<PropKey>::write(out, *keys[id]);
+                    BinaryCodec<uint64_t>::write(out, (uint64_t)column.size());
+                    column.forEach([&](uint32_t index, PropData const& data)
+                    {
+                        BinaryCodec<uint64_t>::write(out, node_indices.at(_storage.template resolveNodeIndex<Node>(index)));
+                        BinaryCodec<PropData>::write(out, data);
+                    });
+                }
+            }
+            else
+                BinaryCodec<uint64_t>::write(out, 0);
+
+            if (!out)
+                throw graph_error("Could not write graph snapshot.");
+        }
+
+        // Loads a snapshot written by `saveSnapshot` into an empty graph, through a `GraphBulkLoader`.
+        // The snapshot is read whole before anything is added, a broken one throws and leaves the
+        // graph empty.
+        inline void loadSnapshot(std::istream& in)
+        {
+            if (nodeCount() > 0 || edgeCount() > 0 || pathCount() > 0 || labelCount() > 0 || propCount() > 0)
+                throw graph_error("Snapshots load into an empty graph.");
+
+            char magic[sizeof(_binarySnapshotMagic)];
+            in.read(magic, sizeof(magic));
+            if (!in || !std::equal(magic, magic + sizeof(magic), _binarySnapshotMagic))
+                throw graph_error("Not a graph snapshot.");
+            auto version = _readBinary<uint32_t>(in);
+            if (version == 0 || version > binarySnapshotVersion)
+                throw graph_error("Unsupported graph snapshot version.");
+
+            std::vector<LabelData> labels;
+            auto label_count = _readBinary<uint64_t>(in);
+            for (uint64_t i = 0; i < label_count; ++i)
+                labels.push_back(_readBinary<LabelData>(in));
+
+            // nodes are loaded under their snapshot index
+            GraphBulkLoader<PathPropertyGraph> loader(*this);
+            auto node_count = _readBinary<uint64_t>(in);
+            for (uint64_t i = 0; i < node_count; ++i)
+                loader.addNode(i, _readBinary<NodeData>(in));
+
+            std::vector<uint64_t> edge_nodes;
+            auto edge_count = _readBinary<uint64_t>(in);
+            for (uint64_t i = 0; i < edge_count; ++i)
+            {
+                auto data = _readBinary<EdgeData>(in);
+                auto inverted = _readBinary<uint8_t>(in) != 0;
+
+                edge_nodes.clear();
+                auto edge_node_count = _readBinary<uint32_t>(in);
+                for (uint32_t j = 0; j < edge_node_count; ++j)
+                    edge_nodes.push_back(_readBinaryIndex(in, node_count));
+
+                if (edge_nodes.size() < 2)
+                    throw graph_error("Corrupt graph snapshot.");
+                loader.addEdge(data, edge_nodes, inverted);
+            }
+
+            auto prop_count = _readBinary<uint64_t>(in);
+            for (uint64_t i = 0; i < prop_count; ++i)
+            {
+                auto kind = (GraphKind)_readBinary<uint8_t>(in);
+                if (kind == GraphKind::Node)
+                {
+                    auto node = _readBinaryIndex(in, node_count);
+                    loader.addNodeProp(node, _readBinary<PropData>(in));
+                }
+                else if (kind == GraphKind::Edge)
+                {
+                    auto edge = _readBinaryIndex(in, edge_count);
+                    loader.addEdgeProp(edge, _readBinary<PropData>(in));
+                }
+                else
+                    throw graph_error("Corrupt graph snapshot.");
+            }
+
+            std::vector<std::vector<uint64_t>> members(labels.size());
+            if (version >= 2)
+            {
+                for (auto& label_members : members)
+                {
+                    auto member_count = _readBinary<uint64_t>(in);
+                    for (uint64_t i = 0; i < member_count; ++i)
+                        label_members.push_back(_readBinaryIndex(in, node_count));
+                }
+            }
+
+            // keyed props are set once the nodes exist
+            std::vector<std::tuple<uint64_t, PropKey, PropData>> keyed;
+            if (version >= 3)
+            {
+                auto key_count = _readBinary<uint64_t>(in);
+                if constexpr (hasKeyedProps)
+                {
+                    for (uint64_t i = 0; i < key_count; ++i)
+                    {
+                        auto key = _readBinary<PropKey>(in);
+                        auto entry_count = _readBinary<uint64_t>(in);
+                        for (uint64_t j = 0; j < entry_count; ++j)
+                        {
+                            auto node = _readBinaryIndex(in, node_count);
+                            keyed.emplace_back(node, key, _readBinary<PropData>(in));
+                        }
+                    }
+                }
+                else if (key_count > 0)
+                    throw graph_error("Graph storage does not support keyed props.");
+            }
+
+            loader.build();
+            for (size_t i = 0; i < labels.size(); ++i)
+            {
+                Label* label = addLabel(labels[i]);
+                for (auto node : members[i])
+                    attachLabel(loader.resolve(node), label);
+            }
+            if constexpr (hasKeyedProps)
+            {
+                for (auto const& [node, key, data] : keyed)
+                    setProp(loader.resolve(node), key, data);
+            }
         }
+
     // Count functions
     public:
         inline size_t nodeCount() const { return _storage.template countPrimaryNodeStore<Node>(); }
@@ -107,6 +605,130 @@ namespace model
         inline size_t labelCount() const { return _storage.template countPrimaryLabelStore<Label>(); }
         inline size_t propCount() const { return _storage.template countPrimaryPropStore<Prop>(); }
 
+    // Memory functions
+    // Walks the whole graph, not to be called while other threads add to it. Index sizes are
+    // estimates from the container sizes, see `storage::MemoryStats`.
+    public:
+        inline storage::MemoryStats memoryStats() const
+        {
+            _requireIndexes();
+
+            storage::MemoryStats stats;
+            _storage.template memoryStats<Node, Edge, Path, Label, Prop>(stats);
+
+            size_t degrees = 0;
+            forAllNodes([&](Node const* node)
+            {
+                auto degree = (size_t)edgesOnNode(node).size();
+                degrees += degree;
+                stats.maxDegree = std::max(stats.maxDegree, degree);
+
+                stats.dataBytes += _heapBytes(node->data);
+                for (Prop const* prop : propsOnNode(node))
+                    stats.dataBytes += _heapBytes(prop->data);
+            });
+            if (stats.nodes.count > 0)
+                stats.averageDegree = (double)degrees / stats.nodes.count;
+
+            forAllEdges([&](Edge const* edge)
+            {
+                stats.dataBytes += _heapBytes(edge->data);
+                for (Prop const* prop : propsOnEdge(edge))
+                    stats.dataBytes += _heapBytes(prop->data);
+            });
+            forAllLabels([&](Label const* label)
+            {
+                stats.dataBytes += _heapBytes(label->data);
+            });
+
+            if constexpr (hasNodeDataIndex)
+            {
+                stats.indexBytes += _hashMapBytes(_nodeDataIndex);
+                for (auto& entry : _nodeDataIndex)
+                    stats.indexBytes += _heapBytes(entry.first);
+            }
+            if constexpr (hasEdgePartitionIndex)
+            {
+                stats.indexBytes += _hashMapBytes(_edgePartitionIndex._predicates);
+                stats.indexBytes += _edgePartitionIndex._edgeCounts.capacity() * sizeof(size_t);
+                stats.indexBytes += _edgePartitionIndex._freePredicates.capacity() * sizeof(PredicateId);
+                stats.indexBytes += _hashMapBytes(_edgePartitionIndex._partitions);
+                for (auto& entry : _edgePartitionIndex._partitions)
+                    stats.indexBytes += entry.second._edges.capacity() * sizeof(void*);
+            }
+            if constexpr (hasEdgeDataIndex)
+            {
+                stats.indexBytes += _hashMapBytes(_edgeDataIndex._edges);
+                stats.indexBytes += _hashMapBytes(_edgeDataIndex._positions);
+                for (auto& entry : _edgeDataIndex._edges)
+                    stats.indexBytes += _heapBytes(entry.first) + entry.second.capacity() * sizeof(void*);
+            }
+            if constexpr (hasKeyedProps)
+            {
+                stats.indexBytes += _hashMapBytes(_keyedProps._keys);
+                stats.indexBytes += _keyedProps._columns.capacity() * sizeof(PropColumn<PropData>);
+                for (auto& column : _keyedProps._columns)
+                    stats.indexBytes += column.memoryBytes();
+            }
+            if constexpr (hasPropValueIndex)
+            {
+                stats.indexBytes += _treeBytes(_propValueIndex._values);
+                stats.indexBytes += _propValueIndex._keyed.capacity() * sizeof(_PropValueSet);
+                for (auto& values : _propValueIndex._keyed)
+                    stats.indexBytes += _treeBytes(values);
+            }
+            if constexpr (hasPathLists)
+            {
+                stats.indexBytes += _hashMapBytes(_pathIndex);
+                for (auto& entry : _pathIndex)
+                    stats.indexBytes += entry.second.capacity() * sizeof(Path const*);
+            }
+
+            return stats;
+        }
+
+    private:
+        // Heap memory owned by a data value, only strings too long for their inline buffer own any.
+        template<typename T>
+        static inline size_t _heapBytes(T const& data)
+        {
+            if constexpr (std::is_same_v<T, std::string>)
+                return data.capacity() > std::string().capacity() ? data.capacity() + 1 : 0;
+            else
+                return 0;
+        }
+
+        // Node based containers are estimated at one allocation per entry, plus the bucket array.
+        template<typename TMap>
+        static inline size_t _hashMapBytes(TMap const& map)
+        {
+            return map.size() * (sizeof(typename TMap::value_type) + sizeof(void*)) + map.bucket_count() * sizeof(void*);
+        }
+
+        template<typename TSet>
+        static inline size_t _treeBytes(TSet const& set)
+        {
+            // three links and the color
+            return set.size() * (sizeof(typename TSet::value_type) + 4 * sizeof(void*));
+        }
+
+    // Handle functions
+    // Only available on storages with dense handles, handles index nodes from 0 to `nodeCount()`.
+    public:
+        inline size_t nodeHandle(Node const* node) const
+        {
+            static_assert(hasDenseHandles, "Graph storage does not have dense handles.");
+
+            return _storage.handleOfNode(node->store);
+        }
+
+        inline Node const* nodeFromHandle(size_t handle) const
+        {
+            static_assert(hasDenseHandles, "Graph storage does not have dense handles.");
+
+            return _storage.template resolveNode<Node>(handle);
+        }
+
     // Introspection functions
     public:
         static inline bool isEdgeInverted(Edge const* edge)
@@ -114,19 +736,40 @@ namespace model
             return edge->inverted;
         }
 
+        inline typename TConfig::Storage::Store const& storage() const
+        {
+            return _storage;
+        }
+
     // Add functions
     public:
         inline Label* addLabel(LabelData const& data)
         {
             Label* ref = _storage.template makeLabel<Label>(data);
 
+            _commit();
             return ref;
         }
 
         inline Node* addNode(NodeData const& data)
         {
+            _requireIndexes();
+
+            // the check and the insert must not interleave with other adds
+            [[maybe_unused]] auto lock = _lockIndexes(hasNodeDataIndex);
+
+            if constexpr (hasNodeDataIndex)
+            {
+                if (_nodeDataIndex.find(data) != _nodeDataIndex.end())
+                    throw graph_error("Node data already exists in the index.");
+            }
+
             Node* ref = _storage.template makeNode<Node>(data);
 
+            if constexpr (hasNodeDataIndex)
+                _nodeDataIndex.emplace(data, ref);
+
+            _commit();
             return ref;
         }
         
@@ -141,10 +784,13 @@ namespace model
             ref->inverted = invert;
 
             _storage.setEdgeListOfNodes(
-                ref, ref->store,
+                ref, ref->store, invert,
                 nodes.begin(), nodes.end(), [](Node const* n){ return &n->store; }
             );
 
+            _indexEdge(ref, nodes.begin(), nodes.end());
+
+            _commit();
             return ref;
         }
         
@@ -157,6 +803,14 @@ namespace model
                 ref, ref->store
             );
 
+            if constexpr (hasPropValueIndex)
+            {
+                _requireIndexes();
+                [[maybe_unused]] auto lock = _lockIndexes();
+                _propValueIndex._values.emplace(data, on_node);
+            }
+
+            _commit();
             return ref;
         }
 
@@ -169,86 +823,994 @@ namespace model
                 ref, ref->store
             );
 
+            _commit();
             return ref;
         }
 
-    // Iterate all functions
-    public:
-        template<typename Func>
-        inline void forAllNodes(Func func) const
+        // A walk through the graph, `edges[i]` must connect `nodes[i]` and `nodes[i + 1]`. Only
+        // available on storages keeping path lists.
+        inline Path* addPath(PathData const& data, std::vector<Node const*> const& nodes, std::vector<Edge const*> const& edges)
         {
-            for (auto node_it = _storage.template allNodesBegin<Node>(); node_it != _storage.template allNodesEnd<Node>(); ++node_it)
+            static_assert(hasPathLists, "Graph storage does not keep path lists.");
+
+            if (nodes.empty())
+                throw graph_error("Paths must visit at least one node.");
+            if (edges.size() + 1 != nodes.size())
+                throw graph_error("Paths must have one edge between each pair of nodes.");
+            for (size_t i = 0; i < edges.size(); ++i)
             {
-                if (!_detail::invoke_return_bool_or_true(func, (Node const*)&*node_it))
-                    break;
+                if (indexOfNodeInEdge(nodes[i], edges[i]) == -1 || indexOfNodeInEdge(nodes[i + 1], edges[i]) == -1)
+                    throw graph_error("Path edges must connect the nodes around them.");
             }
-        }
 
-        template<typename Func>
-        inline void forAllLabels(Func func) const
-        {
-            for (auto label_it = _storage.template allLabelsBegin<Label>(); label_it != _storage.template allLabelsEnd<Label>(); ++label_it)
+            Path* ref = _storage.template makePath<Path>(data);
+
+            _storage.setPathListOfElements(
+                ref, ref->store,
+                nodes.begin(), nodes.end(), edges.begin(), edges.end()
+            );
+
             {
-                if (!_detail::invoke_return_bool_or_true(func, (Label const*)&*label_it))
-                    break;
+                [[maybe_unused]] auto lock = _lockIndexes();
+                _indexPath(ref);
             }
+
+            _commit();
+            return ref;
         }
 
-    // Iterate on functions
+    // Remove functions
+    // Removed slots are reused by later adds, `compact()` reclaims them.
     public:
-        template<typename Func>
-        inline void forEdgesOnNode(Node const* node, Func func) const
+        // If `destroy_edges` is false the node only leaves its edges, edges left with less than two
+        // nodes are removed.
+        inline void removeNode(Node const* node, bool destroy_edges = true)
         {
-            auto list = _storage.template getNodeListOfEdges<Edge>(node, node->store);
+            static_assert(hasRemoval, "Graph storage does not support removal.");
+            _requireIndexes();
+
+            _removePathsVisiting(node);
 
-            for (auto edge_it = list.begin(); edge_it != list.end(); ++edge_it)
+            for (Prop const* prop : _copyRange(propsOnNode(node)))
+                removeProp(prop);
+
+            // an edge is listed once per slot the node has in it
+            auto edges = _copyRange(edgesOnNode(node));
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+            for (Edge const* edge : edges)
             {
-                if (!_detail::invoke_return_bool_or_true(func, (Edge const*)*edge_it))
-                    break;
+                while (!destroy_edges && indexOfNodeInEdge(node, edge) != -1 && nodesInEdge(edge).size() > 2)
+                    _detachEdge(node, edge);
+
+                if (indexOfNodeInEdge(node, edge) != -1)
+                    removeEdge(edge);
             }
-        }
 
-        template<typename Func>
-        inline void forNodesInEdge(Edge const* edge, Func func) const
-        {
-            auto list = _storage.template getEdgeListOfNodes<Node>(edge, edge->store);
+            if constexpr (hasNodeDataIndex)
+                _nodeDataIndex.erase(node->data);
+
+            if constexpr (hasLabelMembership)
+                _storage.template detachNodeLabels<Label>(node, node->store);
 
-            for (auto node_it = list.begin(); node_it != list.end(); ++node_it)
+            if constexpr (hasKeyedProps)
             {
-                if (!_detail::invoke_return_bool_or_true(func, (Node const*)*node_it))
-                    break;
+                auto index = _storage.indexOfNode(node->store);
+                for (PropKeyId id = 0; id < _keyedProps._columns.size(); ++id)
+                {
+                    if constexpr (hasPropValueIndex)
+                    {
+                        if (auto value = _keyedProps._columns[id].get(index))
+                            _erasePropValue(_propValueIndex._keyed[id], *value, node);
+                    }
+                    _keyedProps._columns[id].erase(index);
+                }
             }
+
+            _storage.template destroyNode<Node>(const_cast<Node*>(node));
         }
 
-        template<typename Func>
-        inline void forPropsOnNode(Node const* node, Func func) const
+        // Paths walking the edge are removed with it.
+        inline void removeEdge(Edge const* edge)
         {
-            auto list = _storage.template getNodeListOfProps<Prop>(node, node->store);
+            static_assert(hasRemoval, "Graph storage does not support removal.");
+            _requireIndexes();
 
-            for (auto prop_it = list.begin(); prop_it != list.end(); ++prop_it)
+            _removePathsVisiting(edge);
+
+            for (Prop const* prop : _copyRange(propsOnEdge(edge)))
+                removeProp(prop);
+
+            if constexpr (hasEdgePartitionIndex)
             {
-                if (!_detail::invoke_return_bool_or_true(func, (Prop const*)*prop_it))
-                    break;
+                auto predicate = _edgePartitionIndex._predicates.at(edge->data);
+                size_t i = 0;
+                for (Node const* node : nodesInEdge(edge))
+                    _erasePartitionEdge(node, predicate, edge, TConfig::Storage::Store::isOutgoingSlot(i++ == 0, edge->inverted));
+                _releasePredicate(edge->data, predicate);
             }
+
+            if constexpr (hasEdgeDataIndex)
+                _eraseEdgeData(edge);
+
+            _storage.template clearEdgeListOfNodes<Node>(edge, edge->store, edge->inverted);
+            _storage.template destroyEdge<Edge>(const_cast<Edge*>(edge));
         }
 
-        template<typename Func>
-        inline void forPropsOnEdge(Edge const* edge, Func func) const
+        inline void removeProp(Prop const* prop)
         {
-            auto list = _storage.template getEdgeListOfProps<Prop>(edge, edge->store);
+            static_assert(hasRemoval, "Graph storage does not support removal.");
+            _requireIndexes();
 
-            for (auto prop_it = list.begin(); prop_it != list.end(); ++prop_it)
+            if constexpr (hasPropValueIndex)
             {
-                if (!_detail::invoke_return_bool_or_true(func, (Prop const*)*prop_it))
-                    break;
+                Node const* node = _storage.template nodeOfProp<Node>(prop->store);
+                if (node != nullptr)
+                    _erasePropValue(_propValueIndex._values, prop->data, node);
             }
+
+            _storage.template detachProp<Node, Edge>(prop, prop->store);
+            _storage.template destroyProp<Prop>(const_cast<Prop*>(prop));
         }
 
-    // Attach functions
-    public:
-        inline void attachLabel(Node* node, Label* label)
+        inline void removePath(Path const* path)
         {
-            _storage.attachNodeLabel(
+            static_assert(hasPathLists, "Graph storage does not keep path lists.");
+            static_assert(hasRemoval, "Graph storage does not support removal.");
+
+            auto unindex = [&](void const* element)
+            {
+                auto it = _pathIndex.find(element);
+                if (it == _pathIndex.end())
+                    return;
+
+                auto& paths = it->second;
+                auto found = std::find(paths.begin(), paths.end(), path);
+                if (found != paths.end())
+                {
+                    *found = paths.back();
+                    paths.pop_back();
+                }
+                if (paths.empty())
+                    _pathIndex.erase(it);
+            };
+            for (Node const* node : nodesInPath(path))
+                unindex(node);
+            for (Edge const* edge : edgesInPath(path))
+                unindex(edge);
+
+            _storage.template destroyPath<Path>(const_cast<Path*>(path));
+        }
+
+    // Iterate all functions
+    public:
+        template<typename Func>
+        inline void forAllNodes(Func func) const
+        {
+            for (auto node_it = _storage.template allNodesBegin<Node>(); node_it != _storage.template allNodesEnd<Node>(); ++node_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Node const*)&*node_it))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forAllEdges(Func func) const
+        {
+            for (auto edge_it = _storage.template allEdgesBegin<Edge>(); edge_it != _storage.template allEdgesEnd<Edge>(); ++edge_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Edge const*)&*edge_it))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forAllPaths(Func func) const
+        {
+            for (auto path_it = _storage.template allPathsBegin<Path>(); path_it != _storage.template allPathsEnd<Path>(); ++path_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Path const*)&*path_it))
+                    break;
+            }
+        }
+
+        // Visits the edges carrying the data, through the edge data index when it is configured and
+        // by scanning every edge otherwise.
+        template<typename Func>
+        inline void forEdgesWithData(EdgeData const& data, Func func) const
+        {
+            if constexpr (hasEdgeDataIndex)
+            {
+                for (Edge const* edge : edgesWithData(data))
+                {
+                    if (!_detail::invoke_return_bool_or_true(func, edge))
+                        break;
+                }
+            }
+            else
+            {
+                forAllEdges([&](Edge const* edge)
+                {
+                    return !(edge->data == data) || _detail::invoke_return_bool_or_true(func, edge);
+                });
+            }
+        }
+
+        template<typename Func>
+        inline void forAllLabels(Func func) const
+        {
+            for (auto label_it = _storage.template allLabelsBegin<Label>(); label_it != _storage.template allLabelsEnd<Label>(); ++label_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Label const*)&*label_it))
+                    break;
+            }
+        }
+
+    // Label functions
+    // Only available on storages tracking label membership, members are kept as compressed bitmaps.
+    public:
+        inline size_t nodeCountInLabel(Label const* label) const
+        {
+            static_assert(hasLabelMembership, "Graph storage does not track label membership.");
+
+            return _storage.labelMembers(label->store).cardinality();
+        }
+
+        // Visits the nodes carrying every one of the labels.
+        template<typename Func>
+        inline void forNodesInAllLabels(std::vector<Label const*> const& labels, Func func) const
+        {
+            static_assert(hasLabelMembership, "Graph storage does not track label membership.");
+
+            if (labels.empty())
+                return;
+
+            auto members = _storage.labelMembers(labels[0]->store);
+            for (size_t i = 1; i < labels.size() && !members.empty(); ++i)
+                members &= _storage.labelMembers(labels[i]->store);
+            _forMembers(members, func);
+        }
+
+        // Visits the nodes carrying any of the labels, once each.
+        template<typename Func>
+        inline void forNodesInAnyLabel(std::vector<Label const*> const& labels, Func func) const
+        {
+            static_assert(hasLabelMembership, "Graph storage does not track label membership.");
+
+            Bitmap members;
+            for (Label const* label : labels)
+                members |= _storage.labelMembers(label->store);
+            _forMembers(members, func);
+        }
+
+    // Keyed prop functions
+    // Only available on storages with node indices. Keyed props hold one value per key and node,
+    // stored in a column per key rather than in the node's prop list.
+    public:
+        // `noPropKey` if no node ever had the key.
+        inline PropKeyId findPropKey(PropKey const& key) const
+        {
+            static_assert(hasKeyedProps, "Graph storage does not support keyed props.");
+
+            auto it = _keyedProps._keys.find(key);
+            return it != _keyedProps._keys.end() ? it->second : noPropKey;
+        }
+
+        // Sets or replaces the value of the key on the node.
+        inline void setProp(Node const* node, PropKey const& key, PropData const& data)
+        {
+            static_assert(hasKeyedProps, "Graph storage does not support keyed props.");
+
+            _requireIndexes();
+            [[maybe_unused]] auto lock = _lockIndexes();
+            auto& keys = _keyedProps._keys;
+            auto id = keys.emplace(key, (PropKeyId)keys.size()).first->second;
+            if (id == _keyedProps._columns.size())
+                _keyedProps._columns.emplace_back();
+
+            auto& column = _keyedProps._columns[id];
+            auto index = _storage.indexOfNode(node->store);
+            if constexpr (hasPropValueIndex)
+            {
+                if (id == _propValueIndex._keyed.size())
+                    _propValueIndex._keyed.emplace_back();
+                if (auto old = column.get(index))
+                    _erasePropValue(_propValueIndex._keyed[id], *old, node);
+                _propValueIndex._keyed[id].emplace(data, node);
+            }
+
+            column.set(index, data, nodeCount());
+        }
+
+        // The value of the key on the node, `nullptr` if it has none.
+        inline PropData const* getPropWithKeyId(Node const* node, PropKeyId key) const
+        {
+            static_assert(hasKeyedProps, "Graph storage does not support keyed props.");
+
+            if (key >= _keyedProps._columns.size())
+                return nullptr;
+            return _keyedProps._columns[key].get(_storage.indexOfNode(node->store));
+        }
+
+        inline PropData const* getProp(Node const* node, PropKey const& key) const
+        {
+            return getPropWithKeyId(node, findPropKey(key));
+        }
+
+        // Returns false if the node did not have the key.
+        inline bool removeProp(Node const* node, PropKey const& key)
+        {
+            auto id = findPropKey(key);
+            if (id == noPropKey)
+                return false;
+
+            _requireIndexes();
+            [[maybe_unused]] auto lock = _lockIndexes();
+            auto& column = _keyedProps._columns[id];
+            auto index = _storage.indexOfNode(node->store);
+            if constexpr (hasPropValueIndex)
+            {
+                if (auto old = column.get(index))
+                    _erasePropValue(_propValueIndex._keyed[id], *old, node);
+            }
+            return column.erase(index);
+        }
+
+        inline size_t nodeCountWithProp(PropKey const& key) const
+        {
+            auto id = findPropKey(key);
+            return id != noPropKey ? _keyedProps._columns[id].size() : 0;
+        }
+
+        // Visits the nodes having the key with its value, without looking at nodes lacking it.
+        template<typename Func>
+        inline void forNodesWithProp(PropKey const& key, Func func) const
+        {
+            auto id = findPropKey(key);
+            if (id == noPropKey)
+                return;
+
+            _keyedProps._columns[id].forEach([&](uint32_t index, PropData const& data)
+            {
+                return _detail::invoke_return_bool_or_true(func, _storage.template resolveNodeIndex<Node>(index), data);
+            });
+        }
+
+    // Prop value index functions
+    // Only available when the prop value index is configured, the keyed versions also need keyed
+    // props. Nodes are visited in value order with the matching value, once per matching prop.
+    // Ranges are half open, `[low, high)`. Prefix lookups are for string data.
+    public:
+        template<typename Func>
+        inline void forNodesWithPropValue(PropData const& value, Func func) const
+        {
+            _forPropValues(&_propValueIndex._values, value, [&](PropData const& v) { return !(value < v); }, func);
+        }
+
+        template<typename Func>
+        inline void forNodesWithPropInRange(PropData const& low, PropData const& high, Func func) const
+        {
+            _forPropValues(&_propValueIndex._values, low, [&](PropData const& v) { return v < high; }, func);
+        }
+
+        template<typename Func>
+        inline void forNodesWithPropPrefix(PropData const& prefix, Func func) const
+        {
+            _forPropValues(&_propValueIndex._values, prefix, [&](PropData const& v) { return hasPropPrefix(v, prefix); }, func);
+        }
+
+        template<typename Func>
+        inline void forNodesWithPropValue(PropKey const& key, PropData const& value, Func func) const
+        {
+            _forPropValues(_keyedPropValues(key), value, [&](PropData const& v) { return !(value < v); }, func);
+        }
+
+        template<typename Func>
+        inline void forNodesWithPropInRange(PropKey const& key, PropData const& low, PropData const& high, Func func) const
+        {
+            _forPropValues(_keyedPropValues(key), low, [&](PropData const& v) { return v < high; }, func);
+        }
+
+        template<typename Func>
+        inline void forNodesWithPropPrefix(PropKey const& key, PropData const& prefix, Func func) const
+        {
+            _forPropValues(_keyedPropValues(key), prefix, [&](PropData const& v) { return hasPropPrefix(v, prefix); }, func);
+        }
+
+        using PropValueRange = IteratorRange<typename _PropValueSet::const_iterator>;
+
+        // The index entries (value and node pairs) from the first value not less than `from` to the
+        // end of the index, for walking a lookup lazily. Callers stop once the values stop matching.
+        inline PropValueRange propValuesFrom(PropData const& from) const
+        {
+            return _propValuesFrom(&_propValueIndex._values, from);
+        }
+        inline PropValueRange propValuesFrom(PropKey const& key, PropData const& from) const
+        {
+            return _propValuesFrom(_keyedPropValues(key), from);
+        }
+
+        // Whether a value matches a prefix lookup.
+        static inline bool hasPropPrefix(PropData const& value, PropData const& prefix)
+        {
+            if constexpr (std::is_same_v<PropData, Symbol>)
+                return value.str().compare(0, prefix.str().size(), prefix.str()) == 0;
+            else
+                return value.compare(0, prefix.size(), prefix) == 0;
+        }
+
+    // Index functions
+    public:
+        // Only available when the node data index is configured, see `findNode` for the general version.
+        inline Node const* findIndexedNode(NodeData const& data) const
+        {
+            static_assert(hasNodeDataIndex, "Graph is not configured with a node data index.");
+            _requireIndexes();
+
+            auto it = _nodeDataIndex.find(data);
+            return it != _nodeDataIndex.end() ? it->second : nullptr;
+        }
+
+        // Only available when the edge data index is configured, the edges in no particular order.
+        inline PointerRange<Edge const*> edgesWithData(EdgeData const& data) const
+        {
+            static_assert(hasEdgeDataIndex, "Graph is not configured with an edge data index.");
+            _requireIndexes();
+
+            auto it = _edgeDataIndex._edges.find(data);
+            if (it == _edgeDataIndex._edges.end())
+                return PointerRange<Edge const*>();
+            return pointerRange<Edge const*>(it->second);
+        }
+
+        // Only available when the edge partition index is configured, `noPredicate` if no edge has the data.
+        inline PredicateId findEdgePredicate(EdgeData const& data) const
+        {
+            static_assert(hasEdgePartitionIndex, "Graph is not configured with an edge partition index.");
+            _requireIndexes();
+
+            auto it = _edgePartitionIndex._predicates.find(data);
+            return it != _edgePartitionIndex._predicates.end() ? it->second : noPredicate;
+        }
+
+        inline PointerRange<Edge const*> edgesOnNodeWithPredicate(Node const* node, PredicateId predicate) const
+        {
+            auto partition = _findPartition(node, predicate);
+            if (partition == nullptr)
+                return PointerRange<Edge const*>();
+            return pointerRange<Edge const*>(partition->_edges);
+        }
+
+        inline PointerRange<Edge const*> outEdgesOnNodeWithPredicate(Node const* node, PredicateId predicate) const
+        {
+            auto partition = _findPartition(node, predicate);
+            if (partition == nullptr)
+                return PointerRange<Edge const*>();
+            auto edges = partition->_edges.data();
+            return pointerRange<Edge const*>(edges, edges + partition->_outEdgeCount);
+        }
+
+        inline PointerRange<Edge const*> inEdgesOnNodeWithPredicate(Node const* node, PredicateId predicate) const
+        {
+            auto partition = _findPartition(node, predicate);
+            if (partition == nullptr)
+                return PointerRange<Edge const*>();
+            auto edges = partition->_edges.data();
+            return pointerRange<Edge const*>(edges + partition->_outEdgeCount, edges + partition->_edges.size());
+        }
+
+    private:
+        template<typename Func>
+        inline void _forMembers(Bitmap const& members, Func& func) const
+        {
+            for (auto index : members)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, _storage.template resolveNodeIndex<Node>(index)))
+                    break;
+            }
+        }
+
+        // Visits the entries from the first not less than `from`, while `more` accepts their value.
+        template<typename FuncMore, typename Func>
+        inline void _forPropValues(_PropValueSet const* values, PropData const& from, FuncMore more, Func& func) const
+        {
+            for (auto const& entry : _propValuesFrom(values, from))
+            {
+                if (!more(entry.first) || !_detail::invoke_return_bool_or_true(func, entry.second, entry.first))
+                    break;
+            }
+        }
+
+        // A missing keyed index gives an empty range.
+        inline PropValueRange _propValuesFrom(_PropValueSet const* values, PropData const& from) const
+        {
+            static_assert(hasPropValueIndex, "Graph is not configured with a prop value index.");
+            _requireIndexes();
+
+            if (values == nullptr)
+                return PropValueRange(_propValueIndex._values.end(), _propValueIndex._values.end());
+            return PropValueRange(values->lower_bound(from), values->end());
+        }
+
+        inline _PropValueSet const* _keyedPropValues(PropKey const& key) const
+        {
+            _requireIndexes();
+            auto id = findPropKey(key);
+            return id < _propValueIndex._keyed.size() ? &_propValueIndex._keyed[id] : nullptr;
+        }
+
+        static inline void _erasePropValue(_PropValueSet& values, PropData const& value, Node const* node)
+        {
+            auto it = values.find(std::make_pair(value, node));
+            if (it != values.end())
+                values.erase(it);
+        }
+
+        static constexpr char _binarySnapshotMagic[8] = { 'U', 'G', 'L', 'Y', 'S', 'N', 'A', 'P' };
+
+        static inline void _writeBinaryProp(std::ostream& out, Prop const* prop, GraphKind parent_kind, uint64_t parent_index)
+        {
+            BinaryCodec<uint8_t>::write(out, (uint8_t)parent_kind);
+            BinaryCodec<uint64_t>::write(out, parent_index);
+            BinaryCodec<PropData>::write(out, prop->data);
+        }
+
+        template<typename T>
+        static inline T _readBinary(std::istream& in)
+        {
+            auto value = BinaryCodec<T>::read(in);
+            if (!in)
+                throw graph_error("Truncated graph snapshot.");
+            return value;
+        }
+
+        static inline size_t _readBinaryIndex(std::istream& in, size_t count)
+        {
+            auto index = _readBinary<uint64_t>(in);
+            if (index >= count)
+                throw graph_error("Corrupt graph snapshot.");
+            return (size_t)index;
+        }
+
+        inline void _initStorage()
+        {
+            _storage.template initPrimaryNodeStore<Node>();
+            _storage.template initPrimaryEdgeStore<Edge>();
+            _storage.template initPrimaryPathStore<Path>();
+            _storage.template initPrimaryLabelStore<Label>();
+            _storage.template initPrimaryPropStore<Prop>();
+
+            // TODO: run storage "config" lambda here
+        }
+
+        // Publishes the adds so far to new snapshots, for versioned storages.
+        inline void _commit()
+        {
+            if constexpr (isVersioned)
+                _storage.commit();
+        }
+
+        inline auto _lockIndexes(bool needed = true)
+        {
+            if constexpr (isConcurrent)
+                return needed ? std::unique_lock<std::mutex>(_indexLock) : std::unique_lock<std::mutex>();
+            else
+                return Empty();
+        }
+
+        template<typename TRange>
+        static inline auto _copyRange(TRange const& range)
+        {
+            return std::vector<typename TRange::iterator::value_type>(range.begin(), range.end());
+        }
+
+        // Removes the first slot of the node from the edge.
+        inline void _detachEdge(Node const* node, Edge const* edge)
+        {
+            if constexpr (hasEdgePartitionIndex)
+            {
+                auto predicate = _edgePartitionIndex._predicates.at(edge->data);
+                auto index = indexOfNodeInEdge(node, edge);
+                _erasePartitionEdge(node, predicate, edge, TConfig::Storage::Store::isOutgoingSlot(index == 0, edge->inverted));
+                if (index == 0)
+                {
+                    auto next = *std::next(nodesInEdge(edge).begin());
+                    _flipPartitionEdge(next, predicate, edge, TConfig::Storage::Store::isOutgoingSlot(true, edge->inverted));
+                }
+            }
+
+            _storage.detachEdgeNode(edge, edge->store, edge->inverted, node, node->store);
+        }
+
+        // Builds the indexes of an opened storage once, readers may race to it.
+        inline void _requireIndexes() const
+        {
+            if constexpr (hasIndexes)
+            {
+                if (!_indexesStale.load(std::memory_order_acquire))
+                    return;
+
+                std::lock_guard<std::mutex> lock(_indexesBuildLock);
+                if (_indexesStale.load(std::memory_order_relaxed))
+                    const_cast<PathPropertyGraph*>(this)->_rebuildIndexes();
+            }
+        }
+
+        inline void _rebuildIndexes()
+        {
+            if constexpr (hasPathLists)
+            {
+                _pathIndex.clear();
+                forAllPaths([&](Path const* path) { _indexPath(path); });
+            }
+
+            if constexpr (hasEdgeDataIndex)
+            {
+                _edgeDataIndex._edges.clear();
+                _edgeDataIndex._positions.clear();
+                forAllEdges([&](Edge const* edge) { _pushEdgeData(edge); });
+            }
+
+            if constexpr (hasPropValueIndex)
+            {
+                _propValueIndex._values.clear();
+                forAllNodes([&](Node const* node)
+                {
+                    for (Prop const* prop : propsOnNode(node))
+                        _propValueIndex._values.emplace(prop->data, node);
+                });
+
+                if constexpr (hasKeyedProps)
+                {
+                    auto& keyed = _propValueIndex._keyed;
+                    keyed.assign(_keyedProps._columns.size(), _PropValueSet());
+                    for (PropKeyId id = 0; id < keyed.size(); ++id)
+                    {
+                        _keyedProps._columns[id].forEach([&](uint32_t index, PropData const& data)
+                        {
+                            keyed[id].emplace(data, _storage.template resolveNodeIndex<Node>(index));
+                        });
+                    }
+                }
+            }
+
+            if constexpr (hasNodeDataIndex)
+            {
+                _nodeDataIndex.clear();
+                forAllNodes([&](Node const* node) { _nodeDataIndex.emplace(node->data, const_cast<Node*>(node)); });
+            }
+
+            if constexpr (hasEdgePartitionIndex)
+            {
+                // predicates keep their ids, the ones left without edges are released
+                auto& index = _edgePartitionIndex;
+                index._partitions.clear();
+                std::fill(index._edgeCounts.begin(), index._edgeCounts.end(), 0);
+                forAllEdges([&](Edge const* edge) { _acquirePredicate(edge->data); });
+                for (auto it = index._predicates.begin(); it != index._predicates.end();)
+                {
+                    if (index._edgeCounts[it->second] == 0)
+                    {
+                        index._freePredicates.push_back(it->second);
+                        it = index._predicates.erase(it);
+                    }
+                    else
+                        ++it;
+                }
+
+                forAllNodes([&](Node const* node)
+                {
+                    for (Edge const* edge : outEdgesOnNode(node))
+                        _pushPartitionEdge(node, index._predicates.at(edge->data), edge, true);
+                    for (Edge const* edge : inEdgesOnNode(node))
+                        _pushPartitionEdge(node, index._predicates.at(edge->data), edge, false);
+                });
+            }
+
+            _indexesStale.store(false, std::memory_order_release);
+        }
+
+        // Counts an edge with the data, interning it first if no edge had it.
+        inline PredicateId _acquirePredicate(EdgeData const& data)
+        {
+            auto& index = _edgePartitionIndex;
+            auto it = index._predicates.find(data);
+            if (it == index._predicates.end())
+            {
+                PredicateId id;
+                if (index._freePredicates.empty())
+                {
+                    id = (PredicateId)index._edgeCounts.size();
+                    index._edgeCounts.push_back(0);
+                }
+                else
+                {
+                    id = index._freePredicates.back();
+                    index._freePredicates.pop_back();
+                }
+                it = index._predicates.emplace(data, id).first;
+            }
+
+            index._edgeCounts[it->second]++;
+            return it->second;
+        }
+
+        inline void _releasePredicate(EdgeData const& data, PredicateId predicate)
+        {
+            auto& index = _edgePartitionIndex;
+            if (--index._edgeCounts[predicate] > 0)
+                return;
+
+            index._predicates.erase(data);
+            index._freePredicates.push_back(predicate);
+        }
+
+        // Paths point at what they visit, they cannot outlive it.
+        template<typename T>
+        inline void _removePathsVisiting(T const* element)
+        {
+            if constexpr (hasPathLists)
+            {
+                auto it = _pathIndex.find(element);
+                if (it == _pathIndex.end())
+                    return;
+
+                // removal edits the list
+                auto visiting = it->second;
+                for (Path const* path : visiting)
+                    removePath(path);
+            }
+        }
+
+        // Lists the path under each node and edge it visits, once even if it visits them again.
+        inline void _indexPath(Path const* path)
+        {
+            auto index = [&](void const* element)
+            {
+                auto& paths = _pathIndex[element];
+                if (paths.empty() || paths.back() != path)
+                    paths.push_back(path);
+            };
+            for (Node const* node : nodesInPath(path))
+                index(node);
+            for (Edge const* edge : edgesInPath(path))
+                index(edge);
+        }
+
+        // Adds a new edge to the edge indexes, `begin` to `end` are its nodes.
+        template<typename NodeIt>
+        inline void _indexEdge(Edge const* ref, NodeIt begin, NodeIt end)
+        {
+            _requireIndexes();
+
+            if constexpr (hasEdgePartitionIndex)
+            {
+                [[maybe_unused]] auto lock = _lockIndexes();
+                auto predicate = _acquirePredicate(ref->data);
+                for (auto it = begin; it != end; ++it)
+                    _pushPartitionEdge(*it, predicate, ref, TConfig::Storage::Store::isOutgoingSlot(it == begin, ref->inverted));
+            }
+
+            if constexpr (hasEdgeDataIndex)
+            {
+                [[maybe_unused]] auto lock = _lockIndexes();
+                _pushEdgeData(ref);
+            }
+        }
+
+        inline void _pushEdgeData(Edge const* edge)
+        {
+            auto& edges = _edgeDataIndex._edges[edge->data];
+            _edgeDataIndex._positions[edge] = edges.size();
+            edges.push_back((void*)edge);
+        }
+
+        inline void _eraseEdgeData(Edge const* edge)
+        {
+            auto position = _edgeDataIndex._positions.find(edge);
+            if (position == _edgeDataIndex._positions.end())
+                return;
+
+            auto index = position->second;
+            _edgeDataIndex._positions.erase(position);
+
+            auto it = _edgeDataIndex._edges.find(edge->data);
+            auto& edges = it->second;
+            if (index + 1 < edges.size())
+            {
+                edges[index] = edges.back();
+                _edgeDataIndex._positions.at(edges[index]) = index;
+            }
+            edges.pop_back();
+            if (edges.empty())
+                _edgeDataIndex._edges.erase(it);
+        }
+
+        inline void _pushPartitionEdge(Node const* node, PredicateId predicate, Edge const* edge, bool outgoing)
+        {
+            auto& partition = _edgePartitionIndex._partitions[{ node, predicate }];
+            _detail::pushRoleSplit(partition._edges, partition._outEdgeCount, (void*)edge, outgoing);
+        }
+
+        inline void _erasePartitionEdge(Node const* node, PredicateId predicate, Edge const* edge, bool outgoing)
+        {
+            auto it = _edgePartitionIndex._partitions.find({ node, predicate });
+            if (it == _edgePartitionIndex._partitions.end())
+                return;
+
+            auto& partition = it->second;
+            _detail::eraseRoleSplit(partition._edges, partition._outEdgeCount, (void*)edge, outgoing);
+            if (partition._edges.empty())
+                _edgePartitionIndex._partitions.erase(it);
+        }
+
+        inline void _flipPartitionEdge(Node const* node, PredicateId predicate, Edge const* edge, bool to_outgoing)
+        {
+            auto it = _edgePartitionIndex._partitions.find({ node, predicate });
+            if (it != _edgePartitionIndex._partitions.end())
+                _detail::flipRoleSplit(it->second._edges, it->second._outEdgeCount, (void*)edge, to_outgoing);
+        }
+
+        inline _EdgePartition const* _findPartition(Node const* node, PredicateId predicate) const
+        {
+            static_assert(hasEdgePartitionIndex, "Graph is not configured with an edge partition index.");
+            _requireIndexes();
+
+            auto it = _edgePartitionIndex._partitions.find({ node, predicate });
+            return it != _edgePartitionIndex._partitions.end() ? &it->second : nullptr;
+        }
+
+    // Range functions
+    // These view the relations in place, the ranges are invalidated by modifying the object.
+    public:
+        inline auto edgesOnNode(Node const* node) const
+        {
+            return _storage.template getNodeListOfEdges<Edge>(node, node->store);
+        }
+
+        // Edges this node is a source of.
+        inline auto outEdgesOnNode(Node const* node) const
+        {
+            return _storage.template getNodeListOfOutEdges<Edge>(node, node->store);
+        }
+
+        // Edges this node is a target of.
+        inline auto inEdgesOnNode(Node const* node) const
+        {
+            return _storage.template getNodeListOfInEdges<Edge>(node, node->store);
+        }
+
+        inline auto nodesInEdge(Edge const* edge) const
+        {
+            return _storage.template getEdgeListOfNodes<Node>(edge, edge->store);
+        }
+
+        // The first node is the source and the rest are targets, swapped if the edge is inverted.
+        inline auto sourceNodesInEdge(Edge const* edge) const
+        {
+            auto nodes = nodesInEdge(edge);
+            auto first_end = std::next(nodes.begin());
+            return edge->inverted ? decltype(nodes)(first_end, nodes.end()) : decltype(nodes)(nodes.begin(), first_end);
+        }
+
+        inline auto targetNodesInEdge(Edge const* edge) const
+        {
+            auto nodes = nodesInEdge(edge);
+            auto first_end = std::next(nodes.begin());
+            return edge->inverted ? decltype(nodes)(nodes.begin(), first_end) : decltype(nodes)(first_end, nodes.end());
+        }
+
+        inline auto propsOnNode(Node const* node) const
+        {
+            return _storage.template getNodeListOfProps<Prop>(node, node->store);
+        }
+
+        inline auto propsOnEdge(Edge const* edge) const
+        {
+            return _storage.template getEdgeListOfProps<Prop>(edge, edge->store);
+        }
+
+        // In visiting order, only available on storages keeping path lists.
+        inline auto nodesInPath(Path const* path) const
+        {
+            static_assert(hasPathLists, "Graph storage does not keep path lists.");
+
+            return _storage.template getPathListOfNodes<Node>(path, path->store);
+        }
+
+        // The edge between each pair of nodes of the path.
+        inline auto edgesInPath(Path const* path) const
+        {
+            static_assert(hasPathLists, "Graph storage does not keep path lists.");
+
+            return _storage.template getPathListOfEdges<Edge>(path, path->store);
+        }
+
+        // Only available on storages tracking label membership.
+        inline auto nodesInLabel(Label const* label) const
+        {
+            static_assert(hasLabelMembership, "Graph storage does not track label membership.");
+
+            return _storage.template getLabelListOfNodes<Node>(label, label->store);
+        }
+
+    // Iterate on functions
+    public:
+        template<typename Func>
+        inline void forEdgesOnNode(Node const* node, Func func) const
+        {
+            for (Edge const* edge : edgesOnNode(node))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, edge))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forNodesInEdge(Edge const* edge, Func func) const
+        {
+            for (Node const* node : nodesInEdge(edge))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, node))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forPropsOnNode(Node const* node, Func func) const
+        {
+            for (Prop const* prop : propsOnNode(node))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, prop))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forPropsOnEdge(Edge const* edge, Func func) const
+        {
+            for (Prop const* prop : propsOnEdge(edge))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, prop))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forNodesInPath(Path const* path, Func func) const
+        {
+            for (Node const* node : nodesInPath(path))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, node))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forEdgesInPath(Path const* path, Func func) const
+        {
+            for (Edge const* edge : edgesInPath(path))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, edge))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forNodesInLabel(Label const* label, Func func) const
+        {
+            for (Node const* node : nodesInLabel(label))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, node))
+                    break;
+            }
+        }
+
+    // Attach functions
+    public:
+        inline void attachLabel(Node const* node, Label const* label)
+        {
+            _storage.attachNodeLabel(
                 node, node->store,
                 label, label->store
             );
@@ -256,28 +1818,29 @@ namespace model
 
         inline void attachEdge(Node* node, Edge* edge)
         {
-            auto list = _storage.template getEdgeListOfNodes<Node>(edge, edge->store);
-
-            list.insert(list.end(), node);
-
-            _storage.setEdgeListOfNodes(
-                edge, edge->store,
-                list.begin(), list.end(), [](Node const* n){ return &n->store; }
-            );
+            attachEdge(node, edge, nodesInEdge(edge).size());
         }
 
         inline void attachEdge(Node* node, Edge* edge, size_t index)
         {
-            auto list = _storage.template getEdgeListOfNodes<Node>(edge, edge->store);
-
-            if (index > list.size())
+            if (index > nodesInEdge(edge).size())
                 throw graph_error("Argument `index` out of range.");
 
-            list.insert(list.begin() + index, node);
-            
-            _storage.setEdgeListOfNodes(
-                edge, edge->store,
-                list.begin(), list.end(), [](Node const* n){ return &n->store; }
+            if constexpr (hasEdgePartitionIndex)
+            {
+                _requireIndexes();
+                [[maybe_unused]] auto lock = _lockIndexes();
+                auto predicate = _edgePartitionIndex._predicates.at(edge->data);
+                auto nodes = nodesInEdge(edge);
+                if (index == 0 && !nodes.empty())
+                    _flipPartitionEdge(*nodes.begin(), predicate, edge, TConfig::Storage::Store::isOutgoingSlot(false, edge->inverted));
+                _pushPartitionEdge(node, predicate, edge, TConfig::Storage::Store::isOutgoingSlot(index == 0, edge->inverted));
+            }
+
+            _storage.attachEdgeNode(
+                edge, edge->store, edge->inverted,
+                index,
+                node, node->store
             );
         }
 
@@ -285,16 +1848,15 @@ namespace model
     public:
         inline int indexOfNodeInEdge(Node const* node, Edge const* edge) const
         {
-            auto list = _storage.template getEdgeListOfNodes<Node>(edge, edge->store);
-            auto list_begin = list.begin();
-            auto list_end = list.end();
-
-            auto it = std::find(list_begin, list_end, node);
+            int index = 0;
+            for (Node const* edge_node : nodesInEdge(edge))
+            {
+                if (edge_node == node)
+                    return index;
+                ++index;
+            }
 
-            if (it == list_end)
-                return -1;
-            
-            return it - list_begin;
+            return -1;
         }
 
         inline int indexOfNodeInEdgeThrowing(Node const* node, Edge const* edge) const
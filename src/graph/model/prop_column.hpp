@@ -0,0 +1,152 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <limits>
+#include <cstdint>
+
+#include "graph/util.hpp"
+
+namespace ugly {
+namespace model
+{
+    // The values of one prop key, by node index. A column starts out sparse (a hash map) and turns
+    // dense (an array indexed by node) once the key is on a large enough share of the nodes.
+    template<typename TValue>
+    class PropColumn
+    {
+    public:
+        static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    protected:
+        // columns stay sparse below this many values, and while less than a quarter of the nodes
+        // have the key
+        static constexpr size_t _denseMinimum = 64;
+        static constexpr size_t _denseShare = 4;
+
+        std::unordered_map<uint32_t, TValue> _sparse;
+        std::vector<std::optional<TValue>> _dense;
+        size_t _count = 0;
+        bool _isDense = false;
+
+    public:
+        inline size_t size() const { return _count; }
+        inline bool dense() const { return _isDense; }
+
+        // An estimate, sparse entries are counted with a node pointer and a bucket each.
+        inline size_t memoryBytes() const
+        {
+            return _dense.capacity() * sizeof(std::optional<TValue>)
+                + _sparse.size() * (sizeof(std::pair<uint32_t const, TValue>) + sizeof(void*))
+                + _sparse.bucket_count() * sizeof(void*);
+        }
+
+        inline TValue const* get(uint32_t index) const
+        {
+            if (_isDense)
+                return index < _dense.size() && _dense[index] ? &*_dense[index] : nullptr;
+
+            auto it = _sparse.find(index);
+            return it != _sparse.end() ? &it->second : nullptr;
+        }
+
+        // `slots` is the number of node indices in use, it decides when the column turns dense.
+        inline void set(uint32_t index, TValue const& value, size_t slots)
+        {
+            if (_isDense)
+            {
+                if (index >= _dense.size())
+                    _dense.resize((size_t)index + 1);
+                if (!_dense[index])
+                    ++_count;
+                _dense[index] = value;
+                return;
+            }
+
+            if (_sparse.insert_or_assign(index, value).second)
+                ++_count;
+            if (_shouldBeDense(slots))
+                _toDense();
+        }
+
+        inline bool erase(uint32_t index)
+        {
+            if (_isDense)
+            {
+                if (index >= _dense.size() || !_dense[index])
+                    return false;
+                _dense[index].reset();
+            }
+            else if (_sparse.erase(index) == 0)
+                return false;
+
+            --_count;
+            return true;
+        }
+
+        // Visits the (index, value) pairs, in index order when dense.
+        template<typename Func>
+        inline void forEach(Func func) const
+        {
+            if (_isDense)
+            {
+                for (size_t i = 0; i < _dense.size(); ++i)
+                {
+                    if (_dense[i] && !_detail::invoke_return_bool_or_true(func, (uint32_t)i, *_dense[i]))
+                        break;
+                }
+            }
+            else
+            {
+                for (auto& entry : _sparse)
+                {
+                    if (!_detail::invoke_return_bool_or_true(func, entry.first, entry.second))
+                        break;
+                }
+            }
+        }
+
+        // Moves the values to new node indices, `renumbered` maps old indices to new ones (`npos`
+        // drops the value). The layout is picked again for the new number of slots.
+        inline void remap(std::vector<uint32_t> const& renumbered, size_t slots)
+        {
+            std::unordered_map<uint32_t, TValue> sparse;
+            forEach([&](uint32_t index, TValue const& value)
+            {
+                auto to = index < renumbered.size() ? renumbered[index] : npos;
+                if (to != npos)
+                    sparse.emplace(to, value);
+            });
+
+            _sparse = std::move(sparse);
+            _dense.clear();
+            _count = _sparse.size();
+            _isDense = false;
+            if (_shouldBeDense(slots))
+                _toDense();
+        }
+
+    protected:
+        inline bool _shouldBeDense(size_t slots) const
+        {
+            return _count >= _denseMinimum && _count * _denseShare >= slots;
+        }
+
+        inline void _toDense()
+        {
+            for (auto& entry : _sparse)
+            {
+                if (entry.first >= _dense.size())
+                    _dense.resize((size_t)entry.first + 1);
+                _dense[entry.first] = std::move(entry.second);
+            }
+            _sparse.clear();
+            _isDense = true;
+        }
+    };
+}}
@@ -0,0 +1,248 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <utility>
+
+#include "graph/util.hpp"
+#include "ppg_model.hpp"
+
+namespace ugly {
+namespace model
+{
+    // A read only view of a versioned graph as of the epoch it pinned. It offers the read functions
+    // of the graph, so it can be queried like one while a writer keeps adding to the graph.
+    //
+    // The indexes of the graph are not versioned, a snapshot reads without them.
+    template <typename TGraph>
+    class GraphSnapshot
+    {
+    public:
+        using Graph = TGraph;
+
+        using NodeData = typename TGraph::NodeData;
+        using EdgeData = typename TGraph::EdgeData;
+        using PathData = typename TGraph::PathData;
+        using LabelData = typename TGraph::LabelData;
+        using PropData = typename TGraph::PropData;
+
+        using Node = typename TGraph::Node;
+        using Edge = typename TGraph::Edge;
+        using Path = typename TGraph::Path;
+        using Label = typename TGraph::Label;
+        using Prop = typename TGraph::Prop;
+
+        using Epoch = typename std::decay_t<decltype(std::declval<TGraph const&>()._storage)>::Epoch;
+
+        static constexpr bool hasNodeDataIndex = false;
+        static constexpr bool hasEdgePartitionIndex = false;
+        static constexpr bool hasDenseHandles = false;
+        static constexpr bool isConcurrent = false;
+        static constexpr bool isVersioned = true;
+
+        using PredicateId = typename TGraph::PredicateId;
+        static constexpr PredicateId noPredicate = TGraph::noPredicate;
+
+    private:
+        TGraph const* _graph;
+        Epoch _epoch;
+
+    public:
+        inline GraphSnapshot(TGraph const* graph)
+            : _graph(graph), _epoch(graph->_storage.pinEpoch())
+        { }
+
+        inline GraphSnapshot(GraphSnapshot const&) = delete;
+        inline GraphSnapshot(GraphSnapshot && that)
+            : _graph(std::exchange(that._graph, nullptr)), _epoch(that._epoch)
+        { }
+
+        inline ~GraphSnapshot()
+        {
+            if (_graph != nullptr)
+                _graph->_storage.unpinEpoch(_epoch);
+        }
+
+        inline Epoch epoch() const { return _epoch; }
+
+    // Count functions
+    public:
+        inline size_t nodeCount() const { return _storage().template countPrimaryNodeStore<Node>(_epoch); }
+        inline size_t edgeCount() const { return _storage().template countPrimaryEdgeStore<Edge>(_epoch); }
+        inline size_t pathCount() const { return _storage().template countPrimaryPathStore<Path>(_epoch); }
+        inline size_t labelCount() const { return _storage().template countPrimaryLabelStore<Label>(_epoch); }
+        inline size_t propCount() const { return _storage().template countPrimaryPropStore<Prop>(_epoch); }
+
+    // Introspection functions
+    public:
+        static inline bool isEdgeInverted(Edge const* edge)
+        {
+            return TGraph::isEdgeInverted(edge);
+        }
+
+    // Iterate all functions
+    public:
+        template<typename Func>
+        inline void forAllNodes(Func func) const
+        {
+            auto end = _storage().template allNodesEnd<Node>(_epoch);
+            for (auto node_it = _storage().template allNodesBegin<Node>(_epoch); node_it != end; ++node_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Node const*)&*node_it))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forAllEdges(Func func) const
+        {
+            auto end = _storage().template allEdgesEnd<Edge>(_epoch);
+            for (auto edge_it = _storage().template allEdgesBegin<Edge>(_epoch); edge_it != end; ++edge_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Edge const*)&*edge_it))
+                    break;
+            }
+        }
+
+        // Snapshots read without the graph's indexes, this scans every edge.
+        template<typename Func>
+        inline void forEdgesWithData(EdgeData const& data, Func func) const
+        {
+            forAllEdges([&](Edge const* edge)
+            {
+                return !(edge->data == data) || _detail::invoke_return_bool_or_true(func, edge);
+            });
+        }
+
+        template<typename Func>
+        inline void forAllLabels(Func func) const
+        {
+            auto end = _storage().template allLabelsEnd<Label>(_epoch);
+            for (auto label_it = _storage().template allLabelsBegin<Label>(_epoch); label_it != end; ++label_it)
+            {
+                if (!_detail::invoke_return_bool_or_true(func, (Label const*)&*label_it))
+                    break;
+            }
+        }
+
+    // Range functions
+    public:
+        inline auto edgesOnNode(Node const* node) const
+        {
+            return _storage().template getNodeListOfEdges<Edge>(node, node->store, _epoch);
+        }
+
+        inline auto outEdgesOnNode(Node const* node) const
+        {
+            return _storage().template getNodeListOfOutEdges<Edge>(node, node->store, _epoch);
+        }
+
+        inline auto inEdgesOnNode(Node const* node) const
+        {
+            return _storage().template getNodeListOfInEdges<Edge>(node, node->store, _epoch);
+        }
+
+        inline auto nodesInEdge(Edge const* edge) const
+        {
+            return _storage().template getEdgeListOfNodes<Node>(edge, edge->store, _epoch);
+        }
+
+        inline auto sourceNodesInEdge(Edge const* edge) const
+        {
+            auto nodes = nodesInEdge(edge);
+            auto first_end = std::next(nodes.begin());
+            return edge->inverted ? decltype(nodes)(first_end, nodes.end()) : decltype(nodes)(nodes.begin(), first_end);
+        }
+
+        inline auto targetNodesInEdge(Edge const* edge) const
+        {
+            auto nodes = nodesInEdge(edge);
+            auto first_end = std::next(nodes.begin());
+            return edge->inverted ? decltype(nodes)(nodes.begin(), first_end) : decltype(nodes)(first_end, nodes.end());
+        }
+
+        inline auto propsOnNode(Node const* node) const
+        {
+            return _storage().template getNodeListOfProps<Prop>(node, node->store, _epoch);
+        }
+
+        inline auto propsOnEdge(Edge const* edge) const
+        {
+            return _storage().template getEdgeListOfProps<Prop>(edge, edge->store, _epoch);
+        }
+
+    // Iterate on functions
+    public:
+        template<typename Func>
+        inline void forEdgesOnNode(Node const* node, Func func) const
+        {
+            for (Edge const* edge : edgesOnNode(node))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, edge))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forNodesInEdge(Edge const* edge, Func func) const
+        {
+            for (Node const* node : nodesInEdge(edge))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, node))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forPropsOnNode(Node const* node, Func func) const
+        {
+            for (Prop const* prop : propsOnNode(node))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, prop))
+                    break;
+            }
+        }
+
+        template<typename Func>
+        inline void forPropsOnEdge(Edge const* edge, Func func) const
+        {
+            for (Prop const* prop : propsOnEdge(edge))
+            {
+                if (!_detail::invoke_return_bool_or_true(func, prop))
+                    break;
+            }
+        }
+
+    // Relationship introspection functions
+    public:
+        inline int indexOfNodeInEdge(Node const* node, Edge const* edge) const
+        {
+            int index = 0;
+            for (Node const* edge_node : nodesInEdge(edge))
+            {
+                if (edge_node == node)
+                    return index;
+                ++index;
+            }
+
+            return -1;
+        }
+
+        inline int indexOfNodeInEdgeThrowing(Node const* node, Edge const* edge) const
+        {
+            auto res = indexOfNodeInEdge(node, edge);
+            if (res == -1)
+                throw graph_error("Node not in edge relation.");
+
+            return res;
+        }
+
+    private:
+        inline auto const& _storage() const
+        {
+            return _graph->_storage;
+        }
+    };
+}}
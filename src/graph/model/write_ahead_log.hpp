@@ -0,0 +1,548 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "graph/util.hpp"
+#include "binary.hpp"
+
+/*
+ * This file contains the write ahead log, which makes additions to a graph durable:
+ * - Adds and attaches made through the log are applied to the graph and appended to an in memory
+ *   buffer, they never wait on I/O.
+ * - A flusher thread writes the buffer and syncs the file in batches (group commit), `sync()` waits
+ *   until everything logged before it is durable.
+ * - Records refer to elements by number: elements in the graph when the log starts are numbered
+ *   in the order a binary snapshot of the graph writes them, later ones as they are added.
+ *
+ * Replaying the log on top of the snapshot taken when it started rebuilds the graph, a torn record
+ * at the end (from a crash mid write) is dropped.
+ */
+
+namespace ugly {
+namespace model
+{
+    template<typename TGraph>
+    class GraphWriteAheadLog
+    {
+    public:
+        using Graph = TGraph;
+        using Node = typename TGraph::Node;
+        using Edge = typename TGraph::Edge;
+        using Label = typename TGraph::Label;
+        using Prop = typename TGraph::Prop;
+
+        struct Options
+        {
+            // the longest a logged mutation waits before the flusher picks it up
+            std::chrono::milliseconds flushInterval = std::chrono::milliseconds(5);
+            // flush early once this much is buffered
+            size_t flushBytes = size_t(1) << 20;
+        };
+
+    protected:
+        enum class _Op : uint8_t
+        {
+            AddLabel = 1,
+            AddNode = 2,
+            AddEdge = 3,
+            AddNodeProp = 4,
+            AddEdgeProp = 5,
+            AttachEdge = 6,
+            AttachLabel = 7,
+            SetProp = 8,
+            RemoveKeyedProp = 9,
+        };
+
+        // Numbers the elements records refer to.
+        struct _Ids
+        {
+            std::vector<Node*> _nodes;
+            std::vector<Edge*> _edges;
+            std::vector<Label*> _labels;
+            std::unordered_map<Node const*, uint64_t> _nodeIds;
+            std::unordered_map<Edge const*, uint64_t> _edgeIds;
+            std::unordered_map<Label const*, uint64_t> _labelIds;
+
+            // the order of `saveSnapshot`: nodes and labels as iterated, edges as first seen on nodes
+            inline _Ids(TGraph const& graph)
+            {
+                graph.forAllLabels([&](Label const* label) { push(label); });
+                graph.forAllNodes([&](Node const* node) { push(node); });
+                for (size_t i = 0; i < _nodes.size(); ++i)
+                {
+                    for (Edge const* edge : graph.edgesOnNode(_nodes[i]))
+                    {
+                        if (_edgeIds.find(edge) == _edgeIds.end())
+                            push(edge);
+                    }
+                }
+            }
+
+            inline void push(Node const* node)
+            {
+                _nodeIds.emplace(node, _nodes.size());
+                _nodes.push_back(const_cast<Node*>(node));
+            }
+            inline void push(Edge const* edge)
+            {
+                _edgeIds.emplace(edge, _edges.size());
+                _edges.push_back(const_cast<Edge*>(edge));
+            }
+            inline void push(Label const* label)
+            {
+                _labelIds.emplace(label, _labels.size());
+                _labels.push_back(const_cast<Label*>(label));
+            }
+
+            template<typename T>
+            static inline uint64_t idOf(std::unordered_map<T const*, uint64_t> const& ids, T const* ref)
+            {
+                auto it = ids.find(ref);
+                if (it == ids.end())
+                    throw graph_error("Element is not known to the write ahead log.");
+                return it->second;
+            }
+
+            template<typename T>
+            static inline T* resolve(std::vector<T*> const& refs, uint64_t id)
+            {
+                if (id >= refs.size())
+                    throw graph_error("Corrupt write ahead log.");
+                return refs[id];
+            }
+        };
+
+    private:
+        TGraph* _graph;
+        Options _options;
+        int _fd;
+
+        // guards the ids, the buffer, and the counters below
+        std::mutex _lock;
+        std::condition_variable _flushWake;
+        std::condition_variable _durableWake;
+        _Ids _ids;
+        std::ostringstream _record;
+        std::string _buffer;
+        uint64_t _logged;
+        uint64_t _durable;
+        uint64_t _syncWanted;
+        bool _stopping;
+        bool _failed;
+
+        std::thread _flusher;
+
+    public:
+        // Appends to the log at `path`, the graph must be in the state the log starts from (e.g.
+        // just loaded from a snapshot and replayed).
+        inline GraphWriteAheadLog(TGraph& graph, std::string const& path, Options options = Options())
+            : _graph(&graph), _options(options), _fd(-1), _ids(graph), _record(std::ios::binary)
+            , _logged(0), _durable(0), _syncWanted(0), _stopping(false), _failed(false)
+        {
+            _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (_fd < 0)
+                throw graph_error("Could not open write ahead log `" + path + "`.");
+
+            _flusher = std::thread([this]() { _flushLoop(); });
+        }
+
+        inline GraphWriteAheadLog(GraphWriteAheadLog const&) = delete;
+
+        inline ~GraphWriteAheadLog()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stopping = true;
+            }
+            _flushWake.notify_all();
+            _flusher.join();
+
+            ::close(_fd);
+        }
+
+    // Add functions
+    public:
+        inline Label* addLabel(typename TGraph::LabelData const& data)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            Label* ref = _graph->addLabel(data);
+            _ids.push(ref);
+
+            _beginRecord(_Op::AddLabel);
+            BinaryCodec<typename TGraph::LabelData>::write(_record, data);
+            _endRecord();
+            return ref;
+        }
+
+        inline Node* addNode(typename TGraph::NodeData const& data)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            Node* ref = _graph->addNode(data);
+            _ids.push(ref);
+
+            _beginRecord(_Op::AddNode);
+            BinaryCodec<typename TGraph::NodeData>::write(_record, data);
+            _endRecord();
+            return ref;
+        }
+
+        inline Edge* addEdge(typename TGraph::EdgeData const& data, std::vector<Node const*> const& nodes, bool invert = false)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            // resolve first, unknown nodes must not leave an unlogged edge behind
+            std::vector<uint64_t> node_ids;
+            for (Node const* node : nodes)
+                node_ids.push_back(_Ids::idOf(_ids._nodeIds, node));
+
+            Edge* ref = _graph->addEdge(data, nodes, invert);
+            _ids.push(ref);
+
+            _beginRecord(_Op::AddEdge);
+            BinaryCodec<typename TGraph::EdgeData>::write(_record, data);
+            BinaryCodec<uint8_t>::write(_record, (uint8_t)invert);
+            BinaryCodec<uint32_t>::write(_record, (uint32_t)node_ids.size());
+            for (auto id : node_ids)
+                BinaryCodec<uint64_t>::write(_record, id);
+            _endRecord();
+            return ref;
+        }
+
+        inline Prop* addProp(typename TGraph::PropData const& data, Node* on_node)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto id = _Ids::idOf(_ids._nodeIds, (Node const*)on_node);
+            Prop* ref = _graph->addProp(data, on_node);
+
+            _beginRecord(_Op::AddNodeProp);
+            BinaryCodec<uint64_t>::write(_record, id);
+            BinaryCodec<typename TGraph::PropData>::write(_record, data);
+            _endRecord();
+            return ref;
+        }
+
+        inline Prop* addProp(typename TGraph::PropData const& data, Edge* on_edge)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto id = _Ids::idOf(_ids._edgeIds, (Edge const*)on_edge);
+            Prop* ref = _graph->addProp(data, on_edge);
+
+            _beginRecord(_Op::AddEdgeProp);
+            BinaryCodec<uint64_t>::write(_record, id);
+            BinaryCodec<typename TGraph::PropData>::write(_record, data);
+            _endRecord();
+            return ref;
+        }
+
+        // Keyed props, only on storages that have them.
+        inline void setProp(Node* node, typename TGraph::PropKey const& key, typename TGraph::PropData const& data)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto id = _Ids::idOf(_ids._nodeIds, (Node const*)node);
+            _graph->setProp(node, key, data);
+
+            _beginRecord(_Op::SetProp);
+            BinaryCodec<uint64_t>::write(_record, id);
+            BinaryCodec<typename TGraph::PropKey>::write(_record, key);
+            BinaryCodec<typename TGraph::PropData>::write(_record, data);
+            _endRecord();
+        }
+
+        inline bool removeProp(Node* node, typename TGraph::PropKey const& key)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto id = _Ids::idOf(_ids._nodeIds, (Node const*)node);
+            if (!_graph->removeProp(node, key))
+                return false;
+
+            _beginRecord(_Op::RemoveKeyedProp);
+            BinaryCodec<uint64_t>::write(_record, id);
+            BinaryCodec<typename TGraph::PropKey>::write(_record, key);
+            _endRecord();
+            return true;
+        }
+
+    // Attach functions
+    public:
+        inline void attachLabel(Node* node, Label* label)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto node_id = _Ids::idOf(_ids._nodeIds, (Node const*)node);
+            auto label_id = _Ids::idOf(_ids._labelIds, (Label const*)label);
+            _graph->attachLabel(node, label);
+
+            _beginRecord(_Op::AttachLabel);
+            BinaryCodec<uint64_t>::write(_record, node_id);
+            BinaryCodec<uint64_t>::write(_record, label_id);
+            _endRecord();
+        }
+
+        inline void attachEdge(Node* node, Edge* edge)
+        {
+            attachEdge(node, edge, _graph->nodesInEdge(edge).size());
+        }
+
+        inline void attachEdge(Node* node, Edge* edge, size_t index)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto node_id = _Ids::idOf(_ids._nodeIds, (Node const*)node);
+            auto edge_id = _Ids::idOf(_ids._edgeIds, (Edge const*)edge);
+            _graph->attachEdge(node, edge, index);
+
+            _beginRecord(_Op::AttachEdge);
+            BinaryCodec<uint64_t>::write(_record, node_id);
+            BinaryCodec<uint64_t>::write(_record, edge_id);
+            BinaryCodec<uint64_t>::write(_record, (uint64_t)index);
+            _endRecord();
+        }
+
+    // Durability functions
+    public:
+        // Waits until everything logged so far is on disk.
+        inline void sync()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            auto target = _logged;
+            _syncWanted = std::max(_syncWanted, target);
+            _flushWake.notify_all();
+            _durableWake.wait(lock, [&]() { return _durable >= target || _failed; });
+
+            if (_failed)
+                throw graph_error("Could not write the write ahead log.");
+        }
+
+        inline uint64_t loggedCount()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            return _logged;
+        }
+
+        inline uint64_t durableCount()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            return _durable;
+        }
+
+        // Applies the log at `path` to the graph, which must be in the state the log started from.
+        // Returns the number of records applied, a torn record at the end is cut from the file.
+        static inline size_t replay(TGraph& graph, std::string const& path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return 0;
+
+            in.seekg(0, std::ios::end);
+            uint64_t length = (uint64_t)in.tellg();
+            in.seekg(0, std::ios::beg);
+
+            _Ids ids(graph);
+            size_t applied = 0;
+            uint64_t valid = 0;
+            std::string payload;
+            while (true)
+            {
+                uint32_t size = 0;
+                in.read((char*)&size, sizeof(size));
+                if (!in || size > length - valid)
+                    break;
+
+                payload.resize(size);
+                in.read(&payload[0], size);
+                uint32_t checksum = 0;
+                in.read((char*)&checksum, sizeof(checksum));
+                if (!in || checksum != _checksum(payload))
+                    break;
+
+                std::istringstream record(payload, std::ios::binary);
+                _apply(graph, ids, record);
+
+                ++applied;
+                valid += sizeof(size) + size + sizeof(checksum);
+            }
+            in.close();
+
+            if (::truncate(path.c_str(), (off_t)valid) != 0)
+                throw graph_error("Could not cut the write ahead log `" + path + "`.");
+            return applied;
+        }
+
+    // helpers
+    private:
+        inline void _beginRecord(_Op op)
+        {
+            _record.str(std::string());
+            BinaryCodec<uint8_t>::write(_record, (uint8_t)op);
+        }
+
+        inline void _endRecord()
+        {
+            auto payload = _record.str();
+            auto size = (uint32_t)payload.size();
+            auto checksum = _checksum(payload);
+
+            _buffer.append((char const*)&size, sizeof(size));
+            _buffer.append(payload);
+            _buffer.append((char const*)&checksum, sizeof(checksum));
+            ++_logged;
+
+            if (_buffer.size() >= _options.flushBytes)
+                _flushWake.notify_all();
+        }
+
+        inline void _flushLoop()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            while (true)
+            {
+                _flushWake.wait_for(lock, _options.flushInterval, [&]()
+                {
+                    return _stopping || _syncWanted > _durable || _buffer.size() >= _options.flushBytes;
+                });
+
+                if (_logged > _durable && !_failed)
+                {
+                    // writers keep appending to a fresh buffer while this batch is written
+                    std::string batch;
+                    batch.swap(_buffer);
+                    auto batch_logged = _logged;
+
+                    lock.unlock();
+                    bool ok = _writeAll(batch) && ::fsync(_fd) == 0;
+                    lock.lock();
+
+                    if (ok)
+                        _durable = batch_logged;
+                    else
+                        _failed = true;
+                    _durableWake.notify_all();
+                }
+
+                if (_stopping && (_logged == _durable || _failed))
+                    return;
+            }
+        }
+
+        inline bool _writeAll(std::string const& batch)
+        {
+            size_t done = 0;
+            while (done < batch.size())
+            {
+                auto res = ::write(_fd, batch.data() + done, batch.size() - done);
+                if (res < 0)
+                    return false;
+                done += (size_t)res;
+            }
+            return true;
+        }
+
+        static inline uint32_t _checksum(std::string const& payload)
+        {
+            // FNV-1a, enough to tell a torn record from a whole one
+            uint32_t hash = 2166136261u;
+            for (char c : payload)
+                hash = (hash ^ (uint8_t)c) * 16777619u;
+            return hash;
+        }
+
+        template<typename T>
+        static inline T _read(std::istream& in)
+        {
+            auto value = BinaryCodec<T>::read(in);
+            if (!in)
+                throw graph_error("Corrupt write ahead log.");
+            return value;
+        }
+
+        static inline void _apply(TGraph& graph, _Ids& ids, std::istream& in)
+        {
+            auto op = (_Op)_read<uint8_t>(in);
+            switch (op)
+            {
+            case _Op::AddLabel:
+                ids.push(graph.addLabel(_read<typename TGraph::LabelData>(in)));
+                break;
+            case _Op::AddNode:
+                ids.push(graph.addNode(_read<typename TGraph::NodeData>(in)));
+                break;
+            case _Op::AddEdge:
+            {
+                auto data = _read<typename TGraph::EdgeData>(in);
+                auto inverted = _read<uint8_t>(in) != 0;
+                std::vector<Node const*> nodes;
+                auto count = _read<uint32_t>(in);
+                for (uint32_t i = 0; i < count; ++i)
+                    nodes.push_back(_Ids::resolve(ids._nodes, _read<uint64_t>(in)));
+                ids.push(graph.addEdge(data, nodes, inverted));
+                break;
+            }
+            case _Op::AddNodeProp:
+            {
+                auto node = _Ids::resolve(ids._nodes, _read<uint64_t>(in));
+                graph.addProp(_read<typename TGraph::PropData>(in), node);
+                break;
+            }
+            case _Op::AddEdgeProp:
+            {
+                auto edge = _Ids::resolve(ids._edges, _read<uint64_t>(in));
+                graph.addProp(_read<typename TGraph::PropData>(in), edge);
+                break;
+            }
+            case _Op::AttachEdge:
+            {
+                auto node = _Ids::resolve(ids._nodes, _read<uint64_t>(in));
+                auto edge = _Ids::resolve(ids._edges, _read<uint64_t>(in));
+                graph.attachEdge(node, edge, (size_t)_read<uint64_t>(in));
+                break;
+            }
+            case _Op::AttachLabel:
+            {
+                auto node = _Ids::resolve(ids._nodes, _read<uint64_t>(in));
+                graph.attachLabel(node, _Ids::resolve(ids._labels, _read<uint64_t>(in)));
+                break;
+            }
+            case _Op::SetProp:
+            case _Op::RemoveKeyedProp:
+            {
+                if constexpr (TGraph::hasKeyedProps)
+                {
+                    auto node = _Ids::resolve(ids._nodes, _read<uint64_t>(in));
+                    auto key = _read<typename TGraph::PropKey>(in);
+                    if (op == _Op::SetProp)
+                        graph.setProp(node, key, _read<typename TGraph::PropData>(in));
+                    else
+                        graph.removeProp(node, key);
+                    break;
+                }
+                else
+                    throw graph_error("Corrupt write ahead log.");
+            }
+            default:
+                throw graph_error("Corrupt write ahead log.");
+            }
+        }
+    };
+}}
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <variant>
+#include <optional>
 #include <vector>
 #include <set>
 #include <tuple>
@@ -16,9 +17,13 @@
 /*
  * This file contains the query engine, which has the following parts:
  * - Gremlin
+ *   - Including the path it walked, when the pipeline tracks paths
  * - Pipe - Base class
  * - PipeLine - Container
  *   - Including interpreter
+ *
+ * Paths are chains of steps pointing at the step before them. Gremlins branching from a common
+ * prefix share its steps, each step only adds the edge it took and the node it reached.
  */
 
 namespace ugly
@@ -38,6 +43,16 @@ namespace ugly
     public:
         using Graph = TGraph;
 
+        // One step of a walked path, the first step has no edge.
+        struct PathStep
+        {
+            std::shared_ptr<PathStep const> parent;
+            typename TGraph::Edge const* edge;
+            typename TGraph::Node const* node;
+            // nodes up to and including this step
+            size_t length;
+        };
+
         class Gremlin
         {
         public:
@@ -45,6 +60,13 @@ namespace ugly
 
             std::map<size_t, typename TGraph::Node const*> marks;
 
+            // the end of the walked path, null when the pipeline does not track paths
+            std::shared_ptr<PathStep const> path;
+            // the path as it was at each mark, jumping back to a mark continues from it
+            std::map<size_t, std::shared_ptr<PathStep const>> markedPaths;
+            // set by a `path()` step, the data `runPaths()` stores the walked path with
+            std::optional<typename TGraph::PathData> pathData;
+
         public:
             typename TGraph::Node const* node() const
             {
@@ -52,6 +74,24 @@ namespace ugly
                 return std::get<typename TGraph::Node const*>(graphObject);
             }
 
+            // The walked path from its first node, as nodes and the edges between them.
+            inline void walkedPath(std::vector<typename TGraph::Node const*>& nodes, std::vector<typename TGraph::Edge const*>& edges) const
+            {
+                nodes.clear();
+                edges.clear();
+                if (!path)
+                    return;
+
+                nodes.resize(path->length);
+                edges.resize(path->length - 1);
+                for (auto step = path.get(); step != nullptr; step = step->parent.get())
+                {
+                    nodes[step->length - 1] = step->node;
+                    if (step->edge != nullptr)
+                        edges[step->length - 2] = step->edge;
+                }
+            }
+
 
         public:
             typename TGraph::Node const* getMarker(size_t mark) const
@@ -86,6 +126,10 @@ namespace ugly
         public:
             virtual ~PipeDescription() = default;
 
+        public:
+            // Pipes reading paths make their pipeline track them.
+            inline virtual bool tracksPaths() const { return false; }
+
         protected:
             inline virtual class PipeState* init() const = 0;
             virtual std::vector<std::shared_ptr<class PipeLine>> getSubPipelines() const = 0;
@@ -119,6 +163,7 @@ namespace ugly
         {
             std::vector<std::shared_ptr<PipeDescription>> _pipes;
             mutable std::atomic<int32_t> _inUse;
+            bool _tracksPaths;
 
             friend class PipeLineState;
 
@@ -126,6 +171,7 @@ namespace ugly
             PipeLineDescription()
                 : _pipes()
                 , _inUse(0)
+                , _tracksPaths(false)
             {
             }
 
@@ -143,6 +189,7 @@ namespace ugly
                 if (!_inUse.compare_exchange_strong(expected, -1))
                     throw graph_error("PipeLineDescription is in use, clone or wait for queries to finish.");
 
+                _tracksPaths |= pipe->tracksPaths();
                 _pipes.insert(_pipes.begin() + i, std::move(pipe));
 
                 _inUse = 0;
@@ -154,6 +201,7 @@ namespace ugly
                 if (!_inUse.compare_exchange_strong(expected, -1))
                     throw graph_error("PipeLineDescription is in use, clone or wait for queries to finish.");
 
+                _tracksPaths |= pipe->tracksPaths();
                 _pipes.push_back(std::move(pipe));
 
                 _inUse = 0;
@@ -179,6 +227,7 @@ namespace ugly
                 {
                     _pipes.push_back(it);
                 }
+                _tracksPaths |= description->_tracksPaths;
 
                 description->_inUse = 0;
                 _inUse = 0;
@@ -188,6 +237,11 @@ namespace ugly
             {
                 return _pipes.size();
             }
+
+            inline bool tracksPaths() const
+            {
+                return _tracksPaths;
+            }
         };
 
         class PipeLineState
@@ -304,6 +358,17 @@ namespace ugly
 
                 _i_maybeGremlin = _state[_i_pc - 1]->pipeFunc(graph, gremlin);
 
+                // gremlins start their path where they enter the pipeline, at the first pipe or at a
+                // source pipe further on
+                if (_description->_tracksPaths)
+                {
+                    if (auto started = std::get_if<std::shared_ptr<Gremlin>>(&_i_maybeGremlin))
+                    {
+                        if (*started && !(*started)->path)
+                            (*started)->path = std::make_shared<PathStep const>(PathStep { nullptr, nullptr, (*started)->node(), 1 });
+                    }
+                }
+
                 auto maybe_gremlin_is_enum = std::holds_alternative<PipeResultEnum>(_i_maybeGremlin);
                 if (maybe_gremlin_is_enum)
                 {
@@ -401,13 +466,12 @@ namespace ugly
 
             return ret;
         }
+        // A gremlin put on another node without walking to it starts a new path there.
         static inline std::shared_ptr<Gremlin> makeGremlin(typename TGraph::Node const* node, std::shared_ptr<Gremlin> const& original)
         {
-            if (!original)
-                return makeGremlin(node);
-
-            std::shared_ptr<Gremlin> ret = std::make_shared<Gremlin>(*original);
-            ret->graphObject = node;
+            auto ret = _copyGremlin(node, original);
+            if (ret->path && ret->path->node != node)
+                ret->path = std::make_shared<PathStep const>(PathStep { nullptr, nullptr, node, 1 });
 
             return ret;
         }
@@ -415,12 +479,55 @@ namespace ugly
         {
             return makeGremlin(node, current);
         }
+        // Walks `edge` to `node`, extending the path when it is tracked.
+        static inline std::shared_ptr<Gremlin> gotoVertex(std::shared_ptr<Gremlin> const& current, typename TGraph::Node const* node, typename TGraph::Edge const* edge)
+        {
+            auto ret = _copyGremlin(node, current);
+            if (ret->path)
+                ret->path = std::make_shared<PathStep const>(PathStep { ret->path, edge, node, ret->path->length + 1 });
+
+            return ret;
+        }
+        // Jumps back to the node marked `mark`, with the path as it was when the mark was set.
+        static inline std::shared_ptr<Gremlin> gotoMarker(std::shared_ptr<Gremlin> const& current, size_t mark)
+        {
+            auto node = current->getMarker(mark);
+            auto it = current->markedPaths.find(mark);
+            if (it == current->markedPaths.end())
+                return makeGremlin(node, current);
+
+            auto ret = _copyGremlin(node, current);
+            ret->path = it->second;
+
+            return ret;
+        }
+        // Continues `current` where a subquery seeded from it ended, keeping the marks of `current`
+        // and the path of `result`.
+        static inline std::shared_ptr<Gremlin> gotoResult(std::shared_ptr<Gremlin> const& current, std::shared_ptr<Gremlin> const& result)
+        {
+            auto ret = _copyGremlin(result->node(), current);
+            ret->path = result->path;
+
+            return ret;
+        }
 
         static inline std::shared_ptr<Gremlin> nullGremlin()
         {
             return std::shared_ptr<Gremlin>();
         }
 
+    private:
+        static inline std::shared_ptr<Gremlin> _copyGremlin(typename TGraph::Node const* node, std::shared_ptr<Gremlin> const& original)
+        {
+            if (!original)
+                return makeGremlin(node);
+
+            std::shared_ptr<Gremlin> ret = std::make_shared<Gremlin>(*original);
+            ret->graphObject = node;
+
+            return ret;
+        }
+
     // configure
     private:
         std::shared_ptr<PipeLineDescription> _pipelineDescription;
@@ -541,5 +648,31 @@ namespace ugly
 
             return ret;
         }
+
+        // Adds the walked path of every result that passed a `path()` step to the graph's path
+        // store, once the query ran, results without one are skipped.
+        inline std::vector<typename TGraph::Path const*> runPaths()
+        {
+            PipeLineState state(_pipelineDescription);
+            state.init();
+
+            auto results = state.run(_graph);
+
+            std::vector<typename TGraph::Path const*> ret;
+            ret.reserve(results.size());
+
+            std::vector<typename TGraph::Node const*> nodes;
+            std::vector<typename TGraph::Edge const*> edges;
+            for (auto grem : results)
+            {
+                if (!grem->pathData)
+                    continue;
+
+                grem->walkedPath(nodes, edges);
+                ret.push_back(_graph->addPath(*grem->pathData, nodes, edges));
+            }
+
+            return ret;
+        }
     };
 }
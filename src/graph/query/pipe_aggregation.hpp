@@ -6,6 +6,10 @@
 
 #include <memory>
 #include <set>
+#include <vector>
+#include <type_traits>
+
+#include "graph/bitmap.hpp"
 
 #include "engine.hpp"
 
@@ -28,7 +32,10 @@ namespace ugly
 
     // state
     protected:
-        std::set<typename TGraph::Node const*> _seen;
+        // a compressed bitmap of node handles when the storage has them
+        std::conditional_t<TGraph::hasDenseHandles,
+            Bitmap,
+            std::set<typename TGraph::Node const*>> _seen;
 
     public:
         inline GraphQueryPipeUnique()
@@ -54,9 +61,18 @@ namespace ugly
         {
             if (!gremlin)
                 return Query::PipeResultEnum::Pull;
-            if (_seen.count(gremlin->node()))
-                return Query::PipeResultEnum::Pull;
-            _seen.insert(gremlin->node());
+
+            if constexpr (TGraph::hasDenseHandles)
+            {
+                if (!_seen.add((uint32_t)graph->nodeHandle(gremlin->node())))
+                    return Query::PipeResultEnum::Pull;
+            }
+            else
+            {
+                if (_seen.count(gremlin->node()))
+                    return Query::PipeResultEnum::Pull;
+                _seen.insert(gremlin->node());
+            }
             return gremlin;
         }
     };
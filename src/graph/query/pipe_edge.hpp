@@ -8,10 +8,27 @@
 #include <vector>
 #include <type_traits>
 
+#include "graph/filters/filters.hpp"
+
 #include "engine.hpp"
 
 namespace ugly
 {
+    namespace _detail
+    {
+        // Picked lazily, graphs without the edge partition index need not declare its functions.
+        template<typename TGraph, bool TUsePartitions>
+        struct EdgeRangeOf
+        {
+            using type = decltype(std::declval<TGraph const&>().edgesOnNode(nullptr));
+        };
+
+        template<typename TGraph>
+        struct EdgeRangeOf<TGraph, true>
+        {
+            using type = decltype(std::declval<TGraph const&>().edgesOnNodeWithPredicate(nullptr, 0));
+        };
+    }
 
     enum class GraphQueryPipeEdgesEnum
     {
@@ -31,6 +48,17 @@ namespace ugly
     private:
         using Query = GraphQueryEngine<TGraph>;
 
+        // a value filter on edges jumps straight to the matching partition, when the graph has them
+        static constexpr bool _usePartitions = TGraph::hasEdgePartitionIndex && filter::is_value_filter<TFuncEdges>::value;
+
+        using EdgeRange = typename _detail::EdgeRangeOf<TGraph, _usePartitions>::type;
+        using NodeRange = decltype(std::declval<TGraph const&>().nodesInEdge(nullptr));
+
+        static_assert(_usePartitions
+            || (std::is_same_v<EdgeRange, decltype(std::declval<TGraph const&>().outEdgesOnNode(nullptr))>
+                && std::is_same_v<EdgeRange, decltype(std::declval<TGraph const&>().inEdgesOnNode(nullptr))>),
+            "Storage must use the same range type for all edge lists.");
+
     // config
     protected:
         TFuncEdges _func_edges;
@@ -39,18 +67,24 @@ namespace ugly
     // state
     protected:
         std::shared_ptr<typename Query::Gremlin> _gremlin;
-        std::vector<typename TGraph::Edge const*> _edges;
-        typename decltype(_edges)::const_iterator _edges_it;
-        std::vector<typename TGraph::Node const*> _nodes;
-        typename decltype(_nodes)::const_iterator _nodes_it;
+        typename TGraph::PredicateId _predicate;
+        bool _predicateResolved;
+        EdgeRange _edges;
+        typename EdgeRange::iterator _edges_it;
+        typename TGraph::Edge const* _edge;
+        NodeRange _nodes;
+        typename NodeRange::iterator _nodes_it;
 
     public:
         inline GraphQueryPipeEdges(TFuncEdges const& func_edges, TFuncEdgeNodes const& func_edgeNodes)
             : _func_edges(func_edges)
             , _func_edgeNodes(func_edgeNodes)
             , _gremlin()
+            , _predicate(TGraph::noPredicate)
+            , _predicateResolved(false)
             , _edges()
             , _edges_it(_edges.end())
+            , _edge(nullptr)
             , _nodes()
             , _nodes_it(_nodes.end())
         { }
@@ -69,38 +103,64 @@ namespace ugly
             return res;
         };
 
-        static inline bool _modeFilterEdges(TGraph const& g, typename TGraph::Node const* n, typename TGraph::Edge const* e)
+        // the storage keeps edges split by role, so the mode only picks which lists to walk
+        inline EdgeRange _modeEdges(TGraph const& g, typename TGraph::Node const* n)
         {
-            if constexpr (EMode == GraphQueryPipeEdgesEnum::All)
-                return true;
+            if constexpr (_usePartitions)
+            {
+                if (!_predicateResolved)
+                {
+                    _predicate = g.findEdgePredicate(_func_edges.value());
+                    _predicateResolved = true;
+                }
+
+                if constexpr (EMode == GraphQueryPipeEdgesEnum::All)
+                    return g.edgesOnNodeWithPredicate(n, _predicate);
+                else if constexpr (EMode == GraphQueryPipeEdgesEnum::Incoming)
+                    return g.inEdgesOnNodeWithPredicate(n, _predicate);
+                else if constexpr (EMode == GraphQueryPipeEdgesEnum::Outgoing)
+                    return g.outEdgesOnNodeWithPredicate(n, _predicate);
+                else
+                    static_assert(stdext::always_false<false>, "Bad EMode");
+            }
+            else if constexpr (EMode == GraphQueryPipeEdgesEnum::All)
+                return g.edgesOnNode(n);
             else if constexpr (EMode == GraphQueryPipeEdgesEnum::Incoming)
-                return edgeIsIncoming<TGraph>(g, n, e);
+                return g.inEdgesOnNode(n);
             else if constexpr (EMode == GraphQueryPipeEdgesEnum::Outgoing)
-                return edgeIsOutgoing<TGraph>(g, n, e);
+                return g.outEdgesOnNode(n);
             else
                 static_assert(stdext::always_false<false>, "Bad EMode");
             
         }
 
-        static inline bool _modeFilterEdgeNodes(TGraph const& g, typename TGraph::Node const* n, typename TGraph::Edge const* e, typename TGraph::Node const* en)
+        static inline NodeRange _modeEdgeNodes(TGraph const& g, typename TGraph::Edge const* e)
         {
             if constexpr (EMode == GraphQueryPipeEdgesEnum::All)
-                return n != en;
+                return g.nodesInEdge(e);
             else if constexpr (EMode == GraphQueryPipeEdgesEnum::Incoming)
-                return !edgeIsIncoming<TGraph>(g, en, e);
+                return g.sourceNodesInEdge(e);
             else if constexpr (EMode == GraphQueryPipeEdgesEnum::Outgoing)
-                return !edgeIsOutgoing<TGraph>(g, en, e);
+                return g.targetNodesInEdge(e);
             else
                 static_assert(stdext::always_false<false>, "Bad EMode");
             
         }
 
-        inline bool _call_func_edges(TGraph const& g, typename TGraph::Node const* n, typename TGraph::Edge const* e)
+        static inline bool _modeFilterEdgeNodes(typename TGraph::Node const* n, typename TGraph::Node const* en)
         {
-            if (!_modeFilterEdges(g, n, e))
-                return false;
+            if constexpr (EMode == GraphQueryPipeEdgesEnum::All)
+                return n != en;
+            else
+                return true;
+        }
 
-            if constexpr (std::is_invocable_v<TFuncEdges, decltype(e)>)
+        inline bool _call_func_edges(TGraph const& g, typename TGraph::Node const* n, typename TGraph::Edge const* e)
+        {
+            // every edge in the partition already matches
+            if constexpr (_usePartitions)
+                return true;
+            else if constexpr (std::is_invocable_v<TFuncEdges, decltype(e)>)
                 return _func_edges(e);
             else if constexpr (std::is_invocable_v<TFuncEdges, decltype(n), decltype(e)>)
                 return _func_edges(n, e);
@@ -110,7 +170,7 @@ namespace ugly
 
         inline bool _call_func_edgeNodes(TGraph const& g, typename TGraph::Node const* n, typename TGraph::Edge const* e, typename TGraph::Node const* en)
         {
-            if (!_modeFilterEdgeNodes(g, n, e, en))
+            if (!_modeFilterEdgeNodes(n, en))
                 return false;
 
             if constexpr (std::is_invocable_v<TFuncEdgeNodes, decltype(en)>)
@@ -132,34 +192,40 @@ namespace ugly
             if (!gremlin && empty)
                 return Query::PipeResultEnum::Pull;
 
-            // get a collection of edges on this node
+            // view the edges on this node in the direction of the mode
             if (empty) 
             {
                 _gremlin = gremlin;
 
-                auto n = _gremlin->node();
-                _edges = collectEdges(*graph, n,
-                    [&](auto e) { return _call_func_edges(*graph, n, e); });
+                _edges = _modeEdges(*graph, _gremlin->node());
                 _edges_it = _edges.begin();
+                _nodes = NodeRange();
                 _nodes_it = _nodes.end();
             }
 
-            // pop to a new edge
-            while (_nodes_it == _nodes.end()) 
+            auto n = _gremlin->node();
+            while (true)
             {
-                if (_edges_it == _edges.end())
-                    return Query::PipeResultEnum::Pull;
-
-                // TODO: simplyfy this, we know which nodes on the edge are the ones we want to
-                //   traverse, we may want to revert our iterator paradigm too.
-                auto n = _gremlin->node();
-                auto e = (typename TGraph::Edge const*) *(_edges_it ++);
-                _nodes = collectNodes(*graph, e, 
-                    [&](auto en) { return _call_func_edgeNodes(*graph, n, e, en); });
+                // pop to the next accepted node on the current edge
+                while (_nodes_it != _nodes.end())
+                {
+                    auto en = *(_nodes_it ++);
+                    if (_call_func_edgeNodes(*graph, n, _edge, en))
+                        return GraphQueryEngine<TGraph>::gotoVertex(_gremlin, en, _edge);
+                }
+
+                // pop to the next accepted edge
+                do
+                {
+                    if (_edges_it == _edges.end())
+                        return Query::PipeResultEnum::Pull;
+
+                    _edge = *(_edges_it ++);
+                } while (!_call_func_edges(*graph, n, _edge));
+
+                _nodes = _modeEdgeNodes(*graph, _edge);
                 _nodes_it = _nodes.begin();
             }
-
-            return GraphQueryEngine<TGraph>::gotoVertex(_gremlin, (typename TGraph::Node const*) *(_nodes_it ++));
         }
     };
     
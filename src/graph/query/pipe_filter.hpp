@@ -56,6 +56,8 @@ namespace ugly
                 filter_accepted = _func_nodes(gremlin->node());
             else if constexpr (std::is_invocable_v<TFuncNodes, decltype(gremlin->node()), decltype(gremlin)>)
                 filter_accepted = _func_nodes(gremlin->node(), gremlin);
+            else if constexpr (std::is_invocable_v<TFuncNodes, TGraph const*, decltype(gremlin->node())>)
+                filter_accepted = _func_nodes(graph, gremlin->node());
             else
                 static_assert(stdext::always_false<false>, "TFuncNodes bad signature.");
 
@@ -57,6 +57,8 @@ namespace ugly
                 return Query::PipeResultEnum::Pull;
             
             gremlin->marks[_mark] = gremlin->node();
+            if (gremlin->path)
+                gremlin->markedPaths[_mark] = gremlin->path;
 
             return gremlin;
         }
@@ -125,8 +127,7 @@ namespace ugly
 
             if (n != nullptr)
             {
-                ++_markers_it;
-                return Query::makeGremlin(n, _gremlin);
+                return Query::gotoMarker(_gremlin, *(_markers_it++));
             }
             else
             {
@@ -218,7 +219,7 @@ namespace ugly
             if (!gremlin)
                 return Query::PipeResultEnum::Pull;
             
-            return GraphQueryEngine<TGraph>::gotoVertex(gremlin, gremlin->getMarker(_marker));
+            return GraphQueryEngine<TGraph>::gotoMarker(gremlin, _marker);
         }
     };
 
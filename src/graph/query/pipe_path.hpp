@@ -0,0 +1,67 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <memory>
+
+#include "engine.hpp"
+
+namespace ugly
+{
+
+	/******************************************************************************
+	** GraphQueryPipePath
+	******************************************************************************/
+
+    // Marks each gremlin's walked path as a result, `runPaths()` adds it to the graph's path store
+    // after the run. Until then a path is only the gremlin's chain of steps, shared with every
+    // gremlin it branched from.
+    template<typename TGraph>
+    class GraphQueryPipePath
+        : public GraphQueryEngine<TGraph>::Pipe
+    {
+    private:
+        using Query = GraphQueryEngine<TGraph>;
+
+    // config
+    protected:
+        typename TGraph::PathData _data;
+
+    // state
+    protected:
+
+    public:
+        inline GraphQueryPipePath(typename TGraph::PathData const& data)
+            : _data(data)
+        { }
+
+        inline GraphQueryPipePath(GraphQueryPipePath const&) = default;
+
+        inline ~GraphQueryPipePath() = default;
+
+        inline virtual bool tracksPaths() const override { return true; }
+
+    protected:
+        inline virtual void cleanup() override { };
+
+        inline virtual typename Query::PipeResult pipeFunc(
+            TGraph const* graph,
+            std::shared_ptr<typename Query::Gremlin> const& gremlin
+        ) override
+        {
+            if (!gremlin)
+                return Query::PipeResultEnum::Pull;
+
+            if (!gremlin->path)
+                throw graph_error("Gremlin has no path, it entered a pipeline not tracking paths.");
+
+            auto ret = std::make_shared<typename Query::Gremlin>(*gremlin);
+            ret->pathData = _data;
+
+            return ret;
+        }
+    };
+
+}
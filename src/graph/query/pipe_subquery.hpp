@@ -52,6 +52,10 @@ namespace ugly
 
         inline ~GraphQuerySubQueryBase() = default;
 
+        // A pipe reading paths inside the subquery makes the enclosing pipeline track them too, so
+        // the paths start where the query starts rather than where the subquery does.
+        inline virtual bool tracksPaths() const override { return _pipeline->tracksPaths(); }
+
     protected:
 
     protected:
@@ -114,8 +118,7 @@ namespace ugly
         {
             if (_state.done())
                 _state.reset();
-            // TODO use gremlin source to inject gremlins
-            _getCurrentStateVertexPipe()->setNode(_gremlin->node());
+            _getCurrentStateVertexPipe()->setGremlin(_gremlin);
         }
 
         inline virtual typename Query::PipeResult pipeFunc(
@@ -156,7 +159,7 @@ namespace ugly
             }
             else
             {
-                result = GraphQueryEngine<TGraph>::gotoVertex(_gremlin, subquery_result->node());
+                result = GraphQueryEngine<TGraph>::gotoResult(_gremlin, subquery_result);
             }
             
             return result;
@@ -254,8 +257,7 @@ namespace ugly
         {
             if (_state.done())
                 _state.reset();
-            // TODO use gremlin source to inject gremlins
-            _getCurrentStateVertexPipe()->setNode(_gremlins.front()->node());
+            _getCurrentStateVertexPipe()->setGremlin(_gremlins.front());
         }
 
         inline virtual typename Query::PipeResult pipeFunc(
@@ -311,7 +313,7 @@ namespace ugly
                 }
             } while (!emit);
 
-            return GraphQueryEngine<TGraph>::gotoVertex(_gremlins.front(), subquery_result->node());
+            return GraphQueryEngine<TGraph>::gotoResult(_gremlins.front(), subquery_result);
         }
     };
 
@@ -352,7 +354,7 @@ namespace ugly
                 , gremlin(gremlin)
             {
                 state->init();
-                _getStateVertexPipe()->setNode(gremlin->node());
+                _getStateVertexPipe()->setGremlin(gremlin);
             }
 
             inline ~_DepthStackState()
@@ -468,7 +470,7 @@ namespace ugly
 
                 if (emit)
                 {
-                    subquery_result = GraphQueryEngine<TGraph>::gotoVertex(_state.top().gremlin, subquery_result->node());;
+                    subquery_result = GraphQueryEngine<TGraph>::gotoResult(_state.top().gremlin, subquery_result);
                 }
 
                 if (repeat)
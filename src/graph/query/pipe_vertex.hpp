@@ -26,6 +26,8 @@ namespace ugly
     // state
     protected:
         typename decltype(_nodes)::iterator _it;
+        // the gremlin the nodes continue, when it tracks a path
+        std::shared_ptr<typename Query::Gremlin> _source;
 
     public:
         inline GraphQueryPipeVertex()
@@ -55,6 +57,7 @@ namespace ugly
         {
             _nodes = nodes;
             _it = _nodes.begin();
+            _source = nullptr;
         }
         inline void setNode(typename TGraph::Node const* node)
         {
@@ -62,6 +65,14 @@ namespace ugly
                 throw graph_error("GraphQueryPipeVertex cannot be set to null vertex.");
             _nodes = { node };
             _it = _nodes.begin();
+            _source = nullptr;
+        }
+        // Starts from the gremlin's node, continuing its path when it tracks one.
+        inline void setGremlin(std::shared_ptr<typename Query::Gremlin> const& gremlin)
+        {
+            setNode(gremlin->node());
+            if (gremlin->path)
+                _source = gremlin;
         }
         inline std::vector<typename TGraph::Node const*> const& getNodes() const
         {
@@ -71,6 +82,7 @@ namespace ugly
         {
             _nodes.clear();
             _it = _nodes.begin();
+            _source = nullptr;
         }
 
     protected:
@@ -87,6 +99,205 @@ namespace ugly
             std::shared_ptr<typename Query::Gremlin> const& gremlin
         ) override
         {
+            if (_it == _nodes.end())
+                return Query::PipeResultEnum::Done;
+            else
+                return GraphQueryEngine<TGraph>::makeGremlin(*(_it ++), gremlin ? gremlin : _source);
+        }
+    };
+
+	/******************************************************************************
+	** GraphQueryPipeLabel
+	******************************************************************************/
+
+    // Starts from the nodes carrying a label, walking only the label's members.
+    template<typename TGraph>
+    class GraphQueryPipeLabel
+        : public GraphQueryEngine<TGraph>::Pipe
+    {
+    private:
+        using Query = GraphQueryEngine<TGraph>;
+
+        using NodeRange = decltype(std::declval<TGraph const&>().nodesInLabel(nullptr));
+
+    // config
+    protected:
+        typename TGraph::Label const* _label;
+
+    // state
+    protected:
+        bool _started;
+        NodeRange _nodes;
+        typename NodeRange::iterator _it;
+
+    public:
+        inline GraphQueryPipeLabel(typename TGraph::Label const* label)
+            : _label(label)
+            , _started(false)
+            , _nodes()
+            , _it(_nodes.end())
+        {
+            if (label == nullptr)
+                throw graph_error("GraphQueryPipeLabel cannot be set to null label.");
+        }
+
+        inline GraphQueryPipeLabel(GraphQueryPipeLabel const& that)
+            : GraphQueryPipeLabel(that._label)
+        { }
+
+        inline ~GraphQueryPipeLabel() = default;
+
+    protected:
+        virtual typename Query::Pipe* init() const override
+        {
+            return new GraphQueryPipeLabel(*this);
+        };
+
+        inline virtual typename Query::PipeResult pipeFunc(
+            TGraph const* graph,
+            std::shared_ptr<typename Query::Gremlin> const& gremlin
+        ) override
+        {
+            // the members are read when the query runs, not when it is built
+            if (!_started)
+            {
+                _nodes = graph->nodesInLabel(_label);
+                _it = _nodes.begin();
+                _started = true;
+            }
+
+            if (_it == _nodes.end())
+                return Query::PipeResultEnum::Done;
+            else
+                return GraphQueryEngine<TGraph>::makeGremlin(*(_it ++), gremlin);
+        }
+    };
+
+
+	/******************************************************************************
+	** GraphQueryPipePropLookup
+	******************************************************************************/
+
+    // Starts from the nodes a prop value index lookup finds. `TFuncRange` is called with the graph
+    // when the query runs and returns the index entries to walk, `TFuncMore` tells whether an
+    // entry's value still matches. One entry is walked per pull.
+    template<typename TGraph, typename TFuncRange, typename TFuncMore>
+    class GraphQueryPipePropLookup
+        : public GraphQueryEngine<TGraph>::Pipe
+    {
+    private:
+        using Query = GraphQueryEngine<TGraph>;
+
+        using EntryIterator = typename TGraph::PropValueRange::iterator;
+
+    // config
+    protected:
+        TFuncRange _func_range;
+        TFuncMore _func_more;
+
+    // state
+    protected:
+        bool _started;
+        EntryIterator _it;
+        EntryIterator _end;
+
+    public:
+        inline GraphQueryPipePropLookup(TFuncRange const& func_range, TFuncMore const& func_more)
+            : _func_range(func_range)
+            , _func_more(func_more)
+            , _started(false)
+            , _it()
+            , _end()
+        { }
+
+        inline GraphQueryPipePropLookup(GraphQueryPipePropLookup const& that)
+            : GraphQueryPipePropLookup(that._func_range, that._func_more)
+        { }
+
+        inline ~GraphQueryPipePropLookup() = default;
+
+    protected:
+        virtual typename Query::Pipe* init() const override
+        {
+            return new GraphQueryPipePropLookup(*this);
+        };
+
+        inline virtual typename Query::PipeResult pipeFunc(
+            TGraph const* graph,
+            std::shared_ptr<typename Query::Gremlin> const& gremlin
+        ) override
+        {
+            if (!_started)
+            {
+                auto entries = _func_range(graph);
+                _it = entries.begin();
+                _end = entries.end();
+                _started = true;
+            }
+
+            if (_it == _end || !_func_more(_it->first))
+                return Query::PipeResultEnum::Done;
+            else
+                return GraphQueryEngine<TGraph>::makeGremlin((_it ++)->second, gremlin);
+        }
+    };
+
+
+	/******************************************************************************
+	** GraphQueryPipeLookup
+	******************************************************************************/
+
+    // Starts from the nodes an index lookup visits. `TFuncLookup` is called with the graph and a
+    // visitor when the query runs.
+    template<typename TGraph, typename TFuncLookup>
+    class GraphQueryPipeLookup
+        : public GraphQueryEngine<TGraph>::Pipe
+    {
+    private:
+        using Query = GraphQueryEngine<TGraph>;
+
+    // config
+    protected:
+        TFuncLookup _func_lookup;
+
+    // state
+    protected:
+        bool _started;
+        std::vector<typename TGraph::Node const*> _nodes;
+        typename decltype(_nodes)::iterator _it;
+
+    public:
+        inline GraphQueryPipeLookup(TFuncLookup const& func_lookup)
+            : _func_lookup(func_lookup)
+            , _started(false)
+            , _nodes()
+            , _it(_nodes.end())
+        { }
+
+        inline GraphQueryPipeLookup(GraphQueryPipeLookup const& that)
+            : GraphQueryPipeLookup(that._func_lookup)
+        { }
+
+        inline ~GraphQueryPipeLookup() = default;
+
+    protected:
+        virtual typename Query::Pipe* init() const override
+        {
+            return new GraphQueryPipeLookup(*this);
+        };
+
+        inline virtual typename Query::PipeResult pipeFunc(
+            TGraph const* graph,
+            std::shared_ptr<typename Query::Gremlin> const& gremlin
+        ) override
+        {
+            if (!_started)
+            {
+                _func_lookup(graph, [&](typename TGraph::Node const* node, auto const&) { _nodes.push_back(node); });
+                _it = _nodes.begin();
+                _started = true;
+            }
+
             if (_it == _nodes.end())
                 return Query::PipeResultEnum::Done;
             else
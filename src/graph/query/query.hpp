@@ -89,6 +89,11 @@ namespace ugly
             return _engine->run();
         }
 
+        inline std::vector<typename TGraph::Path const*> runPaths()
+        {
+            return _engine->runPaths();
+        }
+
         inline bool done()
         {
             return _engine->done();
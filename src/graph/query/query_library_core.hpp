@@ -16,6 +16,7 @@
 #include "pipe_aggregation.hpp"
 #include "pipe_markers.hpp"
 #include "pipe_subquery.hpp"
+#include "pipe_path.hpp"
 
 namespace ugly
 {
@@ -30,6 +31,109 @@ namespace ugly
             return this->addPipe(std::make_unique<GraphQueryPipeVertex<TGraph>>(std::forward<TArgs>(args)...));
         }
 
+        // Starts from the nodes carrying the label, on storages tracking label membership.
+        template<typename TLabel, typename = std::enable_if_t<std::is_pointer_v<TLabel>
+            && std::is_convertible_v<TLabel, typename TGraph::Label const*>>>
+        TQueryFinal v(TLabel label)
+        {
+            return this->addPipe(std::make_unique<GraphQueryPipeLabel<TGraph>>(label));
+        }
+
+        // Starts from the nodes with a prop of the value (or of the value for the key), using the
+        // prop value index. The index is walked as the query pulls.
+        template<typename TValue>
+        TQueryFinal vWithProp(TValue value)
+        {
+            typename TGraph::PropData data(value);
+            return propLookup(
+                [data](auto graph) { return graph->propValuesFrom(data); },
+                [data](auto const& v) { return !(data < v); });
+        }
+        template<typename TKey, typename TValue>
+        TQueryFinal vWithProp(TKey key, TValue value)
+        {
+            typename TGraph::PropData data(value);
+            return propLookup(
+                [key = typename TGraph::PropKey(key), data](auto graph) { return graph->propValuesFrom(key, data); },
+                [data](auto const& v) { return !(data < v); });
+        }
+
+        // Starts from the nodes with a prop value in `[low, high)`.
+        template<typename TValue>
+        TQueryFinal vWithPropInRange(TValue low, TValue high)
+        {
+            return propLookup(
+                [low = typename TGraph::PropData(low)](auto graph) { return graph->propValuesFrom(low); },
+                [high = typename TGraph::PropData(high)](auto const& v) { return v < high; });
+        }
+        template<typename TKey, typename TValue>
+        TQueryFinal vWithPropInRange(TKey key, TValue low, TValue high)
+        {
+            return propLookup(
+                [key = typename TGraph::PropKey(key), low = typename TGraph::PropData(low)](auto graph) { return graph->propValuesFrom(key, low); },
+                [high = typename TGraph::PropData(high)](auto const& v) { return v < high; });
+        }
+
+        // Starts from the nodes with a prop value starting with the prefix.
+        template<typename TValue>
+        TQueryFinal vWithPropPrefix(TValue prefix)
+        {
+            typename TGraph::PropData data(prefix);
+            return propLookup(
+                [data](auto graph) { return graph->propValuesFrom(data); },
+                [data](auto const& v) { return TGraph::hasPropPrefix(v, data); });
+        }
+        template<typename TKey, typename TValue>
+        TQueryFinal vWithPropPrefix(TKey key, TValue prefix)
+        {
+            typename TGraph::PropData data(prefix);
+            return propLookup(
+                [key = typename TGraph::PropKey(key), data](auto graph) { return graph->propValuesFrom(key, data); },
+                [data](auto const& v) { return TGraph::hasPropPrefix(v, data); });
+        }
+
+        // Starts from the sources (or targets) of every edge carrying the data, once per edge, using
+        // the edge data index when it is configured.
+        template<typename TValue>
+        TQueryFinal vSourcesOf(TValue value)
+        {
+            return lookup([value = typename TGraph::EdgeData(value)](auto graph, auto visit)
+            {
+                graph->forEdgesWithData(value, [&](auto edge)
+                {
+                    for (auto node : graph->sourceNodesInEdge(edge))
+                        visit(node, edge);
+                });
+            });
+        }
+        template<typename TValue>
+        TQueryFinal vTargetsOf(TValue value)
+        {
+            return lookup([value = typename TGraph::EdgeData(value)](auto graph, auto visit)
+            {
+                graph->forEdgesWithData(value, [&](auto edge)
+                {
+                    for (auto node : graph->targetNodesInEdge(edge))
+                        visit(node, edge);
+                });
+            });
+        }
+
+        // Starts from the nodes a lookup visits, `func_lookup(graph, visit)` is called when the query runs.
+        template<typename TFuncLookup>
+        TQueryFinal lookup(TFuncLookup func_lookup)
+        {
+            return this->addPipe(std::make_unique<GraphQueryPipeLookup<TGraph, TFuncLookup>>(func_lookup));
+        }
+
+        // Starts from the prop value index entries `func_range(graph)` returns, while `func_more`
+        // accepts their value.
+        template<typename TFuncRange, typename TFuncMore>
+        TQueryFinal propLookup(TFuncRange func_range, TFuncMore func_more)
+        {
+            return this->addPipe(std::make_unique<GraphQueryPipePropLookup<TGraph, TFuncRange, TFuncMore>>(func_range, func_more));
+        }
+
         template<typename TFuncEdges, typename TFuncEdgeNodes>
         TQueryFinal e(TFuncEdges func_edges, TFuncEdgeNodes func_edgeNodes)
         {
@@ -148,6 +252,14 @@ namespace ugly
             return this->addPipe(std::make_unique<GraphQueryPipeBack<TGraph>>(this->engine()->requireMarker(marker)));
         }
 
+        // Makes the pipeline track the path of every gremlin, and marks the walked path for the
+        // graph's path store, see `runPaths()`. Edge steps extend a path, jumps (`back`, `merge`)
+        // return to the path at the mark.
+        TQueryFinal path(typename TGraph::PathData const& data = typename TGraph::PathData())
+        {
+            return this->addPipe(std::make_unique<GraphQueryPipePath<TGraph>>(data));
+        }
+
         template<typename TFuncSubQuery>
         TQueryFinal optional(TFuncSubQuery sub_query)
         {
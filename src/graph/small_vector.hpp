@@ -0,0 +1,184 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+
+#include "util.hpp"
+
+namespace ugly
+{
+    // A vector of trivially copyable values keeping the first `N` of them inline, only longer lists
+    // are moved to the heap. With `N == 0` nothing is allocated until the first value is added, at
+    // two thirds the size of a `std::vector`.
+    template<typename T, size_t N>
+    class SmallVector
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "SmallVector needs trivially copyable values.");
+        static_assert(N < std::numeric_limits<uint32_t>::max(), "SmallVector inline capacity is too large.");
+
+    protected:
+        uint32_t _size;
+        // above `N` the values are on the heap
+        uint32_t _capacity;
+        union
+        {
+            T _inline[N > 0 ? N : 1];
+            T* _heap;
+        };
+
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = T const*;
+
+        inline SmallVector()
+            : _size(0), _capacity(N)
+        { }
+
+        inline SmallVector(SmallVector const& that)
+            : _size(0), _capacity(N)
+        {
+            _assign(that);
+        }
+
+        inline SmallVector(SmallVector&& that)
+            : _size(0), _capacity(N)
+        {
+            _take(that);
+        }
+
+        inline ~SmallVector()
+        {
+            if (!inlined())
+                delete[] _heap;
+        }
+
+        inline SmallVector& operator=(SmallVector const& that)
+        {
+            if (this != &that)
+                _assign(that);
+            return *this;
+        }
+
+        inline SmallVector& operator=(SmallVector&& that)
+        {
+            if (this != &that)
+            {
+                _release();
+                _take(that);
+            }
+            return *this;
+        }
+
+        inline bool inlined() const { return _capacity <= N; }
+
+        inline size_t size() const { return _size; }
+        inline bool empty() const { return _size == 0; }
+        inline size_t capacity() const { return _capacity; }
+
+        inline T* data() { return inlined() ? _inline : _heap; }
+        inline T const* data() const { return inlined() ? _inline : _heap; }
+
+        inline T* begin() { return data(); }
+        inline T* end() { return data() + _size; }
+        inline T const* begin() const { return data(); }
+        inline T const* end() const { return data() + _size; }
+
+        inline T& operator[](size_t index) { return data()[index]; }
+        inline T const& operator[](size_t index) const { return data()[index]; }
+
+        inline T& back() { return data()[_size - 1]; }
+        inline T const& back() const { return data()[_size - 1]; }
+
+        inline void push_back(T const& value)
+        {
+            if (_size == _capacity)
+                _grow();
+            data()[_size++] = value;
+        }
+
+        inline T* insert(T const* pos, T const& value)
+        {
+            auto index = (size_t)(pos - data());
+            if (_size == _capacity)
+                _grow();
+
+            auto values = data();
+            std::memmove(values + index + 1, values + index, (_size - index) * sizeof(T));
+            values[index] = value;
+            ++_size;
+            return values + index;
+        }
+
+        inline T* erase(T const* pos)
+        {
+            auto index = (size_t)(pos - data());
+            auto values = data();
+            std::memmove(values + index, values + index + 1, (_size - index - 1) * sizeof(T));
+            --_size;
+            return values + index;
+        }
+
+        inline void pop_back() { --_size; }
+
+        // Keeps the capacity, like `std::vector`.
+        inline void clear() { _size = 0; }
+
+    protected:
+        inline void _grow()
+        {
+            uint32_t capacity = std::max<uint32_t>(_capacity * 2, std::max<uint32_t>((uint32_t)N + 1, 2));
+            T* heap = new T[capacity];
+            std::copy(data(), data() + _size, heap);
+
+            _release();
+            _heap = heap;
+            _capacity = capacity;
+        }
+
+        inline void _release()
+        {
+            if (!inlined())
+                delete[] _heap;
+            _capacity = N;
+        }
+
+        inline void _assign(SmallVector const& that)
+        {
+            _release();
+            if (that._size > N)
+            {
+                _heap = new T[that._size];
+                _capacity = that._size;
+            }
+            std::copy(that.begin(), that.end(), data());
+            _size = that._size;
+        }
+
+        inline void _take(SmallVector& that)
+        {
+            if (that.inlined())
+                std::copy(that.begin(), that.end(), _inline);
+            else
+                _heap = that._heap;
+            _size = that._size;
+            _capacity = that._capacity;
+
+            that._size = 0;
+            that._capacity = N;
+        }
+    };
+
+    template<typename T, size_t N>
+    inline PointerRange<T> pointerRange(SmallVector<void*, N> const& list)
+    {
+        return pointerRange<T>(list.data(), list.data() + list.size());
+    }
+}
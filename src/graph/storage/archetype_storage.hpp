@@ -0,0 +1,361 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+
+#include "graph/util.hpp"
+
+#include "simple_storage.hpp"
+
+/*
+ * This file contains the archetype storage, which groups nodes into tables by their signature, in
+ * the style of an ECS where props are the components:
+ * - A signature is the set of labels on a node and the number of props it has.
+ * - A table holds a row per node of its signature: the node slot, and a column per prop position
+ *   (the first prop of every row, the second, ...).
+ * - Nodes themselves stay in the primary store and keep their address, attaching a label or a prop
+ *   moves only their row to the table of the new signature. Rows are removed by moving the last
+ *   row of the table into their place.
+ * - Iterating all nodes sweeps the tables in turn, reading the node slots and prop columns linearly.
+ * - Edges on a node are listed on the node, as in SimpleStorage.
+ * - Props are attached once, when they are made, and nothing can be removed.
+ *
+ * Edges, paths, and labels are stored as in SimpleStorage. Adds need a single writer.
+ */
+
+namespace ugly {
+namespace storage
+{
+    class ArchetypeStorage
+        : public SimpleStorage
+    {
+    public:
+        // props live in table columns, not the lists the bulk hooks write
+        static constexpr bool bulkAdjacency = false;
+        // rows would move under the removal of their props
+        static constexpr bool removal = false;
+
+        struct PerNode
+        {
+            // the slot in the primary store, label memberships and keyed props are kept by it
+            uint32_t _index = 0;
+
+            // the row of the node in the table of its signature
+            uint32_t _table = 0;
+            uint32_t _row = 0;
+
+            // partitioned by role, the first `_outEdgeCount` edges are outgoing, the rest incoming
+            std::vector<void*> _edges;
+            size_t _outEdgeCount = 0;
+        };
+
+    protected:
+        struct _Signature
+        {
+            // sorted
+            std::vector<void*> _labels;
+            uint32_t _propCount;
+
+            inline bool operator<(_Signature const& that) const
+            {
+                return std::tie(_propCount, _labels) < std::tie(that._propCount, that._labels);
+            }
+        };
+
+        struct _Table
+        {
+            _Signature _signature;
+
+            // the node of each row
+            std::vector<void*> _nodes;
+            // `_props[i]` holds the i-th prop of every row
+            std::vector<std::vector<void*>> _props;
+        };
+
+    public:
+        // Walks the prop columns of a table along one row.
+        template<typename T>
+        class ColumnIterator
+        {
+            std::vector<void*> const* _columns;
+            uint32_t _row;
+            uint32_t _column;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T;
+
+            inline ColumnIterator()
+                : _columns(nullptr), _row(0), _column(0)
+            { }
+            inline ColumnIterator(std::vector<void*> const* columns, uint32_t row, uint32_t column)
+                : _columns(columns), _row(row), _column(column)
+            { }
+
+            inline reference operator*() const { return (T)_columns[_column][_row]; }
+
+            inline ColumnIterator& operator++()
+            {
+                ++_column;
+                return *this;
+            }
+            inline ColumnIterator operator++(int)
+            {
+                ColumnIterator res = *this;
+                ++_column;
+                return res;
+            }
+
+            inline bool operator==(ColumnIterator const& that) const { return _column == that._column; }
+            inline bool operator!=(ColumnIterator const& that) const { return _column != that._column; }
+        };
+
+        template<typename T>
+        using ColumnRange = IteratorRange<ColumnIterator<T>>;
+
+        // Sweeps the node slots of every table in turn.
+        template<typename T>
+        class TableIterator
+        {
+            std::vector<_Table> const* _tables;
+            size_t _table;
+            size_t _row;
+
+            inline void _skipEmpty()
+            {
+                while (_table < _tables->size() && _row == (*_tables)[_table]._nodes.size())
+                {
+                    ++_table;
+                    _row = 0;
+                }
+            }
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T const&;
+
+            inline TableIterator(std::vector<_Table> const* tables, size_t table)
+                : _tables(tables), _table(table), _row(0)
+            {
+                _skipEmpty();
+            }
+
+            inline reference operator*() const { return *(T const*)(*_tables)[_table]._nodes[_row]; }
+            inline pointer operator->() const { return (T const*)(*_tables)[_table]._nodes[_row]; }
+
+            inline TableIterator& operator++()
+            {
+                ++_row;
+                _skipEmpty();
+                return *this;
+            }
+            inline TableIterator operator++(int)
+            {
+                TableIterator res = *this;
+                ++*this;
+                return res;
+            }
+
+            inline bool operator==(TableIterator const& that) const { return _table == that._table && _row == that._row; }
+            inline bool operator!=(TableIterator const& that) const { return !(*this == that); }
+        };
+
+    private:
+        std::vector<_Table> _tables;
+        std::map<_Signature, uint32_t> _tableIds;
+
+    public:
+        inline ArchetypeStorage()
+        {
+            // new nodes start in the table of the empty signature
+            _requireTable(_Signature { { }, 0 });
+        }
+
+    // tables
+    public:
+        inline size_t tableCount() const
+        {
+            return _tables.size();
+        }
+
+        inline size_t tableOfNode(PerNode const& per) const
+        {
+            return per._table;
+        }
+
+    // make*
+    public:
+        template<typename Node, typename Data>
+        inline Node* makeNode(Data const& data)
+        {
+            auto nodes = _nodes.get<Node>();
+            auto index = (uint32_t)nodes->size();
+
+            Node& ref = _nodes.make<Node>(data, PerNode());
+            ref.store._index = index;
+
+            auto& table = _tables[0];
+            ref.store._row = (uint32_t)table._nodes.size();
+            table._nodes.push_back((void*)&ref);
+
+            return &ref;
+        }
+
+    // all*{Begin/End}
+    public:
+        template<typename Node>
+        inline TableIterator<Node> allNodesBegin() const
+        {
+            return TableIterator<Node>(&_tables, 0);
+        }
+        template<typename Node>
+        inline TableIterator<Node> allNodesEnd() const
+        {
+            return TableIterator<Node>(&_tables, _tables.size());
+        }
+
+    // relations getting
+    public:
+        template<typename Edge, typename Node>
+        inline PointerRange<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per) const
+        {
+            return pointerRange<Edge const*>(per._edges);
+        }
+
+        template<typename Edge, typename Node>
+        inline PointerRange<Edge const*> getNodeListOfOutEdges(Node const* ref, PerNode const& per) const
+        {
+            return pointerRange<Edge const*>(per._edges.data(), per._edges.data() + per._outEdgeCount);
+        }
+
+        template<typename Edge, typename Node>
+        inline PointerRange<Edge const*> getNodeListOfInEdges(Node const* ref, PerNode const& per) const
+        {
+            return pointerRange<Edge const*>(per._edges.data() + per._outEdgeCount, per._edges.data() + per._edges.size());
+        }
+
+        template<typename Prop, typename Node>
+        inline ColumnRange<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per) const
+        {
+            auto const& table = _tables[per._table];
+            auto columns = table._props.data();
+            return ColumnRange<Prop const*>(
+                ColumnIterator<Prop const*>(columns, per._row, 0),
+                ColumnIterator<Prop const*>(columns, per._row, table._signature._propCount));
+        }
+
+    // relations setting
+    public:
+        // Moves the node's row to the table with one more prop column, the prop goes in the last one.
+        template<typename Node, typename Prop>
+        inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _requireUnattached(prop_per_mut);
+
+            auto signature = _tables[node_per._table]._signature;
+            signature._propCount++;
+            _moveRow<Node>(const_cast<Node*>(node), _requireTable(signature), (void*)prop);
+
+            prop_per_mut._parent = (void*)node;
+            prop_per_mut._parentKind = GraphKind::Node;
+        }
+
+        // Moves the node's row to the table with the label added to its signature.
+        template<typename Node, typename Label>
+        inline void attachNodeLabel(Node const* ref, PerNode const& per, Label const* label_ref, PerLabel const& label_per)
+        {
+            SimpleStorage::attachNodeLabel(ref, per, label_ref, label_per);
+
+            auto signature = _tables[per._table]._signature;
+            auto& labels = signature._labels;
+            auto it = std::lower_bound(labels.begin(), labels.end(), (void*)label_ref);
+            if (it != labels.end() && *it == (void*)label_ref)
+                return;
+
+            labels.insert(it, (void*)label_ref);
+            _moveRow<Node>(const_cast<Node*>(ref), _requireTable(signature), nullptr);
+        }
+
+    // memory accounting
+    public:
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void memoryStats(MemoryStats& stats) const
+        {
+            _storeMemoryStats<Node, Edge, Path, Label, Prop>(stats);
+            for (auto& node : *_nodes.get<Node>())
+                stats.addList(node.store._edges);
+            for (auto& table : _tables)
+            {
+                stats.addList(table._signature._labels);
+                stats.addList(table._nodes);
+                for (auto& column : table._props)
+                    stats.addList(column);
+            }
+            _edgeListMemoryStats<Edge>(stats);
+        }
+
+    // helpers
+    private:
+        inline uint32_t _requireTable(_Signature const& signature)
+        {
+            auto it = _tableIds.find(signature);
+            if (it != _tableIds.end())
+                return it->second;
+
+            auto id = (uint32_t)_tables.size();
+            _tables.push_back(_Table { signature, { }, std::vector<std::vector<void*>>(signature._propCount) });
+            _tableIds.emplace(signature, id);
+            return id;
+        }
+
+        // Appends the node's row to the table, with `prop` in the column past the ones it had (if
+        // any), and fills the gap in the old table with its last row.
+        template<typename Node>
+        inline void _moveRow(Node* node, uint32_t to_id, void* prop)
+        {
+            auto& per = node->store;
+            auto& from = _tables[per._table];
+            auto& to = _tables[to_id];
+
+            auto row = per._row;
+            auto to_row = (uint32_t)to._nodes.size();
+            to._nodes.push_back((void*)node);
+            for (size_t i = 0; i < from._props.size(); ++i)
+                to._props[i].push_back(from._props[i][row]);
+            if (prop != nullptr)
+                to._props[from._props.size()].push_back(prop);
+
+            auto last = (uint32_t)from._nodes.size() - 1;
+            if (row != last)
+            {
+                from._nodes[row] = from._nodes[last];
+                for (auto& column : from._props)
+                    column[row] = column[last];
+                ((Node*)from._nodes[row])->store._row = row;
+            }
+            from._nodes.pop_back();
+            for (auto& column : from._props)
+                column.pop_back();
+
+            per._table = to_id;
+            per._row = to_row;
+        }
+    };
+}}
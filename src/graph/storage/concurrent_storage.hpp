@@ -0,0 +1,228 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <array>
+#include <mutex>
+#include <algorithm>
+
+#include "graph/util.hpp"
+
+#include "simple_storage.hpp"
+
+/*
+ * This file contains the concurrent storage, SimpleStorage made safe for concurrent adds:
+ * - Each primary store has a lock around allocation, the deques never move existing elements.
+ * - Relationship lists are guarded by striped locks keyed by the owning element's address. An
+ *   operation takes the stripes of every element it touches in ascending order.
+ *
+ * Reads are not guarded: an add may reallocate the relationship lists of the elements it touches,
+ * so reading those lists (e.g. the props of an edge) while other threads add to them needs
+ * exclusive access. Removal and compaction are not guarded either and need exclusive access too.
+ */
+
+namespace ugly {
+namespace storage
+{
+    class ConcurrentStorage
+        : public SimpleStorage
+    {
+    public:
+        static constexpr bool concurrent = true;
+        // the bulk hooks do not take the stripe locks
+        static constexpr bool bulkAdjacency = false;
+
+        static constexpr size_t stripeCount = 64;
+
+    protected:
+        // Holds a sorted set of stripes for the duration of an operation.
+        class _StripeLock
+        {
+            ConcurrentStorage* _storage;
+            std::vector<size_t> _stripes;
+
+        public:
+            inline _StripeLock(ConcurrentStorage* storage, std::vector<size_t> && stripes)
+                : _storage(storage), _stripes(std::move(stripes))
+            {
+                std::sort(_stripes.begin(), _stripes.end());
+                _stripes.erase(std::unique(_stripes.begin(), _stripes.end()), _stripes.end());
+
+                for (auto stripe : _stripes)
+                    _storage->_stripes[stripe].lock();
+            }
+
+            inline _StripeLock(_StripeLock const&) = delete;
+
+            inline ~_StripeLock()
+            {
+                for (auto it = _stripes.rbegin(); it != _stripes.rend(); ++it)
+                    _storage->_stripes[*it].unlock();
+            }
+        };
+
+    private:
+        mutable std::mutex _nodesLock;
+        mutable std::mutex _edgesLock;
+        mutable std::mutex _pathsLock;
+        mutable std::mutex _labelsLock;
+        mutable std::mutex _propsLock;
+
+        std::array<std::mutex, stripeCount> _stripes;
+
+    // countPrimary*Store
+    public:
+        template<typename Node>
+        inline size_t countPrimaryNodeStore() const
+        {
+            std::lock_guard<std::mutex> lock(_nodesLock);
+            return SimpleStorage::countPrimaryNodeStore<Node>();
+        }
+        template<typename Edge>
+        inline size_t countPrimaryEdgeStore() const
+        {
+            std::lock_guard<std::mutex> lock(_edgesLock);
+            return SimpleStorage::countPrimaryEdgeStore<Edge>();
+        }
+        template<typename Path>
+        inline size_t countPrimaryPathStore() const
+        {
+            std::lock_guard<std::mutex> lock(_pathsLock);
+            return SimpleStorage::countPrimaryPathStore<Path>();
+        }
+        template<typename Label>
+        inline size_t countPrimaryLabelStore() const
+        {
+            std::lock_guard<std::mutex> lock(_labelsLock);
+            return SimpleStorage::countPrimaryLabelStore<Label>();
+        }
+        template<typename Prop>
+        inline size_t countPrimaryPropStore() const
+        {
+            std::lock_guard<std::mutex> lock(_propsLock);
+            return SimpleStorage::countPrimaryPropStore<Prop>();
+        }
+
+    // make*
+    public:
+        template<typename Node, typename Data>
+        inline Node* makeNode(Data const& data)
+        {
+            std::lock_guard<std::mutex> lock(_nodesLock);
+            return SimpleStorage::makeNode<Node>(data);
+        }
+        template<typename Edge, typename Data>
+        inline Edge* makeEdge(Data const& data)
+        {
+            std::lock_guard<std::mutex> lock(_edgesLock);
+            return SimpleStorage::makeEdge<Edge>(data);
+        }
+        template<typename Path, typename Data>
+        inline Path* makePath(Data const& data)
+        {
+            std::lock_guard<std::mutex> lock(_pathsLock);
+            return SimpleStorage::makePath<Path>(data);
+        }
+        template<typename Label, typename Data>
+        inline Label* makeLabel(Data const& data)
+        {
+            std::lock_guard<std::mutex> lock(_labelsLock);
+            return SimpleStorage::makeLabel<Label>(data);
+        }
+        template<typename Prop, typename Data>
+        inline Prop* makeProp(Data const& data)
+        {
+            std::lock_guard<std::mutex> lock(_propsLock);
+            return SimpleStorage::makeProp<Prop>(data);
+        }
+
+    // relations setting
+    public:
+        template<typename Edge, typename NodeIt, typename NodeGetter>
+        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted, NodeIt begin, NodeIt end, NodeGetter getter)
+        {
+            // the edge leaves its current nodes, which have to be locked too
+            while (true)
+            {
+                auto old_nodes = _nodesOf(edge, edge_per);
+
+                std::vector<size_t> stripes { _stripeOf(edge) };
+                for (auto it = begin; it != end; ++it)
+                    stripes.push_back(_stripeOf(*it));
+                for (auto node : old_nodes)
+                    stripes.push_back(_stripeOf(node));
+
+                _StripeLock lock(this, std::move(stripes));
+                if (!std::equal(old_nodes.begin(), old_nodes.end(), edge_per._nodes.begin(), edge_per._nodes.end()))
+                    continue;
+
+                SimpleStorage::setEdgeListOfNodes(edge, edge_per, inverted, begin, end, getter);
+                return;
+            }
+        }
+
+        template<typename Edge, typename Node>
+        inline void attachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, size_t index, Node const* node, PerNode const& node_per)
+        {
+            // inserting first changes the role of the current first node, which has to be locked too
+            while (true)
+            {
+                void* first = _firstNode(edge, edge_per);
+                _StripeLock lock(this, { _stripeOf(edge), _stripeOf(node), _stripeOf(first) });
+                if (first != (edge_per._nodes.empty() ? nullptr : edge_per._nodes[0]))
+                    continue;
+
+                SimpleStorage::attachEdgeNode(edge, edge_per, inverted, index, node, node_per);
+                return;
+            }
+        }
+
+        template<typename Node, typename Prop>
+        inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
+        {
+            _StripeLock lock(this, { _stripeOf(node), _stripeOf(prop) });
+            SimpleStorage::attachNodeProp(node, node_per, prop, prop_per);
+        }
+
+        template<typename Edge, typename Prop>
+        inline void attachEdgeProp(Edge const* edge, PerEdge const& edge_per, Prop const* prop, PerProp const& prop_per)
+        {
+            _StripeLock lock(this, { _stripeOf(edge), _stripeOf(prop) });
+            SimpleStorage::attachEdgeProp(edge, edge_per, prop, prop_per);
+        }
+
+        template<typename Node, typename TPerNode, typename Label>
+        inline void attachNodeLabel(Node const* node, TPerNode const& node_per, Label const* label, PerLabel const& label_per)
+        {
+            _StripeLock lock(this, { _stripeOf(label) });
+            SimpleStorage::attachNodeLabel(node, node_per, label, label_per);
+        }
+
+    // helpers
+    private:
+        static inline size_t _stripeOf(void const* ref)
+        {
+            // elements are at least 16 byte aligned, drop the low bits before picking a stripe
+            return (((uintptr_t)ref) >> 4) % stripeCount;
+        }
+
+        template<typename Edge>
+        inline std::vector<void*> _nodesOf(Edge const* edge, PerEdge const& edge_per)
+        {
+            std::lock_guard<std::mutex> lock(_stripes[_stripeOf(edge)]);
+            return std::vector<void*>(edge_per._nodes.begin(), edge_per._nodes.end());
+        }
+
+        template<typename Edge>
+        inline void* _firstNode(Edge const* edge, PerEdge const& edge_per)
+        {
+            std::lock_guard<std::mutex> lock(_stripes[_stripeOf(edge)]);
+            return edge_per._nodes.empty() ? nullptr : edge_per._nodes[0];
+        }
+    };
+}}
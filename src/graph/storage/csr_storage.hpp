@@ -0,0 +1,595 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <limits>
+#include <type_traits>
+
+#include "graph/util.hpp"
+
+#include "simple_storage.hpp"
+
+/*
+ * This file contains the compressed sparse row storage, which has two phases:
+ * - Loading: nodes, edges, and props can be added. Relationships that arrive out of order
+ *   (edges and props on nodes, props on edges) are staged as chains in a shared link array.
+ *   The nodes of an edge always arrive together and are appended as a contiguous run.
+ *   Edges on a node are staged in two chains, one per role (outgoing and incoming). The heads
+ *   and tails of the chains live in staging tables indexed by element.
+ * - Frozen: `freeze()` compacts every relationship into flat neighbor arrays, delimited by
+ *   shared offset arrays (one entry per element plus a final end), and releases the staging
+ *   chains and tables. The storage is then read only. The outgoing edges of a node are laid out
+ *   directly before its incoming ones, a second offset array marks where the incoming ones start.
+ * - Elements only carry their 32-bit index. Chains, neighbor arrays, and offsets hold 32-bit
+ *   values, indices into the primary stores are resolved by the ranges the storage returns.
+ *
+ * Paths and labels are stored as in SimpleStorage.
+ */
+
+namespace ugly {
+namespace storage
+{
+    class CsrStorage
+        : public SimpleStorage
+    {
+    public:
+        static constexpr bool labelMembership = false;
+        static constexpr bool nodeIndices = false;
+        static constexpr bool bulkAdjacency = false;
+        static constexpr bool removal = false;
+
+        using Index = uint32_t;
+        using Offset = uint32_t;
+        static constexpr Offset npos = std::numeric_limits<Offset>::max();
+
+        // The position of the element in its primary store, which also selects its entries in
+        // the staging tables and offset arrays.
+        struct PerNode
+        {
+            Index _index;
+        };
+
+        struct PerEdge
+        {
+            Index _index;
+        };
+
+        struct PerProp
+        {
+            Index _index;
+
+            void* _parent;
+            GraphKind _parentKind;
+        };
+
+    protected:
+        struct _Link
+        {
+            Index _ref;
+            Offset _next;
+        };
+
+        // Heads and tails of the staging chains of a node.
+        struct _NodeChains
+        {
+            Offset _outEdges;
+            Offset _outEdgesEnd;
+            Offset _inEdges;
+            Offset _inEdgesEnd;
+            Offset _props;
+            Offset _propsEnd;
+        };
+
+        // `_nodes` is a run in the edge node array, `_props` is a staging chain.
+        struct _EdgeChains
+        {
+            Offset _nodes;
+            Offset _nodesEnd;
+            Offset _props;
+            Offset _propsEnd;
+        };
+
+    public:
+        // Walks a staging chain (optionally continuing into a second one) while loading, or a range
+        // of a neighbor array once frozen.
+        template<typename T>
+        class RelationIterator
+        {
+            using Element = std::remove_const_t<std::remove_pointer_t<T>>;
+
+            Store<Element> const* _store;
+            Index const* _array;
+            _Link const* _links;
+            Offset _index;
+            Offset _then;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T;
+
+            inline RelationIterator()
+                : _store(nullptr), _array(nullptr), _links(nullptr), _index(npos), _then(npos)
+            { }
+            inline RelationIterator(Store<Element> const* store, Index const* array, Offset index)
+                : _store(store), _array(array), _links(nullptr), _index(index), _then(npos)
+            { }
+            inline RelationIterator(Store<Element> const* store, _Link const* links, Offset index, Offset then = npos)
+                : _store(store), _array(nullptr), _links(links), _index(index), _then(then)
+            {
+                _continue();
+            }
+
+            inline reference operator*() const
+            {
+                return &(*_store)[_links != nullptr ? _links[_index]._ref : _array[_index]];
+            }
+
+            inline RelationIterator& operator++()
+            {
+                if (_links != nullptr)
+                {
+                    _index = _links[_index]._next;
+                    _continue();
+                }
+                else
+                    ++_index;
+                return *this;
+            }
+            inline RelationIterator operator++(int)
+            {
+                RelationIterator res = *this;
+                ++*this;
+                return res;
+            }
+
+            inline bool operator==(RelationIterator const& that) const { return _index == that._index; }
+            inline bool operator!=(RelationIterator const& that) const { return _index != that._index; }
+
+        private:
+            inline void _continue()
+            {
+                if (_index == npos)
+                {
+                    _index = _then;
+                    _then = npos;
+                }
+            }
+        };
+
+        template<typename T>
+        using RelationRange = IteratorRange<RelationIterator<T>>;
+
+    private:
+        bool _frozen;
+
+        // loading
+        std::vector<_Link> _links;
+        std::vector<_NodeChains> _nodeChains;
+        std::vector<_EdgeChains> _edgeChains;
+        size_t _stagedNodeEdges;
+        size_t _stagedNodeProps;
+        size_t _stagedEdgeProps;
+
+        // frozen
+        std::vector<Offset> _nodeEdgeOffsets;
+        std::vector<Offset> _nodeInEdgeOffsets;
+        std::vector<Offset> _nodePropOffsets;
+        std::vector<Offset> _edgeNodeOffsets;
+        std::vector<Offset> _edgePropOffsets;
+
+        std::vector<Index> _nodeEdgeRefs;
+        std::vector<Index> _nodePropRefs;
+        std::vector<Index> _edgeNodeRefs;
+        std::vector<Index> _edgePropRefs;
+
+    public:
+        inline CsrStorage()
+            : _frozen(false)
+            , _stagedNodeEdges(0)
+            , _stagedNodeProps(0)
+            , _stagedEdgeProps(0)
+        { }
+
+    // freezing
+    public:
+        inline bool isFrozen() const
+        {
+            return _frozen;
+        }
+
+        template<typename Node, typename Edge>
+        inline void freeze()
+        {
+            if (_frozen)
+                return;
+
+            auto node_count = _nodeChains.size();
+            auto edge_count = _edgeChains.size();
+
+            _nodeEdgeOffsets.reserve(node_count + 1);
+            _nodeInEdgeOffsets.reserve(node_count);
+            _nodePropOffsets.reserve(node_count + 1);
+            _nodeEdgeRefs.reserve(_stagedNodeEdges);
+            _nodePropRefs.reserve(_stagedNodeProps);
+            for (auto const& chains : _nodeChains)
+            {
+                _nodeEdgeOffsets.push_back((Offset)_nodeEdgeRefs.size());
+                _compactChain(_nodeEdgeRefs, chains._outEdges);
+                _nodeInEdgeOffsets.push_back((Offset)_nodeEdgeRefs.size());
+                _compactChain(_nodeEdgeRefs, chains._inEdges);
+
+                _nodePropOffsets.push_back((Offset)_nodePropRefs.size());
+                _compactChain(_nodePropRefs, chains._props);
+            }
+            _nodeEdgeOffsets.push_back((Offset)_nodeEdgeRefs.size());
+            _nodePropOffsets.push_back((Offset)_nodePropRefs.size());
+
+            // runs left behind by re-setting the nodes of an edge are dropped here
+            size_t edge_node_count = 0;
+            for (auto const& chains : _edgeChains)
+                edge_node_count += chains._nodesEnd - chains._nodes;
+
+            std::vector<Index> edge_nodes;
+            edge_nodes.reserve(edge_node_count);
+            _edgeNodeOffsets.reserve(edge_count + 1);
+            _edgePropOffsets.reserve(edge_count + 1);
+            _edgePropRefs.reserve(_stagedEdgeProps);
+            for (auto const& chains : _edgeChains)
+            {
+                _edgeNodeOffsets.push_back((Offset)edge_nodes.size());
+                edge_nodes.insert(edge_nodes.end(), _edgeNodeRefs.begin() + chains._nodes, _edgeNodeRefs.begin() + chains._nodesEnd);
+
+                _edgePropOffsets.push_back((Offset)_edgePropRefs.size());
+                _compactChain(_edgePropRefs, chains._props);
+            }
+            _edgeNodeOffsets.push_back((Offset)edge_nodes.size());
+            _edgePropOffsets.push_back((Offset)_edgePropRefs.size());
+            _edgeNodeRefs = std::move(edge_nodes);
+
+            _release(_links);
+            _release(_nodeChains);
+            _release(_edgeChains);
+            _stagedNodeEdges = _stagedNodeProps = _stagedEdgeProps = 0;
+
+            _frozen = true;
+        }
+
+    // make*
+    public:
+        template<typename Node, typename Data>
+        inline Node* makeNode(Data const& data)
+        {
+            _requireNotFrozen();
+
+            auto& nodes = *_nodes.get<Node>();
+            Node& ref = nodes.emplace_back(data, PerNode { _nextIndex(nodes) });
+            _nodeChains.push_back({ npos, npos, npos, npos, npos, npos });
+
+            return &ref;
+        }
+        template<typename Edge, typename Data>
+        inline Edge* makeEdge(Data const& data)
+        {
+            _requireNotFrozen();
+
+            auto& edges = *_edges.get<Edge>();
+            Edge& ref = edges.emplace_back(data, PerEdge { _nextIndex(edges) });
+            _edgeChains.push_back({ 0, 0, npos, npos });
+
+            return &ref;
+        }
+        template<typename Prop, typename Data>
+        inline Prop* makeProp(Data const& data)
+        {
+            _requireNotFrozen();
+
+            auto& props = *_props.get<Prop>();
+            Prop& ref = props.emplace_back(data, PerProp { _nextIndex(props), nullptr, GraphKind::Unknown });
+
+            return &ref;
+        }
+
+    // relations getting
+    public:
+        template<typename Node, typename Edge>
+        inline RelationRange<Node const*> getEdgeListOfNodes(Edge const* ref, PerEdge const& per) const
+        {
+            auto nodes = _nodes.get<Node>();
+            auto begin = _frozen ? _edgeNodeOffsets[per._index] : _edgeChains[per._index]._nodes;
+            auto end = _frozen ? _edgeNodeOffsets[per._index + 1] : _edgeChains[per._index]._nodesEnd;
+            return RelationRange<Node const*>(
+                RelationIterator<Node const*>(nodes, _edgeNodeRefs.data(), begin),
+                RelationIterator<Node const*>(nodes, _edgeNodeRefs.data(), end));
+        }
+
+        template<typename Edge, typename Node>
+        inline RelationRange<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per) const
+        {
+            auto edges = _edges.get<Edge>();
+            if (_frozen)
+                return _arrayRange<Edge const*>(edges, _nodeEdgeRefs, _nodeEdgeOffsets[per._index], _nodeEdgeOffsets[per._index + 1]);
+
+            auto const& chains = _nodeChains[per._index];
+            return RelationRange<Edge const*>(
+                RelationIterator<Edge const*>(edges, _links.data(), chains._outEdges, chains._inEdges),
+                RelationIterator<Edge const*>(edges, _links.data(), npos));
+        }
+
+        template<typename Edge, typename Node>
+        inline RelationRange<Edge const*> getNodeListOfOutEdges(Node const* ref, PerNode const& per) const
+        {
+            auto edges = _edges.get<Edge>();
+            if (_frozen)
+                return _arrayRange<Edge const*>(edges, _nodeEdgeRefs, _nodeEdgeOffsets[per._index], _nodeInEdgeOffsets[per._index]);
+            else
+                return _chainRange<Edge const*>(edges, _nodeChains[per._index]._outEdges);
+        }
+
+        template<typename Edge, typename Node>
+        inline RelationRange<Edge const*> getNodeListOfInEdges(Node const* ref, PerNode const& per) const
+        {
+            auto edges = _edges.get<Edge>();
+            if (_frozen)
+                return _arrayRange<Edge const*>(edges, _nodeEdgeRefs, _nodeInEdgeOffsets[per._index], _nodeEdgeOffsets[per._index + 1]);
+            else
+                return _chainRange<Edge const*>(edges, _nodeChains[per._index]._inEdges);
+        }
+
+        template<typename Prop, typename Node>
+        inline RelationRange<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per) const
+        {
+            auto props = _props.get<Prop>();
+            if (_frozen)
+                return _arrayRange<Prop const*>(props, _nodePropRefs, _nodePropOffsets[per._index], _nodePropOffsets[per._index + 1]);
+            else
+                return _chainRange<Prop const*>(props, _nodeChains[per._index]._props);
+        }
+
+        template<typename Prop, typename Edge>
+        inline RelationRange<Prop const*> getEdgeListOfProps(Edge const* ref, PerEdge const& per) const
+        {
+            auto props = _props.get<Prop>();
+            if (_frozen)
+                return _arrayRange<Prop const*>(props, _edgePropRefs, _edgePropOffsets[per._index], _edgePropOffsets[per._index + 1]);
+            else
+                return _chainRange<Prop const*>(props, _edgeChains[per._index]._props);
+        }
+
+    // relations setting
+    public:
+        template<typename Edge, typename NodeIt, typename NodeGetter>
+        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted, NodeIt begin, NodeIt end, NodeGetter getter)
+        {
+            _requireNotFrozen();
+
+            auto& chains = _edgeChains[edge_per._index];
+            // the previous run (if any) is left behind and dropped by `freeze()`, its nodes stop listing the edge
+            for (auto i = chains._nodes; i < chains._nodesEnd; ++i)
+                _unlinkEdge(_nodeChains[_edgeNodeRefs[i]], edge_per._index, isOutgoingSlot(i == chains._nodes, inverted));
+
+            chains._nodes = _nextOffset(_edgeNodeRefs.size());
+            for (auto it = begin; it != end; ++it)
+            {
+                auto node_index = getter(*it)->_index;
+
+                _linkEdge(_nodeChains[node_index], edge_per._index, isOutgoingSlot(it == begin, inverted));
+                _edgeNodeRefs.push_back(node_index);
+            }
+            chains._nodesEnd = _nextOffset(_edgeNodeRefs.size());
+        }
+
+        template<typename Edge, typename Node>
+        inline void attachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, size_t index, Node const* node, PerNode const& node_per)
+        {
+            _requireNotFrozen();
+
+            auto& chains = _edgeChains[edge_per._index];
+
+            // the old first node loses its role
+            if (index == 0 && chains._nodes != chains._nodesEnd)
+            {
+                auto& first_chains = _nodeChains[_edgeNodeRefs[chains._nodes]];
+                _unlinkEdge(first_chains, edge_per._index, isOutgoingSlot(true, inverted));
+                _linkEdge(first_chains, edge_per._index, isOutgoingSlot(false, inverted));
+            }
+
+            // runs are contiguous, so the edge moves to a new run with the node spliced in
+            auto begin = _nextOffset(_edgeNodeRefs.size());
+            for (auto i = chains._nodes; i < chains._nodesEnd; ++i)
+            {
+                Index existing = _edgeNodeRefs[i];
+                if (i - chains._nodes == index)
+                    _edgeNodeRefs.push_back(node_per._index);
+                _edgeNodeRefs.push_back(existing);
+            }
+            if (chains._nodes + index == chains._nodesEnd)
+                _edgeNodeRefs.push_back(node_per._index);
+            chains._nodes = begin;
+            chains._nodesEnd = _nextOffset(_edgeNodeRefs.size());
+
+            _linkEdge(_nodeChains[node_per._index], edge_per._index, isOutgoingSlot(index == 0, inverted));
+        }
+
+        template<typename Node, typename Prop>
+        inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
+        {
+            _requireNotFrozen();
+
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _requireUnattached(prop_per_mut);
+
+            auto& chains = _nodeChains[node_per._index];
+            _link(chains._props, chains._propsEnd, prop_per_mut._index);
+            _stagedNodeProps++;
+            prop_per_mut._parent = (void*)node;
+            prop_per_mut._parentKind = GraphKind::Node;
+        }
+
+        template<typename Edge, typename Prop>
+        inline void attachEdgeProp(Edge const* edge, PerEdge const& edge_per, Prop const* prop, PerProp const& prop_per)
+        {
+            _requireNotFrozen();
+
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _requireUnattached(prop_per_mut);
+
+            auto& chains = _edgeChains[edge_per._index];
+            _link(chains._props, chains._propsEnd, prop_per_mut._index);
+            _stagedEdgeProps++;
+            prop_per_mut._parent = (void*)edge;
+            prop_per_mut._parentKind = GraphKind::Edge;
+        }
+
+        template<typename Node, typename Label>
+        inline void attachNodeLabel(Node const* ref, PerNode const& per, Label const* label_ref, PerLabel const& label_per)
+        {
+            _requireNotFrozen();
+        }
+
+    // memory accounting
+    public:
+        // While loading the staging chains and tables hold the relationships, once frozen the
+        // neighbor and offset arrays do.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void memoryStats(MemoryStats& stats) const
+        {
+            _storeMemoryStats<Node, Edge, Path, Label, Prop>(stats);
+
+            stats.addList(_links);
+            stats.addList(_nodeChains);
+            stats.addList(_edgeChains);
+
+            stats.addList(_nodeEdgeOffsets);
+            stats.addList(_nodeInEdgeOffsets);
+            stats.addList(_nodePropOffsets);
+            stats.addList(_edgeNodeOffsets);
+            stats.addList(_edgePropOffsets);
+
+            stats.addList(_nodeEdgeRefs);
+            stats.addList(_nodePropRefs);
+            stats.addList(_edgeNodeRefs);
+            stats.addList(_edgePropRefs);
+        }
+
+    // helpers
+    private:
+        inline void _requireNotFrozen() const
+        {
+            if (_frozen)
+                throw graph_error("CsrStorage is frozen.");
+        }
+
+        // Props are attached once, when they are made, the staging chains cannot give them up.
+        static inline void _requireUnattached(PerProp const& per)
+        {
+            if (per._parent != nullptr)
+                throw graph_error("CsrStorage cannot move a prop to another parent.");
+        }
+
+        template<typename T>
+        inline Index _nextIndex(Store<T> const& store) const
+        {
+            if (store.size() >= std::numeric_limits<Index>::max())
+                throw graph_error("CsrStorage is out of indices.");
+
+            return (Index)store.size();
+        }
+
+        // `npos` is reserved, so the staging arrays hold less than that many entries.
+        static inline Offset _nextOffset(size_t size)
+        {
+            if (size >= npos)
+                throw graph_error("CsrStorage is out of offsets.");
+
+            return (Offset)size;
+        }
+
+        template<typename T>
+        static inline void _release(std::vector<T>& list)
+        {
+            list.clear();
+            list.shrink_to_fit();
+        }
+
+        inline void _link(Offset& head, Offset& tail, Index ref)
+        {
+            auto index = _nextOffset(_links.size());
+            _links.push_back({ ref, npos });
+
+            if (head == npos)
+                head = index;
+            else
+                _links[tail]._next = index;
+            tail = index;
+        }
+
+        inline void _linkEdge(_NodeChains& chains, Index edge, bool outgoing)
+        {
+            if (outgoing)
+                _link(chains._outEdges, chains._outEdgesEnd, edge);
+            else
+                _link(chains._inEdges, chains._inEdgesEnd, edge);
+            _stagedNodeEdges++;
+        }
+
+        inline void _unlinkEdge(_NodeChains& chains, Index edge, bool outgoing)
+        {
+            if (outgoing)
+                _unlink(chains._outEdges, chains._outEdgesEnd, edge);
+            else
+                _unlink(chains._inEdges, chains._inEdgesEnd, edge);
+            _stagedNodeEdges--;
+        }
+
+        // Removes the first link to `ref` from a chain, the link itself is dropped by `freeze()`.
+        inline void _unlink(Offset& head, Offset& tail, Index ref)
+        {
+            Offset prev = npos;
+            for (auto i = head; i != npos; prev = i, i = _links[i]._next)
+            {
+                if (_links[i]._ref != ref)
+                    continue;
+
+                if (prev == npos)
+                    head = _links[i]._next;
+                else
+                    _links[prev]._next = _links[i]._next;
+                if (tail == i)
+                    tail = prev;
+                return;
+            }
+        }
+
+        inline void _compactChain(std::vector<Index>& into, Offset head) const
+        {
+            for (auto i = head; i != npos; i = _links[i]._next)
+                into.push_back(_links[i]._ref);
+        }
+
+        template<typename T, typename TStore>
+        static inline RelationRange<T> _arrayRange(TStore const* store, std::vector<Index> const& array, Offset begin, Offset end)
+        {
+            return RelationRange<T>(
+                RelationIterator<T>(store, array.data(), begin),
+                RelationIterator<T>(store, array.data(), end));
+        }
+
+        template<typename T, typename TStore>
+        inline RelationRange<T> _chainRange(TStore const* store, Offset head) const
+        {
+            return RelationRange<T>(
+                RelationIterator<T>(store, _links.data(), head),
+                RelationIterator<T>(store, _links.data(), npos));
+        }
+    };
+}}
@@ -0,0 +1,295 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <limits>
+#include <type_traits>
+
+#include "graph/util.hpp"
+#include "graph/small_vector.hpp"
+
+#include "simple_storage.hpp"
+
+/*
+ * This file contains the handle storage, which addresses elements by dense indices:
+ * - Every node, edge, and prop knows its handle, the 32-bit index into its primary store.
+ * - Relationships are lists of handles instead of pointers, halving adjacency memory.
+ * - Handles are resolved back into pointers by the ranges the storage returns.
+ * - Props are attached once, when they are made.
+ *
+ * Paths and labels are stored as in SimpleStorage. Adds need a single writer, see ConcurrentStorage
+ * for concurrent adds.
+ */
+
+namespace ugly {
+namespace storage
+{
+    class HandleStorage
+        : public SimpleStorage
+    {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle npos = std::numeric_limits<Handle>::max();
+
+        static constexpr bool denseHandles = true;
+        // relationships are handles, not the pointers the bulk hooks write
+        static constexpr bool bulkAdjacency = false;
+        // removal would leave holes in the handle space
+        static constexpr bool removal = false;
+
+        struct PerNode
+        {
+            Handle _index;
+
+            std::vector<Handle> _props;
+
+            // partitioned by role, the first `_outEdgeCount` edges are outgoing, the rest incoming
+            std::vector<Handle> _edges;
+            Handle _outEdgeCount;
+        };
+
+        // Two handles fit in the space of the heap pointer, so binary edges and edges with up to two
+        // props allocate nothing.
+        struct PerEdge
+        {
+            Handle _index;
+
+            SmallVector<Handle, 2> _props;
+
+            SmallVector<Handle, 2> _nodes;
+        };
+
+        struct PerProp
+        {
+            Handle _index;
+
+            Handle _parent;
+            GraphKind _parentKind;
+        };
+
+    public:
+        // Resolves a range of handles into element pointers.
+        template<typename T>
+        class HandleIterator
+        {
+            using Element = std::remove_const_t<std::remove_pointer_t<T>>;
+
+            Store<Element> const* _store;
+            Handle const* _it;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T;
+
+            inline HandleIterator()
+                : _store(nullptr), _it(nullptr)
+            { }
+            inline HandleIterator(Store<Element> const* store, Handle const* it)
+                : _store(store), _it(it)
+            { }
+
+            inline reference operator*() const { return &(*_store)[*_it]; }
+
+            inline HandleIterator& operator++()
+            {
+                ++_it;
+                return *this;
+            }
+            inline HandleIterator operator++(int)
+            {
+                HandleIterator res = *this;
+                ++_it;
+                return res;
+            }
+
+            inline bool operator==(HandleIterator const& that) const { return _it == that._it; }
+            inline bool operator!=(HandleIterator const& that) const { return _it != that._it; }
+        };
+
+        template<typename T>
+        using HandleRange = IteratorRange<HandleIterator<T>>;
+
+    // make*
+    public:
+        template<typename Node, typename Data>
+        inline Node* makeNode(Data const& data)
+        {
+            auto& nodes = *_nodes.get<Node>();
+            Node& ref = nodes.emplace_back(data, PerNode { _nextHandle(nodes), {}, {}, 0 });
+
+            return &ref;
+        }
+        template<typename Edge, typename Data>
+        inline Edge* makeEdge(Data const& data)
+        {
+            auto& edges = *_edges.get<Edge>();
+            Edge& ref = edges.emplace_back(data, PerEdge { _nextHandle(edges), {}, {} });
+
+            return &ref;
+        }
+        template<typename Prop, typename Data>
+        inline Prop* makeProp(Data const& data)
+        {
+            auto& props = *_props.get<Prop>();
+            Prop& ref = props.emplace_back(data, PerProp { _nextHandle(props), npos, GraphKind::Unknown });
+
+            return &ref;
+        }
+
+    // handles
+    public:
+        inline size_t handleOfNode(PerNode const& per) const
+        {
+            return per._index;
+        }
+
+        template<typename Node>
+        inline Node const* resolveNode(size_t handle) const
+        {
+            return &(*_nodes.get<Node>())[handle];
+        }
+
+        // The node a prop is on, `nullptr` for props on edges.
+        template<typename Node>
+        inline Node const* nodeOfProp(PerProp const& per) const
+        {
+            return per._parentKind == GraphKind::Node ? resolveNode<Node>(per._parent) : nullptr;
+        }
+
+    // relations getting
+    public:
+        template<typename Node, typename Edge>
+        inline HandleRange<Node const*> getEdgeListOfNodes(Edge const* ref, PerEdge const& per) const
+        {
+            return _handleRange<Node const*>(_nodes.get<Node>(), per._nodes.data(), per._nodes.data() + per._nodes.size());
+        }
+
+        template<typename Edge, typename Node>
+        inline HandleRange<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per) const
+        {
+            return _handleRange<Edge const*>(_edges.get<Edge>(), per._edges.data(), per._edges.data() + per._edges.size());
+        }
+
+        template<typename Edge, typename Node>
+        inline HandleRange<Edge const*> getNodeListOfOutEdges(Node const* ref, PerNode const& per) const
+        {
+            return _handleRange<Edge const*>(_edges.get<Edge>(), per._edges.data(), per._edges.data() + per._outEdgeCount);
+        }
+
+        template<typename Edge, typename Node>
+        inline HandleRange<Edge const*> getNodeListOfInEdges(Node const* ref, PerNode const& per) const
+        {
+            return _handleRange<Edge const*>(_edges.get<Edge>(), per._edges.data() + per._outEdgeCount, per._edges.data() + per._edges.size());
+        }
+
+        template<typename Prop, typename Node>
+        inline HandleRange<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per) const
+        {
+            return _handleRange<Prop const*>(_props.get<Prop>(), per._props.data(), per._props.data() + per._props.size());
+        }
+
+        template<typename Prop, typename Edge>
+        inline HandleRange<Prop const*> getEdgeListOfProps(Edge const* ref, PerEdge const& per) const
+        {
+            return _handleRange<Prop const*>(_props.get<Prop>(), per._props.data(), per._props.data() + per._props.size());
+        }
+
+    // relations setting
+    public:
+        template<typename Edge, typename NodeIt, typename NodeGetter>
+        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted, NodeIt begin, NodeIt end, NodeGetter getter)
+        {
+            using Node = std::remove_const_t<std::remove_pointer_t<std::decay_t<decltype(*begin)>>>;
+            auto& nodes = *_nodes.get<Node>();
+
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            for (size_t i = 0; i < edge_per_mut._nodes.size(); ++i)
+            {
+                auto& old_per_mut = nodes[edge_per_mut._nodes[i]].store;
+                _detail::eraseRoleSplit(old_per_mut._edges, old_per_mut._outEdgeCount, edge_per_mut._index, isOutgoingSlot(i == 0, inverted));
+            }
+            edge_per_mut._nodes.clear();
+            for (auto it = begin; it != end; ++it)
+            {
+                auto& node_per_mut = const_cast<PerNode&>(*getter(*it));
+
+                _detail::pushRoleSplit(node_per_mut._edges, node_per_mut._outEdgeCount, edge_per_mut._index, isOutgoingSlot(it == begin, inverted));
+                edge_per_mut._nodes.push_back(node_per_mut._index);
+            }
+        }
+
+        template<typename Edge, typename Node>
+        inline void attachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, size_t index, Node const* node, PerNode const& node_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& node_per_mut = const_cast<PerNode&>(node_per);
+
+            // the old first node loses its role
+            if (index == 0 && !edge_per_mut._nodes.empty())
+            {
+                auto& first_per_mut = (*_nodes.get<Node>())[edge_per_mut._nodes[0]].store;
+                _detail::flipRoleSplit(first_per_mut._edges, first_per_mut._outEdgeCount, edge_per_mut._index, isOutgoingSlot(false, inverted));
+            }
+
+            edge_per_mut._nodes.insert(edge_per_mut._nodes.begin() + index, node_per_mut._index);
+            _detail::pushRoleSplit(node_per_mut._edges, node_per_mut._outEdgeCount, edge_per_mut._index, isOutgoingSlot(index == 0, inverted));
+        }
+
+        template<typename Node, typename Prop>
+        inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& node_per_mut = const_cast<PerNode&>(node_per);
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _requireUnattached(prop_per_mut);
+
+            node_per_mut._props.push_back(prop_per_mut._index);
+            prop_per_mut._parent = node_per_mut._index;
+            prop_per_mut._parentKind = GraphKind::Node;
+        }
+
+        template<typename Edge, typename Prop>
+        inline void attachEdgeProp(Edge const* edge, PerEdge const& edge_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _requireUnattached(prop_per_mut);
+
+            edge_per_mut._props.push_back(prop_per_mut._index);
+            prop_per_mut._parent = edge_per_mut._index;
+            prop_per_mut._parentKind = GraphKind::Edge;
+        }
+
+    // helpers
+    private:
+        static inline void _requireUnattached(PerProp const& per)
+        {
+            if (per._parent != npos)
+                throw graph_error("HandleStorage cannot move a prop to another parent.");
+        }
+
+        template<typename T>
+        inline Handle _nextHandle(Store<T> const& store) const
+        {
+            if (store.size() >= npos)
+                throw graph_error("HandleStorage is out of handles.");
+
+            return (Handle)store.size();
+        }
+
+        template<typename T, typename TStore>
+        static inline HandleRange<T> _handleRange(TStore const* store, Handle const* begin, Handle const* end)
+        {
+            return HandleRange<T>(HandleIterator<T>(store, begin), HandleIterator<T>(store, end));
+        }
+    };
+}}
@@ -0,0 +1,104 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+#include "graph/small_vector.hpp"
+
+namespace ugly {
+namespace storage
+{
+    // The memory of one primary store.
+    struct StoreMemoryStats
+    {
+        // live elements
+        size_t count = 0;
+        // elements taking space, including removed ones waiting for reuse
+        size_t slots = 0;
+        // size of one element, its data and storage fields
+        size_t elementBytes = 0;
+        // the slots and the store's own bookkeeping
+        size_t bytes = 0;
+    };
+
+    // The memory of a graph as reported by `memoryStats()`. Byte counts are what the containers
+    // hold, allocator overhead is not included.
+    struct MemoryStats
+    {
+        StoreMemoryStats nodes;
+        StoreMemoryStats edges;
+        StoreMemoryStats paths;
+        StoreMemoryStats labels;
+        StoreMemoryStats props;
+
+        // relationship lists in use (edges and props of nodes, nodes and props of edges, label members)
+        size_t adjacencyBytes = 0;
+        // capacity of the relationship lists beyond their size
+        size_t adjacencySlackBytes = 0;
+        // space the storage reserved and has not used yet, e.g. the rest of a mapped file
+        size_t reservedBytes = 0;
+        // heap memory owned by element data, e.g. strings too long to be stored inline
+        size_t dataBytes = 0;
+        // the graph's secondary indexes and keyed prop columns
+        size_t indexBytes = 0;
+
+        // edges per node, counting an edge once per slot the node has in it
+        double averageDegree = 0;
+        size_t maxDegree = 0;
+
+        inline size_t storeBytes() const
+        {
+            return nodes.bytes + edges.bytes + paths.bytes + labels.bytes + props.bytes;
+        }
+
+        inline size_t totalBytes() const
+        {
+            return storeBytes() + adjacencyBytes + adjacencySlackBytes + reservedBytes + dataBytes + indexBytes;
+        }
+
+        // Accounts a relationship list.
+        template<typename T>
+        inline void addList(std::vector<T> const& list)
+        {
+            adjacencyBytes += list.size() * sizeof(T);
+            adjacencySlackBytes += (list.capacity() - list.size()) * sizeof(T);
+        }
+
+        // Inline values are part of the element, only spilled lists count.
+        template<typename T, size_t N>
+        inline void addList(SmallVector<T, N> const& list)
+        {
+            if (list.inlined())
+                return;
+
+            adjacencyBytes += list.size() * sizeof(T);
+            adjacencySlackBytes += (list.capacity() - list.size()) * sizeof(T);
+        }
+    };
+
+    inline std::ostream& operator<<(std::ostream& out, StoreMemoryStats const& stats)
+    {
+        return out << stats.count << " (" << stats.slots << " slots of " << stats.elementBytes << " bytes), " << stats.bytes << " bytes";
+    }
+
+    inline std::ostream& operator<<(std::ostream& out, MemoryStats const& stats)
+    {
+        out << "nodes: " << stats.nodes << "\n";
+        out << "edges: " << stats.edges << "\n";
+        out << "paths: " << stats.paths << "\n";
+        out << "labels: " << stats.labels << "\n";
+        out << "props: " << stats.props << "\n";
+        out << "adjacency: " << stats.adjacencyBytes << " bytes, " << stats.adjacencySlackBytes << " bytes slack\n";
+        out << "reserved: " << stats.reservedBytes << " bytes\n";
+        out << "data: " << stats.dataBytes << " bytes\n";
+        out << "indexes: " << stats.indexBytes << " bytes\n";
+        out << "degree: " << stats.averageDegree << " average, " << stats.maxDegree << " max\n";
+        out << "total: " << stats.totalBytes() << " bytes\n";
+        return out;
+    }
+}}
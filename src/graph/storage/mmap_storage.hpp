@@ -0,0 +1,690 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "graph/util.hpp"
+
+#include "memory_stats.hpp"
+
+/*
+ * This file contains the memory mapped storage, which keeps the whole graph in one file:
+ * - Elements and relationship lists are allocated from the mapping, relationships are offsets
+ *   from the start of the mapping instead of pointers.
+ * - Opening an existing file maps it and validates its header, pages fault in on demand.
+ * - Files opened read only can be shared between processes through the page cache.
+ * - Without a file the storage is backed by anonymous memory.
+ *
+ * The address range of the mapping is reserved up front so elements never move while the file
+ * grows. Graph data must be trivially copyable (e.g. interned ids instead of strings).
+ *
+ * Nodes can only be appended to edges, and removal is not supported.
+ */
+
+namespace ugly {
+namespace storage
+{
+    class MmapStorage
+    {
+    public:
+        using Offset = uint64_t;
+
+        static constexpr bool denseHandles = false;
+        static constexpr bool concurrent = false;
+        static constexpr bool versioned = false;
+        static constexpr bool labelMembership = false;
+        static constexpr bool nodeIndices = false;
+        static constexpr bool bulkAdjacency = false;
+        static constexpr bool pathLists = false;
+        static constexpr bool removal = false;
+
+        // address space reserved for the mapping, the file only grows as needed
+        static constexpr size_t defaultCapacity = size_t(1) << 34;
+        static constexpr uint32_t version = 1;
+
+    protected:
+        static constexpr char _magic[8] = { 'U', 'G', 'L', 'Y', 'M', 'M', 'A', 'P' };
+        static constexpr size_t _minFileSize = size_t(1) << 20;
+        static constexpr uint32_t _maxBlockCapacity = 1024;
+
+        enum _StoreKind
+        {
+            _NodeStore,
+            _EdgeStore,
+            _PathStore,
+            _LabelStore,
+            _PropStore,
+            _StoreCount
+        };
+
+        // A chain of blocks of offsets, blocks double in size up to a limit.
+        struct _List
+        {
+            Offset _head;
+            Offset _tail;
+            uint64_t _size;
+        };
+
+        struct _Block
+        {
+            Offset _next;
+            uint32_t _count;
+            uint32_t _capacity;
+
+            inline Offset* items() { return (Offset*)(this + 1); }
+            inline Offset const* items() const { return (Offset const*)(this + 1); }
+        };
+
+        struct _Header
+        {
+            char _magic[8];
+            uint32_t _version;
+            uint32_t _reserved;
+            uint64_t _used;
+            uint64_t _elemSizes[_StoreCount];
+            _List _stores[_StoreCount];
+        };
+
+    public:
+        struct PerNode
+        {
+            _List _props;
+            _List _outEdges;
+            _List _inEdges;
+        };
+
+        struct PerEdge
+        {
+            _List _props;
+            _List _nodes;
+        };
+
+        struct PerPath
+        {
+
+        };
+
+        struct PerLabel
+        {
+
+        };
+
+        struct PerProp
+        {
+            Offset _parent;
+            GraphKind _parentKind;
+        };
+
+    public:
+        // Walks a list of offsets, and optionally a second one after it (e.g. outgoing then incoming
+        // edges). Yields pointers, or references with `TDeref`.
+        template<typename T, bool TDeref = false>
+        class OffsetIterator
+        {
+            char const* _base;
+            Offset _block;
+            uint32_t _index;
+            Offset _then;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::conditional_t<TDeref, std::remove_const_t<std::remove_pointer_t<T>>, T>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<TDeref, T, T const*>;
+            using reference = std::conditional_t<TDeref, std::remove_pointer_t<T>&, T>;
+
+            inline OffsetIterator()
+                : _base(nullptr), _block(0), _index(0), _then(0)
+            { }
+            inline OffsetIterator(char const* base, Offset block, Offset then)
+                : _base(base), _block(block), _index(0), _then(then)
+            {
+                if (_block == 0)
+                    _next();
+            }
+
+            inline reference operator*() const
+            {
+                auto ptr = (T)(_base + ((_Block const*)(_base + _block))->items()[_index]);
+                if constexpr (TDeref)
+                    return *ptr;
+                else
+                    return ptr;
+            }
+
+            inline OffsetIterator& operator++()
+            {
+                if (++_index == ((_Block const*)(_base + _block))->_count)
+                {
+                    _block = ((_Block const*)(_base + _block))->_next;
+                    _index = 0;
+                    if (_block == 0)
+                        _next();
+                }
+                return *this;
+            }
+            inline OffsetIterator operator++(int)
+            {
+                OffsetIterator res = *this;
+                ++*this;
+                return res;
+            }
+
+            inline bool operator==(OffsetIterator const& that) const { return _block == that._block && _index == that._index; }
+            inline bool operator!=(OffsetIterator const& that) const { return !(*this == that); }
+
+        private:
+            inline void _next()
+            {
+                _block = _then;
+                _then = 0;
+            }
+        };
+
+        template<typename T>
+        using OffsetRange = IteratorRange<OffsetIterator<T>>;
+
+    private:
+        char* _base;
+        size_t _capacity;
+        size_t _fileSize;
+        int _fd;
+        bool _readOnly;
+
+    public:
+        // Backed by anonymous memory, nothing is persisted.
+        inline MmapStorage(size_t capacity = defaultCapacity)
+            : _base(nullptr), _capacity(capacity), _fileSize(capacity), _fd(-1), _readOnly(false)
+        {
+            void* base = ::mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (base == MAP_FAILED)
+                throw graph_error("MmapStorage could not reserve its mapping.");
+            _base = (char*)base;
+
+            _initHeader();
+        }
+
+        // Opens the graph in the file, or creates it if the file is empty or missing.
+        inline MmapStorage(std::string const& path, bool read_only = false, size_t capacity = defaultCapacity)
+            : _base(nullptr), _capacity(capacity), _fileSize(0), _fd(-1), _readOnly(read_only)
+        {
+            _fd = ::open(path.c_str(), read_only ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+            if (_fd < 0)
+                throw graph_error("MmapStorage could not open `" + path + "`.");
+
+            struct stat st;
+            if (::fstat(_fd, &st) != 0)
+            {
+                _close();
+                throw graph_error("MmapStorage could not stat `" + path + "`.");
+            }
+            _fileSize = (size_t)st.st_size;
+
+            bool created = _fileSize == 0;
+            if (created && read_only)
+            {
+                _close();
+                throw graph_error("MmapStorage cannot create a read only graph.");
+            }
+            if (_fileSize > _capacity)
+            {
+                _close();
+                throw graph_error("MmapStorage file is larger than the capacity.");
+            }
+
+            // reserve the whole capacity, the file is mapped into the front of it
+            void* base = ::mmap(nullptr, _capacity, read_only ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED | MAP_NORESERVE, _fd, 0);
+            if (base == MAP_FAILED)
+            {
+                _close();
+                throw graph_error("MmapStorage could not map `" + path + "`.");
+            }
+            _base = (char*)base;
+
+            if (created)
+            {
+                _grow(_minFileSize);
+                _initHeader();
+            }
+            else if (_fileSize < sizeof(_Header)
+                || std::memcmp(_header()._magic, _magic, sizeof(_magic)) != 0
+                || _header()._version != version
+                || _header()._used > _fileSize)
+            {
+                _close();
+                throw graph_error("MmapStorage file `" + path + "` is not a graph.");
+            }
+        }
+
+        inline MmapStorage(MmapStorage const&) = delete;
+
+        inline ~MmapStorage()
+        {
+            _close();
+        }
+
+        inline bool isReadOnly() const { return _readOnly; }
+
+        // Writes dirty pages back to the file, the kernel does so eventually anyway.
+        inline void flush() const
+        {
+            if (_fd >= 0 && !_readOnly)
+                ::msync(_base, _fileSize, MS_SYNC);
+        }
+
+    // initPrimary*Store
+    public:
+        template<typename Node>
+        inline void initPrimaryNodeStore()
+        {
+            _initStore<Node>(_NodeStore);
+        }
+        template<typename Edge>
+        inline void initPrimaryEdgeStore()
+        {
+            _initStore<Edge>(_EdgeStore);
+        }
+        template<typename Path>
+        inline void initPrimaryPathStore()
+        {
+            _initStore<Path>(_PathStore);
+        }
+        template<typename Label>
+        inline void initPrimaryLabelStore()
+        {
+            _initStore<Label>(_LabelStore);
+        }
+        template<typename Prop>
+        inline void initPrimaryPropStore()
+        {
+            _initStore<Prop>(_PropStore);
+        }
+
+    // countPrimary*Store
+    public:
+        template<typename Node>
+        inline size_t countPrimaryNodeStore() const
+        {
+            return _header()._stores[_NodeStore]._size;
+        }
+        template<typename Edge>
+        inline size_t countPrimaryEdgeStore() const
+        {
+            return _header()._stores[_EdgeStore]._size;
+        }
+        template<typename Path>
+        inline size_t countPrimaryPathStore() const
+        {
+            return _header()._stores[_PathStore]._size;
+        }
+        template<typename Label>
+        inline size_t countPrimaryLabelStore() const
+        {
+            return _header()._stores[_LabelStore]._size;
+        }
+        template<typename Prop>
+        inline size_t countPrimaryPropStore() const
+        {
+            return _header()._stores[_PropStore]._size;
+        }
+
+    // make*
+    public:
+        template<typename Node, typename Data>
+        inline Node* makeNode(Data const& data)
+        {
+            return _make<Node>(_NodeStore, data, PerNode { });
+        }
+        template<typename Edge, typename Data>
+        inline Edge* makeEdge(Data const& data)
+        {
+            return _make<Edge>(_EdgeStore, data, PerEdge { });
+        }
+        template<typename Path, typename Data>
+        inline Path* makePath(Data const& data)
+        {
+            return _make<Path>(_PathStore, data, PerPath { });
+        }
+        template<typename Label, typename Data>
+        inline Label* makeLabel(Data const& data)
+        {
+            return _make<Label>(_LabelStore, data, PerLabel { });
+        }
+        template<typename Prop, typename Data>
+        inline Prop* makeProp(Data const& data)
+        {
+            return _make<Prop>(_PropStore, data, PerProp { 0, GraphKind::Unknown });
+        }
+
+    // all*{Begin/End}
+    public:
+        template<typename Node>
+        inline OffsetIterator<Node const*, true> allNodesBegin() const
+        {
+            return OffsetIterator<Node const*, true>(_base, _header()._stores[_NodeStore]._head, 0);
+        }
+        template<typename Node>
+        inline OffsetIterator<Node const*, true> allNodesEnd() const
+        {
+            return OffsetIterator<Node const*, true>();
+        }
+
+        template<typename Edge>
+        inline OffsetIterator<Edge const*, true> allEdgesBegin() const
+        {
+            return OffsetIterator<Edge const*, true>(_base, _header()._stores[_EdgeStore]._head, 0);
+        }
+        template<typename Edge>
+        inline OffsetIterator<Edge const*, true> allEdgesEnd() const
+        {
+            return OffsetIterator<Edge const*, true>();
+        }
+
+        template<typename Label>
+        inline OffsetIterator<Label const*, true> allLabelsBegin() const
+        {
+            return OffsetIterator<Label const*, true>(_base, _header()._stores[_LabelStore]._head, 0);
+        }
+        template<typename Label>
+        inline OffsetIterator<Label const*, true> allLabelsEnd() const
+        {
+            return OffsetIterator<Label const*, true>();
+        }
+
+    // relations getting
+    public:
+        template<typename Node, typename Edge>
+        inline OffsetRange<Node const*> getEdgeListOfNodes(Edge const* ref, PerEdge const& per) const
+        {
+            return _range<Node const*>(per._nodes._head);
+        }
+
+        template<typename Edge, typename Node>
+        inline OffsetRange<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per) const
+        {
+            return _range<Edge const*>(per._outEdges._head, per._inEdges._head);
+        }
+
+        template<typename Edge, typename Node>
+        inline OffsetRange<Edge const*> getNodeListOfOutEdges(Node const* ref, PerNode const& per) const
+        {
+            return _range<Edge const*>(per._outEdges._head);
+        }
+
+        template<typename Edge, typename Node>
+        inline OffsetRange<Edge const*> getNodeListOfInEdges(Node const* ref, PerNode const& per) const
+        {
+            return _range<Edge const*>(per._inEdges._head);
+        }
+
+        template<typename Prop, typename Node>
+        inline OffsetRange<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per) const
+        {
+            return _range<Prop const*>(per._props._head);
+        }
+
+        template<typename Prop, typename Edge>
+        inline OffsetRange<Prop const*> getEdgeListOfProps(Edge const* ref, PerEdge const& per) const
+        {
+            return _range<Prop const*>(per._props._head);
+        }
+
+    // relations setting
+    public:
+        template<typename Edge, typename NodeIt, typename NodeGetter>
+        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted, NodeIt begin, NodeIt end, NodeGetter getter)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            if (edge_per_mut._nodes._size != 0)
+                throw graph_error("MmapStorage only appends nodes to edges.");
+
+            for (auto it = begin; it != end; ++it)
+            {
+                auto const* node = *it;
+                auto& node_per_mut = const_cast<PerNode&>(*getter(node));
+
+                _push(isOutgoingSlot(it == begin, inverted) ? node_per_mut._outEdges : node_per_mut._inEdges, _offsetOf(edge));
+                _push(edge_per_mut._nodes, _offsetOf(node));
+            }
+        }
+
+        template<typename Edge, typename Node>
+        inline void attachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, size_t index, Node const* node, PerNode const& node_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& node_per_mut = const_cast<PerNode&>(node_per);
+
+            if (index != edge_per_mut._nodes._size)
+                throw graph_error("MmapStorage only appends nodes to edges.");
+
+            _push(isOutgoingSlot(index == 0, inverted) ? node_per_mut._outEdges : node_per_mut._inEdges, _offsetOf(edge));
+            _push(edge_per_mut._nodes, _offsetOf(node));
+        }
+
+        template<typename Node, typename Prop>
+        inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& node_per_mut = const_cast<PerNode&>(node_per);
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _push(node_per_mut._props, _offsetOf(prop));
+            prop_per_mut._parent = _offsetOf(node);
+            prop_per_mut._parentKind = GraphKind::Node;
+        }
+
+        template<typename Edge, typename Prop>
+        inline void attachEdgeProp(Edge const* edge, PerEdge const& edge_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            _push(edge_per_mut._props, _offsetOf(prop));
+            prop_per_mut._parent = _offsetOf(edge);
+            prop_per_mut._parentKind = GraphKind::Edge;
+        }
+
+        template<typename Node, typename Label>
+        inline void attachNodeLabel(Node const* ref, PerNode const& per, Label const* label_ref, PerLabel const& label_per)
+        {
+
+        }
+
+    // edge roles
+    public:
+        // The first node of an edge is its source, the rest are targets, unless the edge is inverted.
+        static inline bool isOutgoingSlot(bool first, bool inverted)
+        {
+            return first != inverted;
+        }
+
+    // memory accounting
+    public:
+        // Everything lives in the mapping, the store lists are counted with their stores. The part
+        // of the file not used yet is reserved, anonymous mappings only take the pages written to.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void memoryStats(MemoryStats& stats) const
+        {
+            _storeMemoryStats(_NodeStore, stats.nodes);
+            _storeMemoryStats(_EdgeStore, stats.edges);
+            _storeMemoryStats(_PathStore, stats.paths);
+            _storeMemoryStats(_LabelStore, stats.labels);
+            _storeMemoryStats(_PropStore, stats.props);
+
+            for (auto it = allNodesBegin<Node>(); it != allNodesEnd<Node>(); ++it)
+            {
+                auto& per = (*it).store;
+                _listMemoryStats(per._props, stats.adjacencyBytes, stats.adjacencySlackBytes);
+                _listMemoryStats(per._outEdges, stats.adjacencyBytes, stats.adjacencySlackBytes);
+                _listMemoryStats(per._inEdges, stats.adjacencyBytes, stats.adjacencySlackBytes);
+            }
+            for (auto it = allEdgesBegin<Edge>(); it != allEdgesEnd<Edge>(); ++it)
+            {
+                auto& per = (*it).store;
+                _listMemoryStats(per._props, stats.adjacencyBytes, stats.adjacencySlackBytes);
+                _listMemoryStats(per._nodes, stats.adjacencyBytes, stats.adjacencySlackBytes);
+            }
+
+            if (_fd >= 0)
+                stats.reservedBytes += _fileSize - _header()._used;
+        }
+
+    // helpers
+    private:
+        inline void _storeMemoryStats(_StoreKind kind, StoreMemoryStats& stats) const
+        {
+            auto& header = _header();
+            stats.count = header._stores[kind]._size;
+            stats.slots = stats.count;
+            stats.elementBytes = header._elemSizes[kind];
+            stats.bytes = stats.count * stats.elementBytes;
+
+            size_t slack = 0;
+            _listMemoryStats(header._stores[kind], stats.bytes, slack);
+            stats.bytes += slack;
+        }
+
+        inline void _listMemoryStats(_List const& list, size_t& used, size_t& slack) const
+        {
+            for (auto at = list._head; at != 0; )
+            {
+                auto const* block = (_Block const*)(_base + at);
+                used += sizeof(_Block) + block->_count * sizeof(Offset);
+                slack += (block->_capacity - block->_count) * sizeof(Offset);
+                at = block->_next;
+            }
+        }
+
+        inline _Header& _header() { return *(_Header*)_base; }
+        inline _Header const& _header() const { return *(_Header const*)_base; }
+
+        inline Offset _offsetOf(void const* ref) const
+        {
+            return (Offset)((char const*)ref - _base);
+        }
+
+        inline void _initHeader()
+        {
+            auto& header = _header();
+            std::memset(&header, 0, sizeof(_Header));
+            std::memcpy(header._magic, _magic, sizeof(_magic));
+            header._version = version;
+            header._used = sizeof(_Header);
+        }
+
+        template<typename T>
+        inline void _initStore(_StoreKind kind)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "MmapStorage needs trivially copyable graph data.");
+
+            auto& elem_size = _header()._elemSizes[kind];
+            if (elem_size == sizeof(T))
+                return;
+            if (elem_size != 0)
+                throw graph_error("MmapStorage file was written with different graph types.");
+            if (_readOnly)
+                throw graph_error("MmapStorage is read only.");
+
+            elem_size = sizeof(T);
+        }
+
+        inline void _requireWritable() const
+        {
+            if (_readOnly)
+                throw graph_error("MmapStorage is read only.");
+        }
+
+        inline void _grow(size_t needed)
+        {
+            if (needed > _capacity)
+                throw graph_error("MmapStorage is out of capacity.");
+
+            if (_fd < 0)
+                return;
+
+            size_t size = std::max(std::max(_fileSize * 2, _minFileSize), needed);
+            size = std::min(size, _capacity);
+            if (::ftruncate(_fd, (off_t)size) != 0)
+                throw graph_error("MmapStorage could not grow its file.");
+            _fileSize = size;
+        }
+
+        inline Offset _allocate(size_t size, size_t align)
+        {
+            _requireWritable();
+
+            auto& header = _header();
+            Offset at = (header._used + align - 1) / align * align;
+            if (at + size > _fileSize)
+                _grow(at + size);
+
+            header._used = at + size;
+            return at;
+        }
+
+        inline void _push(_List& list, Offset item)
+        {
+            _requireWritable();
+
+            _Block* tail = list._tail == 0 ? nullptr : (_Block*)(_base + list._tail);
+            if (tail == nullptr || tail->_count == tail->_capacity)
+            {
+                uint32_t capacity = tail == nullptr ? 4 : std::min(tail->_capacity * 2, _maxBlockCapacity);
+                Offset at = _allocate(sizeof(_Block) + capacity * sizeof(Offset), alignof(_Block));
+
+                // the allocation may have grown the file, but never moves the mapping
+                _Block* block = new (_base + at) _Block { 0, 0, capacity };
+                if (tail == nullptr)
+                    list._head = at;
+                else
+                    tail->_next = at;
+                list._tail = at;
+                tail = block;
+            }
+
+            tail->items()[tail->_count++] = item;
+            ++list._size;
+        }
+
+        template<typename T, typename Data, typename Per>
+        inline T* _make(_StoreKind kind, Data const& data, Per && per)
+        {
+            Offset at = _allocate(sizeof(T), alignof(T));
+            T* ref = new (_base + at) T(data, std::move(per));
+
+            _push(_header()._stores[kind], at);
+            return ref;
+        }
+
+        template<typename T>
+        inline OffsetRange<T> _range(Offset head, Offset then = 0) const
+        {
+            return OffsetRange<T>(OffsetIterator<T>(_base, head, then), OffsetIterator<T>());
+        }
+
+        inline void _close()
+        {
+            if (_base != nullptr)
+            {
+                ::munmap(_base, _capacity);
+                _base = nullptr;
+            }
+            if (_fd >= 0)
+            {
+                ::close(_fd);
+                _fd = -1;
+            }
+        }
+    };
+}}
@@ -0,0 +1,172 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/*
+ * This file contains the segmented store, a primary store of large fixed size blocks:
+ * - Elements never move once made, and are found by index with a shift and a mask.
+ * - Blocks hold `TBlockSize` elements, large blocks come straight from the OS and their pages
+ *   are only committed once written.
+ * - With `THugePages` blocks are aligned to and padded out to huge pages, and the kernel is asked
+ *   to back them with transparent huge pages (Linux only, elsewhere it is a plain allocation). A
+ *   block must hold at least a huge page worth of elements.
+ */
+
+namespace ugly {
+namespace storage
+{
+    template<typename T, size_t TBlockSize = size_t(1) << 16, bool THugePages = false>
+    class SegmentedStore
+    {
+        static_assert(TBlockSize > 0 && (TBlockSize & (TBlockSize - 1)) == 0, "SegmentedStore block size must be a power of two.");
+
+    public:
+        static constexpr size_t blockSize = TBlockSize;
+        static constexpr bool hugePages = THugePages;
+
+        static constexpr size_t hugePageSize = size_t(2) << 20;
+        // smaller blocks would each be padded out to a whole huge page
+        static_assert(!THugePages || TBlockSize * sizeof(T) >= hugePageSize, "SegmentedStore blocks must fill a huge page when using huge pages.");
+
+        // the bytes allocated per block
+        static constexpr size_t blockBytes = THugePages
+            ? (TBlockSize * sizeof(T) + hugePageSize - 1) / hugePageSize * hugePageSize
+            : TBlockSize * sizeof(T);
+
+    protected:
+        static constexpr size_t _blockAlign = THugePages ? hugePageSize : alignof(T);
+
+        static constexpr size_t _shift()
+        {
+            size_t res = 0;
+            while ((size_t(1) << res) < TBlockSize)
+                ++res;
+            return res;
+        }
+        static constexpr size_t _blockShift = _shift();
+        static constexpr size_t _blockMask = TBlockSize - 1;
+
+        std::vector<T*> _blocks;
+        size_t _size = 0;
+
+    public:
+        template<bool TConst>
+        class Iterator
+        {
+            using Store = std::conditional_t<TConst, SegmentedStore const, SegmentedStore>;
+
+            Store* _store;
+            size_t _index;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<TConst, T const*, T*>;
+            using reference = std::conditional_t<TConst, T const&, T&>;
+
+            inline Iterator()
+                : _store(nullptr), _index(0)
+            { }
+            inline Iterator(Store* store, size_t index)
+                : _store(store), _index(index)
+            { }
+
+            inline reference operator*() const { return (*_store)[_index]; }
+            inline pointer operator->() const { return &(*_store)[_index]; }
+
+            inline Iterator& operator++()
+            {
+                ++_index;
+                return *this;
+            }
+            inline Iterator operator++(int)
+            {
+                Iterator res = *this;
+                ++_index;
+                return res;
+            }
+
+            inline bool operator==(Iterator const& that) const { return _index == that._index; }
+            inline bool operator!=(Iterator const& that) const { return _index != that._index; }
+        };
+
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+    public:
+        inline SegmentedStore() = default;
+
+        SegmentedStore(SegmentedStore const&) = delete;
+        SegmentedStore& operator=(SegmentedStore const&) = delete;
+
+        inline ~SegmentedStore()
+        {
+            for (size_t i = 0; i < _size; ++i)
+                (*this)[i].~T();
+            for (auto block : _blocks)
+                _freeBlock(block);
+        }
+
+        inline size_t size() const { return _size; }
+        inline bool empty() const { return _size == 0; }
+        inline size_t capacity() const { return _blocks.size() * TBlockSize; }
+
+        inline T& operator[](size_t index) { return _blocks[index >> _blockShift][index & _blockMask]; }
+        inline T const& operator[](size_t index) const { return _blocks[index >> _blockShift][index & _blockMask]; }
+
+        inline T& back() { return (*this)[_size - 1]; }
+        inline T const& back() const { return (*this)[_size - 1]; }
+
+        inline iterator begin() { return iterator(this, 0); }
+        inline iterator end() { return iterator(this, _size); }
+        inline const_iterator begin() const { return const_iterator(this, 0); }
+        inline const_iterator end() const { return const_iterator(this, _size); }
+
+        template<typename... TArgs>
+        inline T& emplace_back(TArgs&&... args)
+        {
+            if (_size == capacity())
+                _blocks.push_back(_allocateBlock());
+
+            T* ref = new (&(*this)[_size]) T(std::forward<TArgs>(args)...);
+            ++_size;
+            return *ref;
+        }
+
+        // The blocks and the block table, untouched pages of the last block included.
+        inline size_t memoryBytes() const
+        {
+            return _blocks.size() * blockBytes + _blocks.capacity() * sizeof(T*);
+        }
+
+    protected:
+        static inline T* _allocateBlock()
+        {
+            void* block = ::operator new(blockBytes, std::align_val_t(_blockAlign));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if constexpr (THugePages)
+                ::madvise(block, blockBytes, MADV_HUGEPAGE);
+#endif
+            return (T*)block;
+        }
+
+        static inline void _freeBlock(T* block)
+        {
+            ::operator delete((void*)block, std::align_val_t(_blockAlign));
+        }
+    };
+}}
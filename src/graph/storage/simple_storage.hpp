@@ -7,82 +7,360 @@
 #include <vector>
 #include <deque>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
 
 #include "graph/util.hpp"
+#include "graph/bitmap.hpp"
+#include "graph/small_vector.hpp"
+
+#include "memory_stats.hpp"
+#include "segmented_store.hpp"
+
+/*
+ * This file contains the simple storage, a primary store per kind of element with pointer adjacency
+ * lists:
+ * - Removed nodes, edges, and props are tombstoned in place and their slots reused by later adds.
+ * - `compact()` moves the live elements into fresh stores and rewrites adjacency.
+ * - The primary stores are deques, or segmented stores with `SegmentedStorage`.
+ * - Props are attached once, when they are made.
+ *
+ * Adds and removals need a single writer, see ConcurrentStorage for concurrent adds.
+ */
 
 namespace ugly {
 namespace storage
 {
-    class SimpleStorage
+    // The container of every primary store, elements must keep their address once made.
+    struct DequeStoreLayout
+    {
+        template<typename T>
+        using Store = std::deque<T>;
+    };
+
+    template<size_t TBlockSize = size_t(1) << 16, bool THugePages = false>
+    struct SegmentedStoreLayout
+    {
+        template<typename T>
+        using Store = SegmentedStore<T, TBlockSize, THugePages>;
+    };
+
+    template<typename TStoreLayout = DequeStoreLayout>
+    class BasicSimpleStorage
     {
     public:
+        template<typename T>
+        using Store = typename TStoreLayout::template Store<T>;
+
+        // Storages with dense handles number their elements, see HandleStorage.
+        static constexpr bool denseHandles = false;
+        // Storages safe for concurrent adds, see ConcurrentStorage.
+        static constexpr bool concurrent = false;
+        // Storages readers can take snapshots of, see VersionedStorage.
+        static constexpr bool versioned = false;
+        // Storages tracking which nodes carry a label.
+        static constexpr bool labelMembership = true;
+        // Storages numbering their nodes by slot, keyed props are stored by it.
+        static constexpr bool nodeIndices = true;
+        // Storages letting bulk loads build node adjacency in one pass, see GraphBulkLoader.
+        static constexpr bool bulkAdjacency = true;
+        // Storages keeping the nodes and edges a path visits.
+        static constexpr bool pathLists = true;
+        // Storages able to remove elements and compact their stores.
+        static constexpr bool removal = true;
+
         struct PerNode
         {
+            // the slot in the primary store, label memberships and keyed props are kept by it
+            uint32_t _index = 0;
+
             std::vector<void*> _props;
 
+            // partitioned by role, the first `_outEdgeCount` edges are outgoing, the rest incoming
             std::vector<void*> _edges;
+            size_t _outEdgeCount = 0;
+
+            bool _dead = false;
         };
 
+        // Binary edges keep their nodes inline, only hyperedges allocate. Props are allocated with
+        // the first one.
         struct PerEdge
         {
-            std::vector<void*> _props;
+            SmallVector<void*, 0> _props;
 
-            std::vector<void*> _nodes;
+            SmallVector<void*, 2> _nodes;
+
+            bool _dead = false;
         };
 
         struct PerPath
         {
+            // in visiting order, `_edges[i]` connects `_nodes[i]` and `_nodes[i + 1]`
+            std::vector<void*> _nodes;
+            std::vector<void*> _edges;
 
+            bool _dead = false;
         };
 
         struct PerLabel
         {
-
+            Bitmap _nodes;
         };
 
         struct PerProp
         {
             void* _parent;
+            GraphKind _parentKind;
 
+            bool _dead;
         };
 
+    protected:
+        // Stores without a `_dead` member never tombstone.
+        template<typename TPer, typename = void>
+        struct _hasTombstone
+            : std::false_type
+        { };
+
+        template<typename TPer>
+        struct _hasTombstone<TPer, std::void_t<decltype(std::declval<TPer const&>()._dead)>>
+            : std::true_type
+        { };
+
+        template<typename T>
+        static inline bool _isLive(T const& ref)
+        {
+            if constexpr (_hasTombstone<decltype(ref.store)>::value)
+                return !ref.store._dead;
+            else
+                return true;
+        }
+
+    public:
+        // Iterates a primary store, skipping tombstoned slots.
+        template<typename T>
+        class LiveIterator
+        {
+            using BaseIterator = typename Store<T>::const_iterator;
+
+            BaseIterator _it;
+            BaseIterator _end;
+
+            inline void _skipDead()
+            {
+                while (_it != _end && !_isLive(*_it))
+                    ++_it;
+            }
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T const&;
+
+            inline LiveIterator(BaseIterator it, BaseIterator end)
+                : _it(it), _end(end)
+            {
+                _skipDead();
+            }
+
+            inline reference operator*() const { return *_it; }
+            inline pointer operator->() const { return &*_it; }
+
+            inline LiveIterator& operator++()
+            {
+                ++_it;
+                _skipDead();
+                return *this;
+            }
+            inline LiveIterator operator++(int)
+            {
+                LiveIterator res = *this;
+                ++*this;
+                return res;
+            }
+
+            inline bool operator==(LiveIterator const& that) const { return _it == that._it; }
+            inline bool operator!=(LiveIterator const& that) const { return _it != that._it; }
+        };
+
+    public:
+        // Resolves the node indices of a label into node pointers.
+        template<typename T>
+        class MemberIterator
+        {
+            using Element = std::remove_const_t<std::remove_pointer_t<T>>;
+
+            Store<Element> const* _store;
+            Bitmap::const_iterator _it;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T;
+
+            inline MemberIterator()
+                : _store(nullptr), _it()
+            { }
+            inline MemberIterator(Store<Element> const* store, Bitmap::const_iterator it)
+                : _store(store), _it(it)
+            { }
+
+            inline reference operator*() const { return &(*_store)[*_it]; }
+
+            inline MemberIterator& operator++()
+            {
+                ++_it;
+                return *this;
+            }
+            inline MemberIterator operator++(int)
+            {
+                MemberIterator res = *this;
+                ++_it;
+                return res;
+            }
+
+            inline bool operator==(MemberIterator const& that) const { return _it == that._it; }
+            inline bool operator!=(MemberIterator const& that) const { return _it != that._it; }
+        };
+
+        template<typename T>
+        using MemberRange = IteratorRange<MemberIterator<T>>;
+
     protected:
         struct _PrimaryStore
         {
             void* _store;
             size_t _storeElemSize;
+            void (*_destroy)(void*);
+
+            // tombstoned slots, reused before growing the store
+            std::vector<void*> _free;
 
             inline _PrimaryStore()
-                : _store(nullptr)
+                : _store(nullptr), _destroy(nullptr)
             {
 
             }
 
+            _PrimaryStore(_PrimaryStore const&) = delete;
+            _PrimaryStore& operator=(_PrimaryStore const&) = delete;
+
+            inline ~_PrimaryStore()
+            {
+                if (_destroy != nullptr)
+                    _destroy(_store);
+            }
+
             template<typename T>
             inline void init()
             {
                 assert(_store == nullptr);
 
-                _store = new std::deque<T>();
+                _store = new Store<T>();
                 _storeElemSize = sizeof(T);
+                _destroy = [](void* store) { delete (Store<T>*)store; };
             }
 
             template<typename T>
-            inline std::deque<T>* get()
+            inline Store<T>* get()
             {
                 assert(sizeof(T) == _storeElemSize);
-                return (std::deque<T>*)_store;
+                return (Store<T>*)_store;
             }
 
             template<typename T>
-            inline std::deque<T> const* get() const
+            inline Store<T> const* get() const
             {
                 assert(sizeof(T) == _storeElemSize);
-                return (std::deque<T> const*)_store;
+                return (Store<T> const*)_store;
+            }
+
+            template<typename T>
+            inline size_t count() const
+            {
+                return get<T>()->size() - _free.size();
+            }
+
+            template<typename T, typename... TArgs>
+            inline T& make(TArgs&&... args)
+            {
+                if (_free.empty())
+                    return get<T>()->emplace_back(std::forward<TArgs>(args)...);
+
+                // tombstones stay constructed so the store can destroy them, the new element is built
+                // first and moved over one so a throwing constructor leaves the slot intact
+                T value(std::forward<TArgs>(args)...);
+                T* slot = (T*)_free.back();
+                *slot = std::move(value);
+                _free.pop_back();
+                return *slot;
+            }
+
+            template<typename T>
+            inline void tombstone(T* ref)
+            {
+                ref->store._dead = true;
+                _free.push_back((void*)ref);
+            }
+
+            // The live elements in store order.
+            template<typename T>
+            inline std::vector<void*> live()
+            {
+                std::vector<void*> res;
+                for (auto& ref : *get<T>())
+                {
+                    if (_isLive(ref))
+                        res.push_back((void*)&ref);
+                }
+                return res;
+            }
+
+            // Moves the elements into a fresh store in the given order, recording where each went.
+            // Elements left out of the order are dropped, so it must hold every live one.
+            template<typename T>
+            inline void relocate(std::vector<void*> const& order, std::unordered_map<void*, void*>& moved)
+            {
+                auto old_store = get<T>();
+                auto new_store = new Store<T>();
+
+                for (auto ref : order)
+                    moved[ref] = (void*)&new_store->emplace_back(std::move(*(T*)ref));
+
+                delete old_store;
+                _store = new_store;
+                _free.clear();
+            }
+
+            template<typename T>
+            inline void memoryStats(StoreMemoryStats& stats) const
+            {
+                auto store = get<T>();
+                stats.count = store->size() - _free.size();
+                stats.slots = store->size();
+                stats.elementBytes = sizeof(T);
+                stats.bytes = _storeBytes(*store) + _free.capacity() * sizeof(void*);
+            }
+
+            template<typename T>
+            static inline size_t _storeBytes(std::deque<T> const& store)
+            {
+                return store.size() * sizeof(T);
+            }
+            template<typename T, size_t TBlockSize, bool THugePages>
+            static inline size_t _storeBytes(SegmentedStore<T, TBlockSize, THugePages> const& store)
+            {
+                return store.memoryBytes();
             }
         };
 
-    private:
+    protected:
         _PrimaryStore _nodes;
         _PrimaryStore _edges;
         _PrimaryStore _paths;
@@ -122,17 +400,17 @@ namespace storage
         template<typename Node>
         inline size_t countPrimaryNodeStore() const
         {
-            return _nodes.get<Node>()->size();
+            return _nodes.count<Node>();
         }
         template<typename Edge>
         inline size_t countPrimaryEdgeStore() const
         {
-            return _edges.get<Edge>()->size();
+            return _edges.count<Edge>();
         }
         template<typename Path>
         inline size_t countPrimaryPathStore() const
         {
-            return _paths.get<Path>()->size();
+            return _paths.count<Path>();
         }
         template<typename Label>
         inline size_t countPrimaryLabelStore() const
@@ -142,7 +420,7 @@ namespace storage
         template<typename Prop>
         inline size_t countPrimaryPropStore() const
         {
-            return _props.get<Prop>()->size();
+            return _props.count<Prop>();
         }
 
 
@@ -151,21 +429,25 @@ namespace storage
         template<typename Node, typename Data>
         inline Node* makeNode(Data const& data)
         {
-            Node& ref = _nodes.get<Node>()->emplace_back(data, PerNode());
+            auto& free = _nodes._free;
+            auto index = free.empty() ? (uint32_t)_nodes.get<Node>()->size() : ((Node*)free.back())->store._index;
+
+            Node& ref = _nodes.make<Node>(data, PerNode());
+            ref.store._index = index;
 
             return &ref;
         }
         template<typename Edge, typename Data>
         inline Edge* makeEdge(Data const& data)
         {
-            Edge& ref = _edges.get<Edge>()->emplace_back(data, PerEdge());
+            Edge& ref = _edges.make<Edge>(data, PerEdge());
 
             return &ref;
         }
         template<typename Path, typename Data>
         inline Path* makePath(Data const& data)
         {
-            Path& ref = _paths.get<Path>()->emplace_back(data, PerPath());
+            Path& ref = _paths.make<Path>(data, PerPath());
 
             return &ref;
         }
@@ -179,7 +461,7 @@ namespace storage
         template<typename Prop, typename Data>
         inline Prop* makeProp(Data const& data)
         {
-            Prop& ref = _props.get<Prop>()->emplace_back(data, PerProp());
+            Prop& ref = _props.make<Prop>(data, PerProp());
 
             return &ref;
         }
@@ -187,23 +469,51 @@ namespace storage
     // all*{Begin/End}
     public:
         template<typename Node>
-        inline typename std::deque<Node>::const_iterator allNodesBegin() const
+        inline LiveIterator<Node> allNodesBegin() const
         {
-            return _nodes.get<Node>()->begin();
+            auto nodes = _nodes.get<Node>();
+            return LiveIterator<Node>(nodes->begin(), nodes->end());
         }
         template<typename Node>
-        inline typename std::deque<Node>::const_iterator allNodesEnd() const
+        inline LiveIterator<Node> allNodesEnd() const
+        {
+            auto nodes = _nodes.get<Node>();
+            return LiveIterator<Node>(nodes->end(), nodes->end());
+        }
+
+        template<typename Edge>
+        inline LiveIterator<Edge> allEdgesBegin() const
+        {
+            auto edges = _edges.get<Edge>();
+            return LiveIterator<Edge>(edges->begin(), edges->end());
+        }
+        template<typename Edge>
+        inline LiveIterator<Edge> allEdgesEnd() const
+        {
+            auto edges = _edges.get<Edge>();
+            return LiveIterator<Edge>(edges->end(), edges->end());
+        }
+
+        template<typename Path>
+        inline LiveIterator<Path> allPathsBegin() const
         {
-            return _nodes.get<Node>()->end();
+            auto paths = _paths.get<Path>();
+            return LiveIterator<Path>(paths->begin(), paths->end());
+        }
+        template<typename Path>
+        inline LiveIterator<Path> allPathsEnd() const
+        {
+            auto paths = _paths.get<Path>();
+            return LiveIterator<Path>(paths->end(), paths->end());
         }
 
         template<typename Label>
-        inline typename std::deque<Label>::const_iterator allLabelsBegin() const
+        inline typename Store<Label>::const_iterator allLabelsBegin() const
         {
             return _labels.get<Label>()->begin();
         }
         template<typename Label>
-        inline typename std::deque<Label>::const_iterator allLabelsEnd() const
+        inline typename Store<Label>::const_iterator allLabelsEnd() const
         {
             return _labels.get<Label>()->end();
         }
@@ -211,110 +521,471 @@ namespace storage
     // relations getting
     public:
         template<typename Node, typename Edge>
-        inline std::vector<Node const*> getEdgeListOfNodes(Edge const* ref, PerEdge const& per) const
+        inline PointerRange<Node const*> getEdgeListOfNodes(Edge const* ref, PerEdge const& per) const
         {
-            std::vector<Node const*> list;
-            list.reserve(per._nodes.size());
+            return pointerRange<Node const*>(per._nodes);
+        }
 
-            std::transform(per._nodes.begin(), per._nodes.end(), std::back_inserter(list),
-                [](void* p) { return (Node const*)p; });
+        template<typename Edge, typename Node>
+        inline PointerRange<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per) const
+        {
+            return pointerRange<Edge const*>(per._edges);
+        }
 
-            return list;
+        template<typename Edge, typename Node>
+        inline PointerRange<Edge const*> getNodeListOfOutEdges(Node const* ref, PerNode const& per) const
+        {
+            return pointerRange<Edge const*>(per._edges.data(), per._edges.data() + per._outEdgeCount);
         }
 
         template<typename Edge, typename Node>
-        inline std::vector<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per) const
+        inline PointerRange<Edge const*> getNodeListOfInEdges(Node const* ref, PerNode const& per) const
         {
-            std::vector<Edge const*> list;
-            list.reserve(per._edges.size());
+            return pointerRange<Edge const*>(per._edges.data() + per._outEdgeCount, per._edges.data() + per._edges.size());
+        }
 
-            std::transform(per._edges.begin(), per._edges.end(), std::back_inserter(list),
-                [](void* p) { return (Edge const*)p; });
+        template<typename Prop, typename Node>
+        inline PointerRange<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per) const
+        {
+            return pointerRange<Prop const*>(per._props);
+        }
 
-            return list;
+        template<typename Prop, typename Edge>
+        inline PointerRange<Prop const*> getEdgeListOfProps(Edge const* ref, PerEdge const& per) const
+        {
+            return pointerRange<Prop const*>(per._props);
         }
 
-        template<typename Prop, typename Node>
-        inline std::vector<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per) const
+        template<typename Node, typename Path>
+        inline PointerRange<Node const*> getPathListOfNodes(Path const* ref, PerPath const& per) const
         {
-            std::vector<Prop const*> list;
-            list.reserve(per._props.size());
+            return pointerRange<Node const*>(per._nodes);
+        }
 
-            std::transform(per._props.begin(), per._props.end(), std::back_inserter(list),
-                [](void* p) { return (Prop const*)p; });
+        template<typename Edge, typename Path>
+        inline PointerRange<Edge const*> getPathListOfEdges(Path const* ref, PerPath const& per) const
+        {
+            return pointerRange<Edge const*>(per._edges);
+        }
 
-            return list;
+        template<typename Node, typename Label>
+        inline MemberRange<Node const*> getLabelListOfNodes(Label const* ref, PerLabel const& per) const
+        {
+            auto nodes = _nodes.get<Node>();
+            return MemberRange<Node const*>(MemberIterator<Node const*>(nodes, per._nodes.begin()), MemberIterator<Node const*>(nodes, per._nodes.end()));
         }
 
-        template<typename Prop, typename Edge>
-        inline std::vector<Prop const*> getEdgeListOfProps(Edge const* ref, PerEdge const& per) const
+    // label membership and node indices
+    public:
+        inline Bitmap const& labelMembers(PerLabel const& per) const
+        {
+            return per._nodes;
+        }
+
+        template<typename TPerNode>
+        inline uint32_t indexOfNode(TPerNode const& per) const
         {
-            std::vector<Prop const*> list;
-            list.reserve(per._props.size());
+            return per._index;
+        }
 
-            std::transform(per._props.begin(), per._props.end(), std::back_inserter(list),
-                [](void* p) { return (Prop const*)p; });
+        template<typename Node>
+        inline Node const* resolveNodeIndex(uint32_t index) const
+        {
+            return &(*_nodes.get<Node>())[index];
+        }
 
-            return list;
+        // The node a prop is on, `nullptr` for props on edges.
+        template<typename Node, typename TPerProp>
+        inline Node const* nodeOfProp(TPerProp const& per) const
+        {
+            return per._parentKind == GraphKind::Node ? (Node const*)per._parent : nullptr;
         }
 
     // relations setting
     public:
+        // Paths only point at what they visit, nodes and edges do not list their paths.
+        template<typename Path, typename NodeIt, typename EdgeIt>
+        inline void setPathListOfElements(Path const* path, PerPath const& path_per, NodeIt nodes_begin, NodeIt nodes_end, EdgeIt edges_begin, EdgeIt edges_end)
+        {
+            auto& path_per_mut = const_cast<PerPath&>(path_per);
+            path_per_mut._nodes.clear();
+            path_per_mut._nodes.reserve(std::distance(nodes_begin, nodes_end));
+            for (auto it = nodes_begin; it != nodes_end; ++it)
+                path_per_mut._nodes.push_back((void*)*it);
+            path_per_mut._edges.clear();
+            path_per_mut._edges.reserve(std::distance(edges_begin, edges_end));
+            for (auto it = edges_begin; it != edges_end; ++it)
+                path_per_mut._edges.push_back((void*)*it);
+        }
+
+        // Storages keeping `_edges` and `_outEdgeCount` on their nodes share this and `attachEdgeNode`.
         template<typename Edge, typename NodeIt, typename NodeGetter>
-        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, NodeIt begin, NodeIt end, NodeGetter getter)
+        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted, NodeIt begin, NodeIt end, NodeGetter getter)
         {
-            // TODO lock
+            using Node = std::remove_const_t<std::remove_pointer_t<std::decay_t<decltype(*begin)>>>;
+            using TPerNode = std::remove_const_t<std::remove_pointer_t<decltype(getter(*begin))>>;
 
             auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
-            // TODO remove from old nodes
+            for (size_t i = 0; i < edge_per_mut._nodes.size(); ++i)
+            {
+                auto& old_per_mut = ((Node*)edge_per_mut._nodes[i])->store;
+                _detail::eraseRoleSplit(old_per_mut._edges, old_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(i == 0, inverted));
+            }
             edge_per_mut._nodes.clear();
             for (auto it = begin; it != end; ++it)
             {
                 auto const* node = *it;
-                auto& node_per_mut = const_cast<PerNode&>(*getter(node));
+                auto& node_per_mut = const_cast<TPerNode&>(*getter(node));
 
-                node_per_mut._edges.push_back((void*)edge);
+                _detail::pushRoleSplit(node_per_mut._edges, node_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(it == begin, inverted));
                 edge_per_mut._nodes.push_back((void*)node);
             }
 
         }
 
+        template<typename Edge, typename Node, typename TPerNode>
+        inline void attachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, size_t index, Node const* node, TPerNode const& node_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& node_per_mut = const_cast<TPerNode&>(node_per);
+
+            // the old first node loses its role
+            if (index == 0 && !edge_per_mut._nodes.empty())
+            {
+                auto& first_per_mut = ((Node*)edge_per_mut._nodes[0])->store;
+                _detail::flipRoleSplit(first_per_mut._edges, first_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(false, inverted));
+            }
+
+            edge_per_mut._nodes.insert(edge_per_mut._nodes.begin() + index, (void*)node);
+            _detail::pushRoleSplit(node_per_mut._edges, node_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(index == 0, inverted));
+        }
+
         template<typename Node, typename Prop>
         inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
         {
-            // TODO lock
             auto& node_per_mut = const_cast<PerNode&>(node_per);
             auto& prop_per_mut = const_cast<PerProp&>(prop_per);
 
-            if (prop_per_mut._parent != nullptr)
-            {
-                // TODO remove from old parent
-            }
+            _requireUnattached(prop_per_mut);
 
             node_per_mut._props.push_back((void*)prop);
             prop_per_mut._parent = (void*)node;
+            prop_per_mut._parentKind = GraphKind::Node;
         }
 
         template<typename Edge, typename Prop>
         inline void attachEdgeProp(Edge const* edge, PerEdge const& edge_per, Prop const* prop, PerProp const& prop_per)
         {
-            // TODO lock
             auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
             auto& prop_per_mut = const_cast<PerProp&>(prop_per);
 
-            if (prop_per_mut._parent != nullptr)
-            {
-                // TODO remove from old parent
-            }
+            _requireUnattached(prop_per_mut);
 
             edge_per_mut._props.push_back((void*)prop);
             prop_per_mut._parent = (void*)edge;
+            prop_per_mut._parentKind = GraphKind::Edge;
         }
 
-        template<typename Node, typename Label>
-        inline void attachNodeLabel(Node const* ref, PerNode const& per, Label const* label_ref, PerLabel const& label_per)
+        // Storages numbering their nodes by `_index` share this.
+        template<typename Node, typename TPerNode, typename Label>
+        inline void attachNodeLabel(Node const* ref, TPerNode const& per, Label const* label_ref, PerLabel const& label_per)
+        {
+            const_cast<PerLabel&>(label_per)._nodes.add(per._index);
+        }
+
+    // relations removing
+    public:
+        // Removes the first occurrence of the node from the edge, the next node takes the first role.
+        template<typename Edge, typename Node>
+        inline void detachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, Node const* node, PerNode const& node_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& node_per_mut = const_cast<PerNode&>(node_per);
+
+            auto& nodes = edge_per_mut._nodes;
+            auto it = std::find(nodes.begin(), nodes.end(), (void*)node);
+            if (it == nodes.end())
+                return;
+
+            auto first = it == nodes.begin();
+            nodes.erase(it);
+            _detail::eraseRoleSplit(node_per_mut._edges, node_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(first, inverted));
+
+            if (first && !nodes.empty())
+            {
+                auto& first_per_mut = ((Node*)nodes[0])->store;
+                _detail::flipRoleSplit(first_per_mut._edges, first_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(true, inverted));
+            }
+        }
+
+        // Removes the edge from all of its nodes.
+        template<typename Node, typename Edge>
+        inline void clearEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+
+            auto& nodes = edge_per_mut._nodes;
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                auto& node_per_mut = ((Node*)nodes[i])->store;
+                _detail::eraseRoleSplit(node_per_mut._edges, node_per_mut._outEdgeCount, (void*)edge, isOutgoingSlot(i == 0, inverted));
+            }
+            nodes.clear();
+        }
+
+        template<typename Node, typename Edge, typename Prop>
+        inline void detachProp(Prop const* prop, PerProp const& prop_per)
+        {
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            auto erase = [&](auto& props)
+            {
+                props.erase(std::find(props.begin(), props.end(), (void*)prop));
+            };
+            if (prop_per_mut._parentKind == GraphKind::Node)
+                erase(((Node*)prop_per_mut._parent)->store._props);
+            else if (prop_per_mut._parentKind == GraphKind::Edge)
+                erase(((Edge*)prop_per_mut._parent)->store._props);
+
+            prop_per_mut._parent = nullptr;
+            prop_per_mut._parentKind = GraphKind::Unknown;
+        }
+
+        template<typename Label, typename Node>
+        inline void detachNodeLabels(Node const* ref, PerNode const& per)
+        {
+            for (auto& label : *_labels.get<Label>())
+                label.store._nodes.remove(per._index);
+        }
+
+        // The destroy functions expect the element to be detached from everything already.
+        template<typename Node>
+        inline void destroyNode(Node* ref)
+        {
+            ref->store._props.clear();
+            ref->store._edges.clear();
+            ref->store._outEdgeCount = 0;
+            _nodes.tombstone(ref);
+        }
+        template<typename Edge>
+        inline void destroyEdge(Edge* ref)
+        {
+            ref->store._props.clear();
+            ref->store._nodes.clear();
+            _edges.tombstone(ref);
+        }
+        template<typename Path>
+        inline void destroyPath(Path* ref)
+        {
+            ref->store._nodes.clear();
+            ref->store._edges.clear();
+            _paths.tombstone(ref);
+        }
+        template<typename Prop>
+        inline void destroyProp(Prop* ref)
+        {
+            _props.tombstone(ref);
+        }
+
+    // bulk loading
+    public:
+        // Sets the nodes of a new edge without listing the edge on them, `appendNodeListOfEdges`
+        // does that for many edges at once.
+        template<typename Edge, typename NodeIt>
+        inline void setEdgeListOfNodesOnly(Edge const* edge, PerEdge const& edge_per, NodeIt begin, NodeIt end)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            edge_per_mut._nodes.clear();
+            for (auto it = begin; it != end; ++it)
+                edge_per_mut._nodes.push_back((void*)*it);
+        }
+
+        // Lists edges on a node in a single exactly sized allocation, after the edges it has.
+        template<typename Node>
+        inline void appendNodeListOfEdges(Node const* node, PerNode const& per, void* const* out_begin, void* const* out_end, void* const* in_begin, void* const* in_end)
+        {
+            auto& per_mut = const_cast<PerNode&>(per);
+            auto& old_edges = per_mut._edges;
+            auto old_out = old_edges.begin() + per_mut._outEdgeCount;
+
+            std::vector<void*> edges;
+            edges.reserve(old_edges.size() + (out_end - out_begin) + (in_end - in_begin));
+            edges.insert(edges.end(), old_edges.begin(), old_out);
+            edges.insert(edges.end(), out_begin, out_end);
+            edges.insert(edges.end(), old_out, old_edges.end());
+            edges.insert(edges.end(), in_begin, in_end);
+
+            per_mut._outEdgeCount += out_end - out_begin;
+            old_edges = std::move(edges);
+        }
+
+        template<typename Node>
+        inline void reserveNodeListOfProps(Node const* node, PerNode const& per, size_t count)
+        {
+            auto& props = const_cast<PerNode&>(per)._props;
+            props.reserve(props.size() + count);
+        }
+
+    // compaction
+    public:
+        // Reclaims tombstoned slots, every node, edge, and prop pointer is invalidated.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void compact()
+        {
+            _relocate<Node, Edge, Path, Label, Prop>(_nodes.live<Node>(), _edges.live<Edge>(), _props.live<Prop>());
+        }
+
+        // Moves the nodes into the given order, which must hold every live node once. Edges follow
+        // the first node listing them and props their parent, so neighborhoods end up close together
+        // in the stores. Reclaims tombstoned slots and invalidates pointers like `compact()`.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void reorder(std::vector<Node const*> const& order)
+        {
+            std::vector<void*> nodes, edges, props;
+            std::unordered_set<void*> seen;
+            for (auto node : order)
+            {
+                nodes.push_back((void*)node);
+                for (auto edge : node->store._edges)
+                {
+                    if (seen.insert(edge).second)
+                        edges.push_back(edge);
+                }
+            }
+            // edges without nodes are not reached from any, they keep their relative order
+            for (auto edge : _edges.live<Edge>())
+            {
+                if (((Edge*)edge)->store._nodes.empty())
+                    edges.push_back(edge);
+            }
+
+            for (auto node : nodes)
+                props.insert(props.end(), ((Node*)node)->store._props.begin(), ((Node*)node)->store._props.end());
+            for (auto edge : edges)
+                props.insert(props.end(), ((Edge*)edge)->store._props.begin(), ((Edge*)edge)->store._props.end());
+            for (auto prop : _props.live<Prop>())
+            {
+                if (((Prop*)prop)->store._parent == nullptr)
+                    props.push_back(prop);
+            }
+
+            _relocate<Node, Edge, Path, Label, Prop>(nodes, edges, props);
+        }
+
+    protected:
+        // Paths keep their slots, only what they visit is rewritten.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void _relocate(std::vector<void*> const& nodes, std::vector<void*> const& edges, std::vector<void*> const& props)
+        {
+            // a node's new index is its position in the order
+            std::vector<uint32_t> renumbered(_nodes.get<Node>()->size(), 0);
+            for (size_t i = 0; i < nodes.size(); ++i)
+                renumbered[((Node*)nodes[i])->store._index] = (uint32_t)i;
+            for (auto& label : *_labels.get<Label>())
+            {
+                Bitmap members;
+                for (auto index : label.store._nodes)
+                    members.add(renumbered[index]);
+                label.store._nodes = std::move(members);
+            }
+
+            std::unordered_map<void*, void*> moved;
+            _nodes.relocate<Node>(nodes, moved);
+            _edges.relocate<Edge>(edges, moved);
+            _props.relocate<Prop>(props, moved);
+
+            auto rewrite = [&](auto& list)
+            {
+                for (auto& ref : list)
+                    ref = moved.at(ref);
+            };
+            uint32_t next_index = 0;
+            for (auto& node : *_nodes.get<Node>())
+            {
+                node.store._index = next_index++;
+                rewrite(node.store._props);
+                rewrite(node.store._edges);
+            }
+            for (auto& edge : *_edges.get<Edge>())
+            {
+                rewrite(edge.store._props);
+                rewrite(edge.store._nodes);
+            }
+            for (auto& prop : *_props.get<Prop>())
+            {
+                if (prop.store._parent != nullptr)
+                    prop.store._parent = moved.at(prop.store._parent);
+            }
+            for (auto& path : *_paths.get<Path>())
+            {
+                rewrite(path.store._nodes);
+                rewrite(path.store._edges);
+            }
+        }
+
+    // memory accounting
+    public:
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void memoryStats(MemoryStats& stats) const
         {
-            
+            _storeMemoryStats<Node, Edge, Path, Label, Prop>(stats);
+            for (auto& node : *_nodes.get<Node>())
+            {
+                stats.addList(node.store._props);
+                stats.addList(node.store._edges);
+            }
+            _edgeListMemoryStats<Edge>(stats);
+        }
+
+    protected:
+        // The primary stores and label members, shared by the storages built on this one.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void _storeMemoryStats(MemoryStats& stats) const
+        {
+            _nodes.memoryStats<Node>(stats.nodes);
+            _edges.memoryStats<Edge>(stats.edges);
+            _paths.memoryStats<Path>(stats.paths);
+            _labels.memoryStats<Label>(stats.labels);
+            _props.memoryStats<Prop>(stats.props);
+
+            for (auto& label : *_labels.get<Label>())
+                stats.adjacencyBytes += label.store._nodes.memoryBytes();
+            for (auto& path : *_paths.get<Path>())
+            {
+                stats.addList(path.store._nodes);
+                stats.addList(path.store._edges);
+            }
+        }
+
+        template<typename Edge>
+        inline void _edgeListMemoryStats(MemoryStats& stats) const
+        {
+            for (auto& edge : *_edges.get<Edge>())
+            {
+                stats.addList(edge.store._props);
+                stats.addList(edge.store._nodes);
+            }
+        }
+
+        static inline void _requireUnattached(PerProp const& per)
+        {
+            if (per._parent != nullptr)
+                throw graph_error("Storage cannot move a prop to another parent.");
+        }
+
+    // edge roles
+    public:
+        // The first node of an edge is its source, the rest are targets, unless the edge is inverted.
+        static inline bool isOutgoingSlot(bool first, bool inverted)
+        {
+            return first != inverted;
         }
     };
+
+    using SimpleStorage = BasicSimpleStorage<>;
+
+    // SimpleStorage over segmented primary stores of `TBlockSize` elements, optionally backed by
+    // transparent huge pages, for graphs scanned often enough that TLB misses matter.
+    template<size_t TBlockSize = size_t(1) << 16, bool THugePages = false>
+    using SegmentedStorage = BasicSimpleStorage<SegmentedStoreLayout<TBlockSize, THugePages>>;
 }}
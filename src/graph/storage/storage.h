@@ -10,4 +10,13 @@
 
 #include "graph/util.hpp"
 
-#include "simple_storage.hpp"
\ No newline at end of file
+#include "simple_storage.hpp"
+#include "csr_storage.hpp"
+#include "handle_storage.hpp"
+#include "archetype_storage.hpp"
+#include "concurrent_storage.hpp"
+#include "versioned_storage.hpp"
+
+#ifndef _WIN32
+#include "mmap_storage.hpp"
+#endif
\ No newline at end of file
@@ -0,0 +1,729 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <memory>
+#include <new>
+#include <cassert>
+#include <algorithm>
+
+#include "graph/util.hpp"
+
+#include "memory_stats.hpp"
+
+/*
+ * This file contains the versioned storage, which lets readers walk a consistent graph while a
+ * single writer appends:
+ * - Every element is stamped with the epoch it was added in, each add is committed as a new epoch.
+ * - Primary stores are chunked and relationship lists are append only blocks, neither moves an
+ *   element or an entry a reader may be looking at. Full blocks are copied into larger ones.
+ * - Readers pin the committed epoch and ignore anything newer, which is always a suffix.
+ * - Replaced blocks are retired with the epoch they were replaced in, and freed once no reader
+ *   pinned before that epoch is left (epoch based reclamation).
+ *
+ * Relationships can only be appended, attaching nodes to an existing edge is not supported.
+ */
+
+namespace ugly {
+namespace storage
+{
+    class VersionedStorage
+    {
+    public:
+        using Epoch = uint64_t;
+        static constexpr Epoch latest = std::numeric_limits<Epoch>::max();
+
+        static constexpr bool denseHandles = false;
+        static constexpr bool concurrent = false;
+        static constexpr bool versioned = true;
+        static constexpr bool labelMembership = false;
+        static constexpr bool nodeIndices = false;
+        static constexpr bool bulkAdjacency = false;
+        static constexpr bool pathLists = false;
+        static constexpr bool removal = false;
+
+    protected:
+        struct _Block
+        {
+            size_t _capacity;
+            std::atomic<size_t> _size;
+            std::unique_ptr<void*[]> _items;
+
+            inline _Block(size_t capacity)
+                : _capacity(capacity), _size(0), _items(new void*[capacity])
+            { }
+        };
+
+        // An append only list, readers see a prefix of it whatever the writer does.
+        class _VersionedList
+        {
+            std::atomic<_Block*> _block;
+
+        public:
+            inline _VersionedList()
+                : _block(nullptr)
+            { }
+            // only used while constructing the owning element
+            inline _VersionedList(_VersionedList && that)
+                : _block(that._block.exchange(nullptr))
+            { }
+            inline ~_VersionedList()
+            {
+                delete _block.load();
+            }
+
+            inline void push(VersionedStorage& storage, void* item)
+            {
+                _Block* block = _block.load(std::memory_order_relaxed);
+                size_t size = block == nullptr ? 0 : block->_size.load(std::memory_order_relaxed);
+
+                if (block == nullptr || size == block->_capacity)
+                {
+                    _Block* grown = new _Block(block == nullptr ? 4 : block->_capacity * 2);
+                    std::copy(block == nullptr ? nullptr : block->_items.get(), block == nullptr ? nullptr : block->_items.get() + size, grown->_items.get());
+                    grown->_size.store(size, std::memory_order_relaxed);
+
+                    _block.store(grown, std::memory_order_release);
+                    if (block != nullptr)
+                        storage._retire(block);
+                    block = grown;
+                }
+
+                block->_items[size] = item;
+                block->_size.store(size + 1, std::memory_order_release);
+            }
+
+            inline void* const* view(size_t& size) const
+            {
+                _Block* block = _block.load(std::memory_order_acquire);
+                if (block == nullptr)
+                {
+                    size = 0;
+                    return nullptr;
+                }
+
+                size = block->_size.load(std::memory_order_acquire);
+                return block->_items.get();
+            }
+
+            inline void memoryStats(MemoryStats& stats) const
+            {
+                _Block* block = _block.load(std::memory_order_acquire);
+                if (block == nullptr)
+                    return;
+
+                auto size = block->_size.load(std::memory_order_acquire);
+                stats.adjacencyBytes += sizeof(_Block) + size * sizeof(void*);
+                stats.adjacencySlackBytes += (block->_capacity - size) * sizeof(void*);
+            }
+        };
+
+        // A chunked primary store, elements never move once made.
+        struct _VersionedStore
+        {
+            static constexpr size_t chunkSize = 1024;
+
+            _VersionedList _chunks;
+            std::atomic<size_t> _size;
+            size_t _storeElemSize;
+            void (*_destroy)(void*, size_t);
+
+            inline _VersionedStore()
+                : _size(0), _storeElemSize(0), _destroy(nullptr)
+            { }
+
+            inline ~_VersionedStore()
+            {
+                if (_destroy == nullptr)
+                    return;
+
+                size_t chunk_count;
+                auto chunks = _chunks.view(chunk_count);
+                auto size = _size.load();
+                for (size_t i = 0; i < chunk_count; ++i)
+                    _destroy(chunks[i], std::min(chunkSize, size - i * chunkSize));
+            }
+
+            template<typename T>
+            inline void init()
+            {
+                assert(_destroy == nullptr);
+
+                _storeElemSize = sizeof(T);
+                _destroy = [](void* chunk, size_t count)
+                {
+                    for (size_t i = 0; i < count; ++i)
+                        ((T*)chunk)[i].~T();
+                    ::operator delete(chunk);
+                };
+            }
+
+            template<typename T, typename... TArgs>
+            inline T& make(VersionedStorage& storage, TArgs&&... args)
+            {
+                assert(sizeof(T) == _storeElemSize);
+
+                auto size = _size.load(std::memory_order_relaxed);
+                if (size % chunkSize == 0)
+                    _chunks.push(storage, ::operator new(sizeof(T) * chunkSize));
+
+                T& ref = *new (&_at<T>(size)) T(std::forward<TArgs>(args)...);
+                _size.store(size + 1, std::memory_order_release);
+                return ref;
+            }
+
+            // The number of elements visible at the epoch, epochs only grow along the store.
+            template<typename T>
+            inline size_t count(Epoch epoch) const
+            {
+                auto size = _size.load(std::memory_order_acquire);
+                if (epoch == latest)
+                    return size;
+
+                size_t low = 0, high = size;
+                while (low < high)
+                {
+                    auto mid = low + (high - low) / 2;
+                    if (_at<T>(mid).store._epoch <= epoch)
+                        low = mid + 1;
+                    else
+                        high = mid;
+                }
+                return low;
+            }
+
+            template<typename T>
+            inline void memoryStats(StoreMemoryStats& stats) const
+            {
+                assert(sizeof(T) == _storeElemSize);
+
+                size_t chunk_count;
+                _chunks.view(chunk_count);
+                stats.count = _size.load(std::memory_order_acquire);
+                stats.slots = chunk_count * chunkSize;
+                stats.elementBytes = sizeof(T);
+                stats.bytes = stats.slots * sizeof(T) + chunk_count * sizeof(void*);
+            }
+
+            template<typename T>
+            inline T& _at(size_t index) const
+            {
+                size_t chunk_count;
+                auto chunks = _chunks.view(chunk_count);
+                return ((T*)chunks[index / chunkSize])[index % chunkSize];
+            }
+        };
+
+    public:
+        struct PerNode
+        {
+            Epoch _epoch;
+
+            _VersionedList _props;
+            _VersionedList _outEdges;
+            _VersionedList _inEdges;
+        };
+
+        struct PerEdge
+        {
+            Epoch _epoch;
+
+            _VersionedList _props;
+
+            // written once, before the edge becomes visible
+            std::vector<void*> _nodes;
+        };
+
+        struct PerPath
+        {
+            Epoch _epoch;
+        };
+
+        struct PerLabel
+        {
+            Epoch _epoch;
+        };
+
+        struct PerProp
+        {
+            Epoch _epoch;
+
+            void* _parent;
+            GraphKind _parentKind;
+        };
+
+    public:
+        // Walks up to two spans of relations as one (e.g. outgoing then incoming edges).
+        template<typename T>
+        class SpanIterator
+        {
+            void* const* _first;
+            size_t _firstSize;
+            void* const* _second;
+            size_t _index;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T;
+
+            inline SpanIterator()
+                : _first(nullptr), _firstSize(0), _second(nullptr), _index(0)
+            { }
+            inline SpanIterator(void* const* first, size_t first_size, void* const* second, size_t index)
+                : _first(first), _firstSize(first_size), _second(second), _index(index)
+            { }
+
+            inline reference operator*() const
+            {
+                return (T)(_index < _firstSize ? _first[_index] : _second[_index - _firstSize]);
+            }
+
+            inline SpanIterator& operator++()
+            {
+                ++_index;
+                return *this;
+            }
+            inline SpanIterator operator++(int)
+            {
+                SpanIterator res = *this;
+                ++_index;
+                return res;
+            }
+
+            inline bool operator==(SpanIterator const& that) const { return _index == that._index; }
+            inline bool operator!=(SpanIterator const& that) const { return _index != that._index; }
+        };
+
+        template<typename T>
+        using SpanRange = IteratorRange<SpanIterator<T>>;
+
+        template<typename T>
+        class ElementIterator
+        {
+            _VersionedStore const* _store;
+            size_t _index;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T const&;
+
+            inline ElementIterator(_VersionedStore const* store, size_t index)
+                : _store(store), _index(index)
+            { }
+
+            inline reference operator*() const { return _store->_at<T>(_index); }
+            inline pointer operator->() const { return &**this; }
+
+            inline ElementIterator& operator++()
+            {
+                ++_index;
+                return *this;
+            }
+            inline ElementIterator operator++(int)
+            {
+                ElementIterator res = *this;
+                ++_index;
+                return res;
+            }
+
+            inline bool operator==(ElementIterator const& that) const { return _index == that._index; }
+            inline bool operator!=(ElementIterator const& that) const { return _index != that._index; }
+        };
+
+    private:
+        _VersionedStore _nodes;
+        _VersionedStore _edges;
+        _VersionedStore _paths;
+        _VersionedStore _labels;
+        _VersionedStore _props;
+
+        std::atomic<Epoch> _committed;
+
+        // readers pin and unpin through a const graph
+        mutable std::mutex _gcLock;
+        mutable std::multiset<Epoch> _readers;
+        // in retiring order, so by epoch
+        mutable std::deque<std::pair<Epoch, _Block*>> _retired;
+
+    public:
+        inline VersionedStorage()
+            : _committed(0)
+        { }
+
+        inline ~VersionedStorage()
+        {
+            for (auto& retired : _retired)
+                delete retired.second;
+        }
+
+    // epochs
+    public:
+        inline Epoch committedEpoch() const
+        {
+            return _committed.load(std::memory_order_acquire);
+        }
+
+        // Publishes everything added since the last commit.
+        inline void commit()
+        {
+            _committed.store(_pending(), std::memory_order_release);
+            _collect();
+        }
+
+        // Readers pin an epoch for as long as they look at the storage.
+        inline Epoch pinEpoch() const
+        {
+            std::lock_guard<std::mutex> lock(_gcLock);
+            auto epoch = committedEpoch();
+            _readers.insert(epoch);
+            return epoch;
+        }
+
+        inline void unpinEpoch(Epoch epoch) const
+        {
+            {
+                std::lock_guard<std::mutex> lock(_gcLock);
+                _readers.erase(_readers.find(epoch));
+            }
+            _collect();
+        }
+
+        inline size_t retiredCount() const
+        {
+            std::lock_guard<std::mutex> lock(_gcLock);
+            return _retired.size();
+        }
+
+    // initPrimary*Store
+    public:
+        template<typename Node>
+        inline void initPrimaryNodeStore()
+        {
+            _nodes.init<Node>();
+        }
+        template<typename Edge>
+        inline void initPrimaryEdgeStore()
+        {
+            _edges.init<Edge>();
+        }
+        template<typename Path>
+        inline void initPrimaryPathStore()
+        {
+            _paths.init<Path>();
+        }
+        template<typename Label>
+        inline void initPrimaryLabelStore()
+        {
+            _labels.init<Label>();
+        }
+        template<typename Prop>
+        inline void initPrimaryPropStore()
+        {
+            _props.init<Prop>();
+        }
+
+    // countPrimary*Store
+    public:
+        template<typename Node>
+        inline size_t countPrimaryNodeStore(Epoch epoch = latest) const
+        {
+            return _nodes.count<Node>(epoch);
+        }
+        template<typename Edge>
+        inline size_t countPrimaryEdgeStore(Epoch epoch = latest) const
+        {
+            return _edges.count<Edge>(epoch);
+        }
+        template<typename Path>
+        inline size_t countPrimaryPathStore(Epoch epoch = latest) const
+        {
+            return _paths.count<Path>(epoch);
+        }
+        template<typename Label>
+        inline size_t countPrimaryLabelStore(Epoch epoch = latest) const
+        {
+            return _labels.count<Label>(epoch);
+        }
+        template<typename Prop>
+        inline size_t countPrimaryPropStore(Epoch epoch = latest) const
+        {
+            return _props.count<Prop>(epoch);
+        }
+
+    // make*
+    public:
+        template<typename Node, typename Data>
+        inline Node* makeNode(Data const& data)
+        {
+            return &_nodes.make<Node>(*this, data, PerNode { _pending(), {}, {}, {} });
+        }
+        template<typename Edge, typename Data>
+        inline Edge* makeEdge(Data const& data)
+        {
+            return &_edges.make<Edge>(*this, data, PerEdge { _pending(), {}, {} });
+        }
+        template<typename Path, typename Data>
+        inline Path* makePath(Data const& data)
+        {
+            return &_paths.make<Path>(*this, data, PerPath { _pending() });
+        }
+        template<typename Label, typename Data>
+        inline Label* makeLabel(Data const& data)
+        {
+            return &_labels.make<Label>(*this, data, PerLabel { _pending() });
+        }
+        template<typename Prop, typename Data>
+        inline Prop* makeProp(Data const& data)
+        {
+            return &_props.make<Prop>(*this, data, PerProp { _pending(), nullptr, GraphKind::Unknown });
+        }
+
+    // all*{Begin/End}
+    public:
+        template<typename Node>
+        inline ElementIterator<Node> allNodesBegin(Epoch epoch = latest) const
+        {
+            return ElementIterator<Node>(&_nodes, 0);
+        }
+        template<typename Node>
+        inline ElementIterator<Node> allNodesEnd(Epoch epoch = latest) const
+        {
+            return ElementIterator<Node>(&_nodes, _nodes.count<Node>(epoch));
+        }
+
+        template<typename Edge>
+        inline ElementIterator<Edge> allEdgesBegin(Epoch epoch = latest) const
+        {
+            return ElementIterator<Edge>(&_edges, 0);
+        }
+        template<typename Edge>
+        inline ElementIterator<Edge> allEdgesEnd(Epoch epoch = latest) const
+        {
+            return ElementIterator<Edge>(&_edges, _edges.count<Edge>(epoch));
+        }
+
+        template<typename Label>
+        inline ElementIterator<Label> allLabelsBegin(Epoch epoch = latest) const
+        {
+            return ElementIterator<Label>(&_labels, 0);
+        }
+        template<typename Label>
+        inline ElementIterator<Label> allLabelsEnd(Epoch epoch = latest) const
+        {
+            return ElementIterator<Label>(&_labels, _labels.count<Label>(epoch));
+        }
+
+    // relations getting
+    public:
+        template<typename Node, typename Edge>
+        inline PointerRange<Node const*> getEdgeListOfNodes(Edge const* ref, PerEdge const& per, Epoch epoch = latest) const
+        {
+            return pointerRange<Node const*>(per._nodes);
+        }
+
+        template<typename Edge, typename Node>
+        inline SpanRange<Edge const*> getNodeListOfEdges(Node const* ref, PerNode const& per, Epoch epoch = latest) const
+        {
+            size_t out_size, in_size;
+            auto out = _visible<Edge>(per._outEdges, epoch, out_size);
+            auto in = _visible<Edge>(per._inEdges, epoch, in_size);
+            return SpanRange<Edge const*>(
+                SpanIterator<Edge const*>(out, out_size, in, 0),
+                SpanIterator<Edge const*>(out, out_size, in, out_size + in_size));
+        }
+
+        template<typename Edge, typename Node>
+        inline SpanRange<Edge const*> getNodeListOfOutEdges(Node const* ref, PerNode const& per, Epoch epoch = latest) const
+        {
+            return _spanRange<Edge>(per._outEdges, epoch);
+        }
+
+        template<typename Edge, typename Node>
+        inline SpanRange<Edge const*> getNodeListOfInEdges(Node const* ref, PerNode const& per, Epoch epoch = latest) const
+        {
+            return _spanRange<Edge>(per._inEdges, epoch);
+        }
+
+        template<typename Prop, typename Node>
+        inline SpanRange<Prop const*> getNodeListOfProps(Node const* ref, PerNode const& per, Epoch epoch = latest) const
+        {
+            return _spanRange<Prop>(per._props, epoch);
+        }
+
+        template<typename Prop, typename Edge>
+        inline SpanRange<Prop const*> getEdgeListOfProps(Edge const* ref, PerEdge const& per, Epoch epoch = latest) const
+        {
+            return _spanRange<Prop>(per._props, epoch);
+        }
+
+    // relations setting
+    public:
+        template<typename Edge, typename NodeIt, typename NodeGetter>
+        inline void setEdgeListOfNodes(Edge const* edge, PerEdge const& edge_per, bool inverted, NodeIt begin, NodeIt end, NodeGetter getter)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            if (!edge_per_mut._nodes.empty())
+                throw graph_error("VersionedStorage edges are append only.");
+
+            for (auto it = begin; it != end; ++it)
+            {
+                auto const* node = *it;
+                auto& node_per_mut = const_cast<PerNode&>(*getter(node));
+
+                if (isOutgoingSlot(it == begin, inverted))
+                    node_per_mut._outEdges.push(*this, (void*)edge);
+                else
+                    node_per_mut._inEdges.push(*this, (void*)edge);
+                edge_per_mut._nodes.push_back((void*)node);
+            }
+        }
+
+        template<typename Edge, typename Node>
+        inline void attachEdgeNode(Edge const* edge, PerEdge const& edge_per, bool inverted, size_t index, Node const* node, PerNode const& node_per)
+        {
+            throw graph_error("VersionedStorage edges are append only.");
+        }
+
+        template<typename Node, typename Prop>
+        inline void attachNodeProp(Node const* node, PerNode const& node_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& node_per_mut = const_cast<PerNode&>(node_per);
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            node_per_mut._props.push(*this, (void*)prop);
+            prop_per_mut._parent = (void*)node;
+            prop_per_mut._parentKind = GraphKind::Node;
+        }
+
+        template<typename Edge, typename Prop>
+        inline void attachEdgeProp(Edge const* edge, PerEdge const& edge_per, Prop const* prop, PerProp const& prop_per)
+        {
+            auto& edge_per_mut = const_cast<PerEdge&>(edge_per);
+            auto& prop_per_mut = const_cast<PerProp&>(prop_per);
+
+            edge_per_mut._props.push(*this, (void*)prop);
+            prop_per_mut._parent = (void*)edge;
+            prop_per_mut._parentKind = GraphKind::Edge;
+        }
+
+        template<typename Node, typename Label>
+        inline void attachNodeLabel(Node const* ref, PerNode const& per, Label const* label_ref, PerLabel const& label_per)
+        {
+
+        }
+
+    // memory accounting
+    public:
+        // Counts every element, committed or not. Blocks retired while readers are pinned are
+        // counted as adjacency slack until they are freed.
+        template<typename Node, typename Edge, typename Path, typename Label, typename Prop>
+        inline void memoryStats(MemoryStats& stats) const
+        {
+            _nodes.memoryStats<Node>(stats.nodes);
+            _edges.memoryStats<Edge>(stats.edges);
+            _paths.memoryStats<Path>(stats.paths);
+            _labels.memoryStats<Label>(stats.labels);
+            _props.memoryStats<Prop>(stats.props);
+
+            for (size_t i = 0; i < stats.nodes.count; ++i)
+            {
+                auto& per = _nodes._at<Node>(i).store;
+                per._props.memoryStats(stats);
+                per._outEdges.memoryStats(stats);
+                per._inEdges.memoryStats(stats);
+            }
+            for (size_t i = 0; i < stats.edges.count; ++i)
+            {
+                auto& per = _edges._at<Edge>(i).store;
+                per._props.memoryStats(stats);
+                stats.addList(per._nodes);
+            }
+
+            std::lock_guard<std::mutex> lock(_gcLock);
+            for (auto& retired : _retired)
+                stats.adjacencySlackBytes += sizeof(_Block) + retired.second->_capacity * sizeof(void*);
+        }
+
+    // edge roles
+    public:
+        // The first node of an edge is its source, the rest are targets, unless the edge is inverted.
+        static inline bool isOutgoingSlot(bool first, bool inverted)
+        {
+            return first != inverted;
+        }
+
+    // helpers
+    private:
+        inline Epoch _pending() const
+        {
+            return _committed.load(std::memory_order_relaxed) + 1;
+        }
+
+        inline void _retire(_Block* block)
+        {
+            std::lock_guard<std::mutex> lock(_gcLock);
+            _retired.emplace_back(_pending(), block);
+        }
+
+        // Frees the blocks no pinned reader can still be looking at.
+        inline void _collect() const
+        {
+            std::lock_guard<std::mutex> lock(_gcLock);
+
+            // readers pinned before the replacing epoch may hold the old block, as may those of every
+            // block retired after it
+            auto oldest = _readers.empty() ? latest : *_readers.begin();
+            while (!_retired.empty() && oldest >= _retired.front().first)
+            {
+                delete _retired.front().second;
+                _retired.pop_front();
+            }
+        }
+
+        // The prefix of a list visible at the epoch, entries are appended in epoch order.
+        template<typename T>
+        static inline void* const* _visible(_VersionedList const& list, Epoch epoch, size_t& size)
+        {
+            auto items = list.view(size);
+            if (epoch == latest)
+                return items;
+
+            size_t low = 0, high = size;
+            while (low < high)
+            {
+                auto mid = low + (high - low) / 2;
+                if (((T const*)items[mid])->store._epoch <= epoch)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            size = low;
+            return items;
+        }
+
+        template<typename T>
+        static inline SpanRange<T const*> _spanRange(_VersionedList const& list, Epoch epoch)
+        {
+            size_t size;
+            auto items = _visible<T>(list, epoch, size);
+            return SpanRange<T const*>(
+                SpanIterator<T const*>(items, size, nullptr, 0),
+                SpanIterator<T const*>(items, size, nullptr, size));
+        }
+    };
+}}
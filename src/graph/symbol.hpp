@@ -0,0 +1,160 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <limits>
+#include <ostream>
+#include <cstdint>
+
+namespace ugly
+{
+    // A dictionary of strings numbered in the order they were interned. Strings are stored once and
+    // never removed, so ids and string references stay valid for the life of the table. Safe to use
+    // from multiple threads.
+    class SymbolTable
+    {
+    public:
+        static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    protected:
+        mutable std::shared_mutex _lock;
+
+        // a deque keeps the strings in place, the map views them
+        std::deque<std::string> _strings;
+        std::unordered_map<std::string_view, uint32_t> _ids;
+
+    public:
+        inline SymbolTable()
+        {
+            // the empty string is id 0, the value of a default constructed symbol
+            intern(std::string_view());
+        }
+
+        SymbolTable(SymbolTable const&) = delete;
+        SymbolTable& operator=(SymbolTable const&) = delete;
+
+        // The table every `Symbol` is interned into.
+        static inline SymbolTable& global()
+        {
+            static SymbolTable table;
+            return table;
+        }
+
+        inline uint32_t intern(std::string_view string)
+        {
+            {
+                std::shared_lock<std::shared_mutex> lock(_lock);
+                auto it = _ids.find(string);
+                if (it != _ids.end())
+                    return it->second;
+            }
+
+            std::unique_lock<std::shared_mutex> lock(_lock);
+            auto it = _ids.find(string);
+            if (it != _ids.end())
+                return it->second;
+
+            auto id = (uint32_t)_strings.size();
+            _ids.emplace(_strings.emplace_back(string), id);
+            return id;
+        }
+
+        // `npos` if the string was never interned.
+        inline uint32_t find(std::string_view string) const
+        {
+            std::shared_lock<std::shared_mutex> lock(_lock);
+            auto it = _ids.find(string);
+            return it != _ids.end() ? it->second : npos;
+        }
+
+        inline std::string const& str(uint32_t id) const
+        {
+            std::shared_lock<std::shared_mutex> lock(_lock);
+            return _strings[id];
+        }
+
+        inline size_t size() const
+        {
+            std::shared_lock<std::shared_mutex> lock(_lock);
+            return _strings.size();
+        }
+    };
+
+    // An interned string, stored as its 32-bit id in the global `SymbolTable`. Symbols compare and
+    // hash by id; comparing against a plain string looks the string up without interning it, so
+    // hot loops should compare against a symbol made up front. Ids are only meaningful inside the
+    // process, binary snapshots write the strings.
+    class Symbol
+    {
+    protected:
+        uint32_t _id;
+
+        inline explicit Symbol(uint32_t id, int)
+            : _id(id)
+        { }
+
+    public:
+        inline Symbol()
+            : _id(0)
+        { }
+
+        inline Symbol(char const* string)
+            : _id(SymbolTable::global().intern(string))
+        { }
+        inline Symbol(std::string const& string)
+            : _id(SymbolTable::global().intern(string))
+        { }
+        inline Symbol(std::string_view string)
+            : _id(SymbolTable::global().intern(string))
+        { }
+
+        // The symbol of an id handed out by the global table.
+        static inline Symbol fromId(uint32_t id)
+        {
+            return Symbol(id, 0);
+        }
+
+        inline uint32_t id() const { return _id; }
+        inline std::string const& str() const { return SymbolTable::global().str(_id); }
+        inline bool empty() const { return _id == 0; }
+
+    public:
+        friend inline bool operator==(Symbol lhs, Symbol rhs) { return lhs._id == rhs._id; }
+        friend inline bool operator!=(Symbol lhs, Symbol rhs) { return lhs._id != rhs._id; }
+
+        friend inline bool operator==(Symbol lhs, std::string_view rhs) { return lhs._id == SymbolTable::global().find(rhs); }
+        friend inline bool operator!=(Symbol lhs, std::string_view rhs) { return !(lhs == rhs); }
+        friend inline bool operator==(Symbol lhs, std::string const& rhs) { return lhs == std::string_view(rhs); }
+        friend inline bool operator!=(Symbol lhs, std::string const& rhs) { return !(lhs == std::string_view(rhs)); }
+        friend inline bool operator==(Symbol lhs, char const* rhs) { return lhs == std::string_view(rhs); }
+        friend inline bool operator!=(Symbol lhs, char const* rhs) { return !(lhs == std::string_view(rhs)); }
+
+        // Orders by the strings, not the ids.
+        friend inline bool operator<(Symbol lhs, Symbol rhs) { return lhs._id != rhs._id && lhs.str() < rhs.str(); }
+        friend inline bool operator>(Symbol lhs, Symbol rhs) { return rhs < lhs; }
+        friend inline bool operator<=(Symbol lhs, Symbol rhs) { return !(rhs < lhs); }
+        friend inline bool operator>=(Symbol lhs, Symbol rhs) { return !(lhs < rhs); }
+
+        friend inline std::ostream& operator<<(std::ostream& out, Symbol symbol) { return out << symbol.str(); }
+    };
+}
+
+namespace std
+{
+    template<>
+    struct hash<ugly::Symbol>
+    {
+        inline size_t operator()(ugly::Symbol symbol) const
+        {
+            return (size_t)symbol.id() * 0x9e3779b97f4a7c15ull;
+        }
+    };
+}
@@ -5,6 +5,10 @@
 #pragma once
 
 #include <stdexcept>
+#include <iterator>
+#include <vector>
+#include <algorithm>
+
 #include "stdext/exception.h"
 #include "stdext/introspection.hpp"
 
@@ -37,6 +41,136 @@ namespace ugly
                 
     }
 
+    // Iterates a base iterator, casting each element to `T` (e.g. the `void*` relations in storage).
+    template<typename T, typename TBaseIterator>
+    class CastIterator
+    {
+        TBaseIterator _it;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T const*;
+        using reference = T;
+
+        inline CastIterator()
+            : _it()
+        { }
+        inline CastIterator(TBaseIterator it)
+            : _it(it)
+        { }
+
+        inline reference operator*() const { return (T)*_it; }
+
+        inline CastIterator& operator++()
+        {
+            ++_it;
+            return *this;
+        }
+        inline CastIterator operator++(int)
+        {
+            CastIterator res = *this;
+            ++_it;
+            return res;
+        }
+
+        inline bool operator==(CastIterator const& that) const { return _it == that._it; }
+        inline bool operator!=(CastIterator const& that) const { return _it != that._it; }
+    };
+
+    // A non-owning view over the relations of a graph object, valid until that object is modified.
+    template<typename TIterator>
+    class IteratorRange
+    {
+        TIterator _begin;
+        TIterator _end;
+
+    public:
+        using iterator = TIterator;
+
+        inline IteratorRange()
+            : _begin(), _end()
+        { }
+        inline IteratorRange(TIterator begin, TIterator end)
+            : _begin(begin), _end(end)
+        { }
+
+        inline TIterator begin() const { return _begin; }
+        inline TIterator end() const { return _end; }
+
+        inline bool empty() const { return _begin == _end; }
+        inline size_t size() const { return (size_t)std::distance(_begin, _end); }
+    };
+
+    template<typename T>
+    using PointerRange = IteratorRange<CastIterator<T, void* const*>>;
+
+    template<typename T>
+    inline PointerRange<T> pointerRange(void* const* begin, void* const* end)
+    {
+        return PointerRange<T>(begin, end);
+    }
+    template<typename T>
+    inline PointerRange<T> pointerRange(std::vector<void*> const& list)
+    {
+        return pointerRange<T>(list.data(), list.data() + list.size());
+    }
+
+    // Edge lists partitioned by role, the first `out_count` edges are outgoing, the rest incoming.
+    // Each partition keeps the order edges were added in, at the cost of moving the incoming edges
+    // when an outgoing one is added or removed.
+    namespace _detail
+    {
+        template<typename T, typename TCount>
+        inline void pushRoleSplit(std::vector<T>& edges, TCount& out_count, T edge, bool outgoing)
+        {
+            if (outgoing)
+                edges.insert(edges.begin() + out_count++, edge);
+            else
+                edges.push_back(edge);
+        }
+
+        // Removes one occurrence of an edge from the given partition.
+        template<typename T, typename TCount>
+        inline void eraseRoleSplit(std::vector<T>& edges, TCount& out_count, T edge, bool outgoing)
+        {
+            auto from = outgoing ? edges.begin() : edges.begin() + out_count;
+            auto to = outgoing ? edges.begin() + out_count : edges.end();
+            auto it = std::find(from, to, edge);
+            if (it == to)
+                return;
+
+            edges.erase(it);
+            if (outgoing)
+                --out_count;
+        }
+
+        // Moves one occurrence of an edge to the other partition, it becomes the last outgoing edge
+        // or the first incoming one.
+        template<typename T, typename TCount>
+        inline void flipRoleSplit(std::vector<T>& edges, TCount& out_count, T edge, bool to_outgoing)
+        {
+            auto split = edges.begin() + out_count;
+            auto from = to_outgoing ? split : edges.begin();
+            auto to = to_outgoing ? edges.end() : split;
+            auto it = std::find(from, to, edge);
+            if (it == to)
+                return;
+
+            if (to_outgoing)
+            {
+                std::rotate(split, it, it + 1);
+                ++out_count;
+            }
+            else
+            {
+                std::rotate(it, it + 1, split);
+                --out_count;
+            }
+        }
+    }
+
     enum class GraphKind : uint8_t
     {
         Unknown = 0,
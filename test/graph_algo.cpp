@@ -23,3 +23,27 @@ TEST_CASE( "ugly::findNode", "[ugly::findNode]" )
     CHECK(findNode(g, "test") != nullptr);
     CHECK(findNode(g, "not-test") == nullptr);
 }
+
+TEST_CASE( "ugly::findNode with a node data index", "[ugly::findNode]" )
+{
+    test_help::IndexedStrGraph g;
+
+    auto n = g.addNode("test");
+
+    CHECK(findNode(g, "test") == n);
+    CHECK(findNode(g, "not-test") == nullptr);
+
+    SECTION( "requireNode reuses indexed nodes" )
+    {
+        CHECK(requireNode(g, "test") == n);
+        auto other = requireNode(g, "other-test");
+        CHECK(findNode(g, "other-test") == other);
+        CHECK(g.nodeCount() == 2);
+    }
+
+    SECTION( "adding duplicate node data excepts" )
+    {
+        REQUIRE_THROWS_AS( g.addNode("test"), graph_error );
+        CHECK(g.nodeCount() == 1);
+    }
+}
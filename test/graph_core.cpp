@@ -8,6 +8,12 @@
 
 #include "shared.h"
 
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <set>
+
 using namespace ugly;
 using namespace Catch::Matchers;
 
@@ -251,6 +257,18 @@ TEST_CASE( "::ugly::model::PathPropertyGraph inspection", "[ugly::model::PathPro
         CHECK(found == false);
     }
 
+    SECTION( "ranges view relations in place" )
+    {
+        auto nodes = g.nodesInEdge(e0);
+        REQUIRE(nodes.size() == 2);
+        CHECK(*nodes.begin() == n0);
+
+        auto props = g.propsOnNode(n0);
+        CHECK(props.size() == 2);
+        CHECK(g.edgesOnNode(n2).empty());
+        CHECK(g.propsOnEdge(e0).size() == 1);
+    }
+
 
     REQUIRE(g.labelCount() == 1);
     REQUIRE(g.nodeCount() == 4);
@@ -260,6 +278,86 @@ TEST_CASE( "::ugly::model::PathPropertyGraph inspection", "[ugly::model::PathPro
 
 
 
+TEST_CASE( "::ugly::model::PathPropertyGraph edge roles", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph g;
+
+    auto n0 = g.addNode("node-0");
+    auto n1 = g.addNode("node-1");
+    auto n2 = g.addNode("node-2");
+
+    auto e0 = g.addEdge("edge", { n0, n1 });
+    auto e1 = g.addEdge("edge-1", { n2, n0 }, true);
+
+    CHECK(g.outEdgesOnNode(n0).size() == 2);
+    CHECK(g.inEdgesOnNode(n0).empty());
+    CHECK(g.edgesOnNode(n0).size() == 2);
+    CHECK(*g.inEdgesOnNode(n1).begin() == e0);
+    CHECK(*g.inEdgesOnNode(n2).begin() == e1);
+
+    CHECK(*g.sourceNodesInEdge(e0).begin() == n0);
+    CHECK(*g.targetNodesInEdge(e0).begin() == n1);
+    CHECK(*g.sourceNodesInEdge(e1).begin() == n0);
+    CHECK(*g.targetNodesInEdge(e1).begin() == n2);
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph edge order on nodes", "[ugly::model::PathPropertyGraph]" )
+{
+    // outgoing edges in the order they were added, then incoming edges in the order they were added
+    auto data = [](auto const& range)
+    {
+        std::vector<std::string> res;
+        for (auto e : range)
+            res.push_back(e->data);
+        return res;
+    };
+    auto check = [&](auto& g)
+    {
+        auto hub = g.addNode("hub");
+        auto a = g.addNode("a");
+        auto b = g.addNode("b");
+        g.addEdge("in-0", { a, hub });
+        g.addEdge("out-0", { hub, a });
+        g.addEdge("in-1", { b, hub });
+        g.addEdge("out-1", { hub, b });
+        g.addEdge("out-2", { hub, a });
+
+        CHECK_THAT(data(g.outEdgesOnNode(hub)), Equals(std::vector<std::string> { "out-0", "out-1", "out-2" }));
+        CHECK_THAT(data(g.inEdgesOnNode(hub)), Equals(std::vector<std::string> { "in-0", "in-1" }));
+        CHECK_THAT(data(g.edgesOnNode(hub)), Equals(std::vector<std::string> { "out-0", "out-1", "out-2", "in-0", "in-1" }));
+        return hub;
+    };
+
+    SECTION( "simple" ) { test_help::StrGraph g; check(g); }
+    SECTION( "handle" ) { test_help::HandleStrGraph g; check(g); }
+
+    SECTION( "removal keeps the order" )
+    {
+        test_help::StrGraph g;
+        auto hub = check(g);
+        g.removeEdge(*g.outEdgesOnNode(hub).begin());
+        g.removeEdge(*g.inEdgesOnNode(hub).begin());
+        CHECK_THAT(data(g.edgesOnNode(hub)), Equals(std::vector<std::string> { "out-1", "out-2", "in-1" }));
+    }
+
+    SECTION( "bulk loads give the same order" )
+    {
+        test_help::StrGraph g;
+        model::GraphBulkLoader<test_help::StrGraph> loader(g);
+        loader.addNode(0, "hub");
+        loader.addNode(1, "a");
+        loader.addNode(2, "b");
+        loader.addEdge("in-0", { 1, 0 });
+        loader.addEdge("out-0", { 0, 1 });
+        loader.addEdge("in-1", { 2, 0 });
+        loader.addEdge("out-1", { 0, 2 });
+        loader.addEdge("out-2", { 0, 1 });
+        loader.build();
+
+        CHECK_THAT(data(g.edgesOnNode(loader.resolve(0))), Equals(std::vector<std::string> { "out-0", "out-1", "out-2", "in-0", "in-1" }));
+    }
+}
+
 TEST_CASE( "::ugly::model::PathPropertyGraph updates", "[ugly::model::PathPropertyGraph]" )
 {
     test_help::StrGraph g;
@@ -291,6 +389,11 @@ TEST_CASE( "::ugly::model::PathPropertyGraph updates", "[ugly::model::PathProper
     SECTION( "attaching an edge to a node, inserted first" )
     {
         g.attachEdge(n3, e, 0);
+
+        // the old source becomes a target
+        CHECK(g.outEdgesOnNode(n0).empty());
+        CHECK(g.inEdgesOnNode(n0).size() == 1);
+        CHECK(g.outEdgesOnNode(n3).size() == 1);
     }
 
     SECTION( "attaching an edge to a node, inserted middle" )
@@ -312,4 +415,1139 @@ TEST_CASE( "::ugly::model::PathPropertyGraph updates", "[ugly::model::PathProper
     REQUIRE(g.nodeCount() == 4);
     REQUIRE(g.edgeCount() == 1);
     REQUIRE(g.propCount() == 0);
-}
\ No newline at end of file
+}
+TEST_CASE( "::ugly::model::PathPropertyGraph removal", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph g;
+
+    auto n0 = g.addNode("node-0");
+    auto n1 = g.addNode("node-1");
+    auto n2 = g.addNode("node-2");
+
+    auto e0 = g.addEdge("edge-0", { n0, n1 });
+    auto e1 = g.addEdge("edge-1", { n0, n1, n2 });
+
+    g.addProp("prop-0", n0);
+    g.addProp("prop-1", e0);
+
+    REQUIRE(g.nodeCount() == 3);
+    REQUIRE(g.edgeCount() == 2);
+    REQUIRE(g.propCount() == 2);
+
+    SECTION( "removing a prop detaches it" )
+    {
+        g.removeProp(g.addProp("prop-2", n1));
+
+        CHECK(g.propCount() == 2);
+        CHECK(g.propsOnNode(n1).empty());
+    }
+
+    SECTION( "removing an edge removes it from its nodes and removes its props" )
+    {
+        g.removeEdge(e0);
+
+        CHECK(g.edgeCount() == 1);
+        CHECK(g.propCount() == 1);
+        CHECK(g.outEdgesOnNode(n0).size() == 1);
+        CHECK(g.inEdgesOnNode(n1).size() == 1);
+    }
+
+    SECTION( "removing a node removes its edges and props" )
+    {
+        g.removeNode(n0);
+
+        CHECK(g.nodeCount() == 2);
+        CHECK(g.edgeCount() == 0);
+        CHECK(g.propCount() == 0);
+        CHECK(g.edgesOnNode(n1).empty());
+
+        size_t count = 0;
+        g.forAllNodes([&](auto n) { count++; });
+        CHECK(count == 2);
+    }
+
+    SECTION( "removing a node without destroying edges keeps larger edges" )
+    {
+        g.removeNode(n0, false);
+
+        CHECK(g.edgeCount() == 1);
+        CHECK(*g.sourceNodesInEdge(e1).begin() == n1);
+        CHECK(g.outEdgesOnNode(n1).size() == 1);
+        CHECK(g.inEdgesOnNode(n1).empty());
+    }
+
+    SECTION( "removed slots are reused" )
+    {
+        g.removeNode(n2, false);
+        auto n3 = g.addNode("node-3");
+
+        CHECK(n3 == n2);
+        CHECK(g.nodeCount() == 3);
+        CHECK(g.edgesOnNode(n3).empty());
+    }
+
+    SECTION( "compacting keeps the live graph" )
+    {
+        g.removeNode(n1, false);
+        g.compact();
+
+        CHECK(g.nodeCount() == 2);
+        CHECK(g.edgeCount() == 1);
+
+        std::vector<std::string> nodes;
+        g.forAllNodes([&](auto n)
+        {
+            g.forEdgesOnNode(n, [&](auto e)
+            {
+                g.forNodesInEdge(e, [&](auto en) { nodes.push_back(en->data); });
+            });
+        });
+        CHECK_THAT(nodes, Equals(std::vector<std::string> { "node-0", "node-2", "node-0", "node-2" }));
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph binary snapshots", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto thor = findNode(g, "thor");
+    auto sif = findNode(g, "sif");
+    g.addEdge("betrothed", { sif, thor }, true);
+    g.addProp("thunder", g.addEdge("wields", { thor, g.addNode("mjolnir") }));
+    auto god = g.addLabel("god");
+    g.attachLabel(thor, god);
+    g.attachLabel(findNode(g, "odin"), god);
+    g.setProp(thor, "weapon", "mjolnir");
+    g.setProp(findNode(g, "odin"), "eyes", "one");
+
+    std::stringstream image;
+    g.saveSnapshot(image);
+
+    SECTION( "loading restores the graph" )
+    {
+        test_help::StrGraph loaded;
+        loaded.loadSnapshot(image);
+
+        CHECK(loaded.nodeCount() == g.nodeCount());
+        CHECK(loaded.edgeCount() == g.edgeCount());
+        CHECK(loaded.propCount() == g.propCount());
+        CHECK(loaded.labelCount() == g.labelCount());
+
+        auto loaded_thor = findNode(loaded, "thor");
+        REQUIRE(loaded_thor != nullptr);
+        CHECK(loaded.outEdgesOnNode(loaded_thor).size() == g.outEdgesOnNode(thor).size());
+        CHECK(loaded.inEdgesOnNode(loaded_thor).size() == g.inEdgesOnNode(thor).size());
+
+        std::vector<std::string> props;
+        loaded.forEdgesOnNode(loaded_thor, [&](auto e)
+        {
+            if (e->data == "betrothed")
+                CHECK(loaded.isEdgeInverted(e));
+            loaded.forPropsOnEdge(e, [&](auto p) { props.push_back(p->data); });
+        });
+        CHECK_THAT(props, Equals(std::vector<std::string> { "thunder" }));
+
+        std::vector<std::string> audumbla;
+        loaded.forPropsOnNode(findNode(loaded, "audumbla"), [&](auto p) { audumbla.push_back(p->data); });
+        CHECK_THAT(audumbla, Equals(std::vector<std::string> { "animal", "cow" }));
+
+        std::set<std::string> gods;
+        loaded.forAllLabels([&](auto label)
+        {
+            CHECK(label->data == "god");
+            loaded.forNodesInLabel(label, [&](auto n) { gods.insert(n->data); });
+        });
+        CHECK(gods == std::set<std::string> { "odin", "thor" });
+
+        CHECK(*loaded.getProp(loaded_thor, "weapon") == "mjolnir");
+        CHECK(*loaded.getProp(findNode(loaded, "odin"), "eyes") == "one");
+        CHECK(loaded.nodeCountWithProp("weapon") == 1);
+    }
+
+    SECTION( "loading rejects broken snapshots" )
+    {
+        auto bytes = image.str();
+
+        test_help::StrGraph loaded;
+        std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+        CHECK_THROWS_AS(loaded.loadSnapshot(truncated), graph_error);
+
+        std::stringstream garbage("not a graph snapshot");
+        CHECK_THROWS_AS(loaded.loadSnapshot(garbage), graph_error);
+
+        CHECK(loaded.nodeCount() == 0);
+        CHECK(loaded.edgeCount() == 0);
+    }
+
+    SECTION( "loading requires an empty graph" )
+    {
+        test_help::StrGraph loaded;
+        loaded.addNode("odin");
+        CHECK_THROWS_AS(loaded.loadSnapshot(image), graph_error);
+        CHECK(loaded.nodeCount() == 1);
+    }
+}
+
+TEST_CASE( "::ugly::model::GraphWriteAheadLog replays additions on top of a snapshot", "[ugly::model::GraphWriteAheadLog]" )
+{
+    using Log = model::GraphWriteAheadLog<test_help::StrGraph>;
+
+    auto path = (std::filesystem::temp_directory_path() / "ugly-write-ahead-log-test.wal").string();
+    std::filesystem::remove(path);
+
+    test_help::StrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    std::stringstream image;
+    g.saveSnapshot(image);
+
+    {
+        Log log(g, path);
+
+        auto thor = const_cast<test_help::StrGraph::Node*>(findNode(g, "thor"));
+        auto loki = log.addNode("loki");
+        auto e = log.addEdge("friends", { thor, loki });
+        log.addProp("trickster", loki);
+        log.addProp("uneasy", e);
+        log.attachEdge(log.addNode("sleipnir"), e);
+        log.attachLabel(loki, log.addLabel("jotunn"));
+        log.setProp(loki, "mischief", "high");
+        log.setProp(thor, "weapon", "mjolnir");
+        CHECK(log.removeProp(loki, "mischief"));
+        CHECK_FALSE(log.removeProp(loki, "mischief"));
+
+        CHECK_THROWS_AS(log.addEdge("strangers", { loki, g.addNode("unlogged") }), graph_error);
+
+        log.sync();
+        CHECK(log.durableCount() == log.loggedCount());
+        CHECK(log.loggedCount() == 11);
+    }
+
+    auto restore = [&](test_help::StrGraph& restored)
+    {
+        image.seekg(0);
+        restored.loadSnapshot(image);
+        return Log::replay(restored, path);
+    };
+
+    SECTION( "replaying restores the graph" )
+    {
+        test_help::StrGraph restored;
+        CHECK(restore(restored) == 11);
+
+        CHECK(restored.nodeCount() == g.nodeCount() - 1);
+        CHECK(restored.edgeCount() == g.edgeCount());
+        CHECK(restored.propCount() == g.propCount());
+
+        auto loki = findNode(restored, "loki");
+        REQUIRE(loki != nullptr);
+        auto e = *restored.edgesOnNode(loki).begin();
+        CHECK(e->data == "friends");
+        CHECK((*restored.sourceNodesInEdge(e).begin())->data == "thor");
+        CHECK(restored.nodesInEdge(e).size() == 3);
+        CHECK((*restored.propsOnEdge(e).begin())->data == "uneasy");
+
+        CHECK(*restored.getProp(findNode(restored, "thor"), "weapon") == "mjolnir");
+        CHECK(restored.getProp(loki, "mischief") == nullptr);
+    }
+
+    SECTION( "a torn record at the end is dropped" )
+    {
+        {
+            std::ofstream torn(path, std::ios::binary | std::ios::app);
+            torn.write("\x20\0\0\0garbage", 11);
+        }
+
+        test_help::StrGraph restored;
+        CHECK(restore(restored) == 11);
+        CHECK(findNode(restored, "sleipnir") != nullptr);
+
+        // the torn bytes were cut, the log can be appended to again
+        {
+            Log log(restored, path);
+            log.addNode("hati");
+        }
+
+        test_help::StrGraph again;
+        CHECK(restore(again) == 12);
+        CHECK(findNode(again, "hati") != nullptr);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE( "::ugly::Bitmap stores sets of values compressed", "[ugly::Bitmap]" )
+{
+    Bitmap evens, thirds;
+    for (uint32_t i = 0; i < 200000; i += 2)
+        evens.add(i);
+    for (uint32_t i = 0; i < 200000; i += 3)
+        thirds.add(i);
+    thirds.add(0xFFFFFFFFu);
+
+    CHECK(evens.cardinality() == 100000);
+    CHECK(evens.contains(65536));
+    CHECK_FALSE(evens.contains(65537));
+    CHECK_FALSE(evens.add(4));
+    CHECK(evens.remove(4));
+    CHECK_FALSE(evens.contains(4));
+    CHECK(evens.add(4));
+
+    auto sixths = evens & thirds;
+    CHECK(sixths.cardinality() == 33334);
+    CHECK(std::all_of(sixths.begin(), sixths.end(), [](uint32_t v) { return v % 6 == 0; }));
+
+    auto either = evens | thirds;
+    CHECK(either.cardinality() == 100000 + 66667 - 33334 + 1);
+    CHECK(either.contains(0xFFFFFFFFu));
+
+    // iteration is ordered across array and bitset containers
+    Bitmap sparse;
+    for (uint32_t v : { 70000u, 3u, 1u << 20, 5u })
+        sparse.add(v);
+    CHECK_THAT(std::vector<uint32_t>(sparse.begin(), sparse.end()), Equals(std::vector<uint32_t> { 3, 5, 70000, 1u << 20 }));
+
+    // removing values turns dense containers back into arrays
+    for (uint32_t i = 0; i < 65536; i += 2)
+        evens.remove(i);
+    CHECK(evens.cardinality() == 100000 - 32768);
+    CHECK_FALSE(evens.contains(2));
+    CHECK(evens.contains(65536));
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph label membership", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto aesir = g.addLabel("aesir");
+    auto vanir = g.addLabel("vanir");
+    auto jotnar = g.addLabel("jotnar");
+
+    auto node = [&](char const* name) { return findNode(g, name); };
+    for (auto name : { "odin", "thor", "baldr", "frigg" })
+        g.attachLabel(node(name), aesir);
+    for (auto name : { "njord", "frigg" })
+        g.attachLabel(node(name), vanir);
+    for (auto name : { "skadi", "thor" })
+        g.attachLabel(node(name), jotnar);
+    g.attachLabel(node("thor"), aesir);
+
+    auto names = [&](auto visit)
+    {
+        std::vector<std::string> res;
+        visit([&](auto n) { res.push_back(n->data); });
+        std::sort(res.begin(), res.end());
+        return res;
+    };
+
+    SECTION( "nodes in a label are visited once" )
+    {
+        CHECK(g.nodeCountInLabel(aesir) == 4);
+        CHECK(g.nodesInLabel(aesir).size() == 4);
+        CHECK_THAT(names([&](auto f) { g.forNodesInLabel(vanir, f); }), Equals(std::vector<std::string> { "frigg", "njord" }));
+    }
+
+    SECTION( "labels intersect and unite" )
+    {
+        CHECK_THAT(names([&](auto f) { g.forNodesInAllLabels({ aesir, vanir }, f); }), Equals(std::vector<std::string> { "frigg" }));
+        CHECK_THAT(names([&](auto f) { g.forNodesInAllLabels({ aesir, jotnar }, f); }), Equals(std::vector<std::string> { "thor" }));
+        CHECK(names([&](auto f) { g.forNodesInAllLabels({ vanir, jotnar }, f); }).empty());
+        CHECK_THAT(names([&](auto f) { g.forNodesInAnyLabel({ vanir, jotnar }, f); }), Equals(std::vector<std::string> { "frigg", "njord", "skadi", "thor" }));
+    }
+
+    SECTION( "queries start from a label" )
+    {
+        auto r = query(&g)
+            .v(jotnar)
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .run();
+
+        CHECK(r.size() == 2);
+    }
+
+    SECTION( "removed nodes leave their labels, compaction keeps the members" )
+    {
+        g.removeNode(node("baldr"));
+        CHECK(g.nodeCountInLabel(aesir) == 3);
+
+        auto sleipnir = g.addNode("sleipnir");
+        CHECK(g.nodeCountInLabel(aesir) == 3);
+        g.attachLabel(sleipnir, vanir);
+
+        g.removeNode(node("audumbla"));
+        g.compact();
+
+        CHECK_THAT(names([&](auto f) { g.forNodesInLabel(aesir, f); }), Equals(std::vector<std::string> { "frigg", "odin", "thor" }));
+        CHECK_THAT(names([&](auto f) { g.forNodesInLabel(vanir, f); }), Equals(std::vector<std::string> { "frigg", "njord", "sleipnir" }));
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph keyed props", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph g;
+
+    std::vector<test_help::StrGraph::Node*> nodes;
+    for (int i = 0; i < 400; ++i)
+    {
+        auto node = g.addNode("node-" + std::to_string(i));
+        nodes.push_back(node);
+
+        g.setProp(node, "parity", i % 2 == 0 ? "even" : "odd");
+        if (i % 100 == 0)
+            g.setProp(node, "hundred", std::to_string(i / 100));
+    }
+
+    SECTION( "values are found by key" )
+    {
+        CHECK(*g.getProp(nodes[7], "parity") == "odd");
+        CHECK(*g.getProp(nodes[300], "hundred") == "3");
+        CHECK(g.getProp(nodes[301], "hundred") == nullptr);
+        CHECK(g.getProp(nodes[1], "missing") == nullptr);
+        CHECK(g.findPropKey("missing") == test_help::StrGraph::noPropKey);
+
+        CHECK(g.nodeCountWithProp("parity") == 400);
+        CHECK(g.nodeCountWithProp("hundred") == 4);
+
+        // keyed props do not show up as props on the node
+        CHECK(g.propsOnNode(nodes[0]).empty());
+    }
+
+    SECTION( "setting a key again replaces its value" )
+    {
+        g.setProp(nodes[7], "parity", "seven");
+        CHECK(*g.getProp(nodes[7], "parity") == "seven");
+        CHECK(g.nodeCountWithProp("parity") == 400);
+
+        CHECK(g.removeProp(nodes[7], "parity"));
+        CHECK_FALSE(g.removeProp(nodes[7], "parity"));
+        CHECK(g.getProp(nodes[7], "parity") == nullptr);
+        CHECK(g.nodeCountWithProp("parity") == 399);
+    }
+
+    SECTION( "nodes with a key are visited without scanning the rest" )
+    {
+        std::vector<std::string> names;
+        g.forNodesWithProp("hundred", [&](auto node, auto const& value) { names.push_back(node->data + "=" + value); });
+        std::sort(names.begin(), names.end());
+        CHECK_THAT(names, Equals(std::vector<std::string> { "node-0=0", "node-100=1", "node-200=2", "node-300=3" }));
+    }
+
+    SECTION( "queries filter on keyed props" )
+    {
+        auto r = query(&g)
+            .v(nodes[0])
+            .filter(filter::byProp("parity", "even"))
+            .run();
+        CHECK(r.size() == 1);
+
+        auto hundreds = query(&g)
+            .v(nodes[100])
+            .filter(filter::hasProp("hundred"))
+            .filter(filter::byProp("parity", "odd"))
+            .run();
+        CHECK(hundreds.empty());
+    }
+
+    SECTION( "removed nodes drop their keyed props and compaction keeps the rest" )
+    {
+        for (int i = 0; i < 400; i += 3)
+            g.removeNode(nodes[i]);
+
+        auto reused = g.addNode("reused");
+        CHECK(g.getProp(reused, "parity") == nullptr);
+        CHECK(g.nodeCountWithProp("hundred") == 2);
+
+        g.compact();
+
+        CHECK(g.nodeCountWithProp("parity") == 266);
+        CHECK(*g.getProp(findNode(g, "node-7"), "parity") == "odd");
+        CHECK(*g.getProp(findNode(g, "node-200"), "hundred") == "2");
+        CHECK(g.getProp(findNode(g, "reused"), "parity") == nullptr);
+    }
+}
+
+TEST_CASE( "::ugly::Symbol interns strings", "[ugly::Symbol]" )
+{
+    Symbol parents("parents");
+    Symbol again(std::string("parents"));
+
+    CHECK(parents == again);
+    CHECK(parents.id() == again.id());
+    CHECK(parents.str() == "parents");
+    CHECK(parents == "parents");
+    CHECK(parents != std::string("married"));
+    CHECK(Symbol().empty());
+    CHECK(Symbol("").id() == Symbol().id());
+
+    // comparing to a string does not intern it
+    auto size = SymbolTable::global().size();
+    CHECK_FALSE(parents == "never-interned-anywhere");
+    CHECK(SymbolTable::global().size() == size);
+
+    CHECK(Symbol("apple") < Symbol("banana"));
+    CHECK_FALSE(Symbol("banana") < Symbol("apple"));
+    CHECK(Symbol::fromId(parents.id()) == parents);
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph with interned data", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::SymbolGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto thor = findNode(g, "thor");
+    REQUIRE(thor != nullptr);
+
+    SECTION( "value filters compare symbols" )
+    {
+        auto r = query(&g)
+            .v(thor)
+            .out(filter::byValue("parents"))
+            .run();
+
+        std::vector<std::string> names;
+        for (auto n : r)
+            names.push_back(n->data.str());
+        std::sort(names.begin(), names.end());
+        CHECK_THAT(names, Equals(std::vector<std::string> { "jord", "odin" }));
+    }
+
+    SECTION( "repeated edge data is stored once" )
+    {
+        auto size = SymbolTable::global().size();
+        auto a = g.addNode("sleipnir");
+        auto b = g.addNode("loki");
+        for (int i = 0; i < 100; ++i)
+            g.addEdge("parents", { a, b });
+
+        CHECK(SymbolTable::global().size() <= size + 2);
+        CHECK(g.edgesOnNode(a).begin() != g.edgesOnNode(a).end());
+    }
+
+    SECTION( "binary snapshots write the strings" )
+    {
+        std::stringstream buffer;
+        g.saveSnapshot(buffer);
+
+        test_help::SymbolGraph loaded;
+        loaded.loadSnapshot(buffer);
+
+        CHECK(loaded.nodeCount() == g.nodeCount());
+        CHECK(loaded.edgeCount() == g.edgeCount());
+        CHECK(findNode(loaded, "audumbla") != nullptr);
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph prop value index", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::PropIndexedStrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto names = [&](auto visit)
+    {
+        std::vector<std::string> res;
+        visit([&](auto n, auto const& value) { res.push_back(n->data); });
+        return res;
+    };
+
+    for (auto name : { "thor", "odin", "freyr" })
+        g.addProp("god", const_cast<test_help::PropIndexedStrGraph::Node*>(findNode(g, name)));
+    g.addProp("goddess", const_cast<test_help::PropIndexedStrGraph::Node*>(findNode(g, "frigg")));
+
+    int age = 100;
+    g.forAllNodes([&](auto n)
+    {
+        g.setProp(n, "status", n->data < "m" ? "asleep" : "awake");
+        g.setProp(n, "age", std::to_string(age++));
+    });
+
+    SECTION( "props on nodes are found by value" )
+    {
+        auto animals = names([&](auto f) { g.forNodesWithPropValue("animal", f); });
+        CHECK_THAT(animals, Equals(std::vector<std::string> { "audumbla" }));
+
+        auto gods = names([&](auto f) { g.forNodesWithPropValue("god", f); });
+        std::sort(gods.begin(), gods.end());
+        CHECK_THAT(gods, Equals(std::vector<std::string> { "freyr", "odin", "thor" }));
+
+        CHECK(names([&](auto f) { g.forNodesWithPropPrefix("god", f); }).size() == 4);
+        CHECK(names([&](auto f) { g.forNodesWithPropInRange("a", "d", f); }).size() == 2);
+    }
+
+    SECTION( "keyed props are found by value, range, and prefix" )
+    {
+        auto asleep = names([&](auto f) { g.forNodesWithPropValue("status", "asleep", f); });
+        CHECK(asleep.size() == (size_t)std::count_if(asleep.begin(), asleep.end(), [](auto& n) { return n < "m"; }));
+        CHECK(asleep.size() + names([&](auto f) { g.forNodesWithPropValue("status", "awake", f); }).size() == g.nodeCount());
+
+        auto young = names([&](auto f) { g.forNodesWithPropInRange("age", "100", "103", f); });
+        CHECK(young.size() == 3);
+
+        CHECK(names([&](auto f) { g.forNodesWithPropPrefix("age", "10", f); }).size() == 10);
+        CHECK(names([&](auto f) { g.forNodesWithPropValue("missing", "x", f); }).empty());
+    }
+
+    SECTION( "the index follows updates, removal, and compaction" )
+    {
+        auto thor = findNode(g, "thor");
+        g.setProp(thor, "status", "thundering");
+        CHECK_THAT(names([&](auto f) { g.forNodesWithPropValue("status", "thundering", f); }), Equals(std::vector<std::string> { "thor" }));
+        CHECK(names([&](auto f) { g.forNodesWithPropValue("status", "awake", f); }).size() == 15);
+
+        g.removeNode(findNode(g, "odin"));
+        g.removeProp(findNode(g, "freyr"), "status");
+        CHECK(names([&](auto f) { g.forNodesWithPropValue("god", f); }).size() == 2);
+        CHECK(names([&](auto f) { g.forNodesWithPropValue("status", "awake", f); }).size() == 14);
+
+        g.compact();
+        CHECK(names([&](auto f) { g.forNodesWithPropValue("god", f); }).size() == 2);
+        CHECK_THAT(names([&](auto f) { g.forNodesWithPropValue("status", "thundering", f); }), Equals(std::vector<std::string> { "thor" }));
+        CHECK(names([&](auto f) { g.forNodesWithPropValue("status", "awake", f); }).size() == 14);
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph edge iteration and the edge data index", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph scanned;
+    test_help::EdgeIndexedStrGraph indexed;
+    test_help::fillStrGraphWithNorse(scanned);
+    test_help::fillStrGraphWithNorse(indexed);
+
+    auto count = [](auto& g, auto data)
+    {
+        size_t res = 0;
+        g.forEdgesWithData(data, [&](auto e) { CHECK(e->data == data); ++res; });
+        return res;
+    };
+
+    SECTION( "every edge is visited once" )
+    {
+        std::set<test_help::StrGraph::Edge const*> edges;
+        scanned.forAllEdges([&](auto e) { edges.insert(e); });
+        CHECK(edges.size() == scanned.edgeCount());
+    }
+
+    SECTION( "edges are found by data with and without the index" )
+    {
+        CHECK(count(scanned, "married") == 6);
+        CHECK(count(indexed, "married") == 6);
+        CHECK(indexed.edgesWithData("married").size() == 6);
+        CHECK(count(indexed, "parents") == count(scanned, "parents"));
+        CHECK(indexed.edgesWithData("not-an-edge").empty());
+    }
+
+    SECTION( "the index follows removal and compaction" )
+    {
+        indexed.removeNode(findNode(indexed, "odin"));
+        scanned.removeNode(findNode(scanned, "odin"));
+        CHECK(count(indexed, "married") == 5);
+        CHECK(count(indexed, "parents") == count(scanned, "parents"));
+
+        indexed.compact();
+        CHECK(count(indexed, "married") == 5);
+        CHECK(indexed.edgesWithData("parents").size() == count(scanned, "parents"));
+    }
+
+    SECTION( "removing edges swaps them out of their data's list" )
+    {
+        auto parents = count(indexed, "parents");
+        std::vector<test_help::EdgeIndexedStrGraph::Edge const*> married;
+        indexed.forEdgesWithData("married", [&](auto e) { married.push_back(e); });
+
+        // from the front, so every removal moves the last edge into its place
+        for (size_t i = 0; i < married.size(); ++i)
+        {
+            indexed.removeEdge(married[i]);
+            CHECK(count(indexed, "married") == married.size() - i - 1);
+        }
+        CHECK(indexed.edgesWithData("married").empty());
+        CHECK(count(indexed, "parents") == parents);
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph memory stats", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::IndexedStrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto stats = g.memoryStats();
+
+    SECTION( "stores match the counts" )
+    {
+        CHECK(stats.nodes.count == g.nodeCount());
+        CHECK(stats.nodes.slots == g.nodeCount());
+        CHECK(stats.edges.count == g.edgeCount());
+        CHECK(stats.props.count == g.propCount());
+        CHECK(stats.labels.count == g.labelCount());
+        CHECK(stats.nodes.elementBytes == sizeof(test_help::IndexedStrGraph::Node));
+        CHECK(stats.nodes.bytes >= stats.nodes.slots * stats.nodes.elementBytes);
+    }
+
+    SECTION( "adjacency, indexes, and degree are accounted" )
+    {
+        CHECK(stats.adjacencyBytes > 0);
+        CHECK(stats.indexBytes > 0);
+        CHECK(stats.reservedBytes == 0);
+        CHECK(stats.totalBytes() > stats.storeBytes());
+
+        size_t degrees = 0, max_degree = 0;
+        g.forAllNodes([&](auto n)
+        {
+            degrees += g.edgesOnNode(n).size();
+            max_degree = std::max(max_degree, (size_t)g.edgesOnNode(n).size());
+        });
+        CHECK(stats.maxDegree == max_degree);
+        CHECK(stats.averageDegree == Catch::Detail::Approx((double)degrees / g.nodeCount()));
+    }
+
+    SECTION( "removed slots are counted until compaction" )
+    {
+        g.removeNode(findNode(g, "odin"));
+
+        auto removed = g.memoryStats();
+        CHECK(removed.nodes.count == g.nodeCount());
+        CHECK(removed.nodes.slots == g.nodeCount() + 1);
+
+        g.compact();
+
+        auto compacted = g.memoryStats();
+        CHECK(compacted.nodes.slots == g.nodeCount());
+        CHECK(compacted.maxDegree <= stats.maxDegree);
+    }
+
+    SECTION( "long strings are counted as data" )
+    {
+        auto before = stats.dataBytes;
+        g.addNode(std::string(200, 'x'));
+        CHECK(g.memoryStats().dataBytes >= before + 200);
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph node reordering", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::EdgeIndexedStrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto aesir = g.addLabel("aesir");
+    for (auto name : { "odin", "thor", "frigg" })
+        g.attachLabel(findNode(g, name), aesir);
+    g.setProp(findNode(g, "thor"), "weapon", "mjolnir");
+    g.removeNode(findNode(g, "tyr"));
+
+    // everything reachable from a node's data, to compare the graph across reorders
+    auto describe = [&]()
+    {
+        std::set<std::string> res;
+        g.forAllNodes([&](auto n)
+        {
+            g.forPropsOnNode(n, [&](auto p) { res.insert(n->data + " prop " + p->data); });
+            g.forEdgesOnNode(n, [&](auto e)
+            {
+                std::string nodes;
+                g.forNodesInEdge(e, [&](auto o) { nodes += " " + o->data; });
+                res.insert(n->data + " " + e->data + nodes);
+                g.forPropsOnEdge(e, [&](auto p) { res.insert(n->data + " " + e->data + " prop " + p->data); });
+            });
+        });
+        g.forNodesInLabel(aesir, [&](auto n) { res.insert("aesir " + n->data); });
+        return res;
+    };
+    auto before = describe();
+    auto node_count = g.nodeCount();
+    auto edge_count = g.edgeCount();
+
+    auto check_unchanged = [&]()
+    {
+        CHECK(g.nodeCount() == node_count);
+        CHECK(g.edgeCount() == edge_count);
+        CHECK(g.memoryStats().nodes.slots == node_count);
+        CHECK(describe() == before);
+        CHECK(*g.getProp(findNode(g, "thor"), "weapon") == "mjolnir");
+        CHECK(g.edgesWithData("married").size() == 6);
+    };
+
+    SECTION( "breadth first puts neighbors next to each other" )
+    {
+        auto first = *g.storage().allNodesBegin<test_help::EdgeIndexedStrGraph::Node>();
+        std::set<std::string> neighbors;
+        g.forEdgesOnNode(&first, [&](auto e) { g.forNodesInEdge(e, [&](auto n) { neighbors.insert(n->data); }); });
+        neighbors.erase(first.data);
+
+        g.reorder(model::NodeOrder::BreadthFirst);
+        check_unchanged();
+
+        std::vector<std::string> order;
+        g.forAllNodes([&](auto n) { order.push_back(n->data); });
+        REQUIRE(order.size() > neighbors.size());
+        CHECK(order[0] == first.data);
+        CHECK(std::set<std::string>(order.begin() + 1, order.begin() + 1 + neighbors.size()) == neighbors);
+    }
+
+    SECTION( "degree descending puts hubs first" )
+    {
+        g.reorder(model::NodeOrder::DegreeDescending);
+        check_unchanged();
+
+        std::vector<size_t> degrees;
+        g.forAllNodes([&](auto n) { degrees.push_back(g.edgesOnNode(n).size()); });
+        CHECK(std::is_sorted(degrees.rbegin(), degrees.rend()));
+    }
+
+    SECTION( "reverse Cuthill-McKee keeps the graph" )
+    {
+        g.reorder(model::NodeOrder::ReverseCuthillMcKee);
+        check_unchanged();
+
+        g.reorder(model::NodeOrder::BreadthFirst);
+        check_unchanged();
+    }
+}
+
+TEST_CASE( "::ugly::model::PathPropertyGraph paths", "[ugly::model::PathPropertyGraph]" )
+{
+    test_help::StrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto thor = findNode(g, "thor");
+    auto odin = findNode(g, "odin");
+    auto burr = findNode(g, "burr");
+    auto edge_between = [&](auto a, auto b)
+    {
+        test_help::StrGraph::Edge const* res = nullptr;
+        g.forEdgesOnNode(a, [&](auto e) { if (g.indexOfNodeInEdge(b, e) != -1) res = e; });
+        return res;
+    };
+
+    auto path = g.addPath("lineage", { thor, odin, burr }, { edge_between(thor, odin), edge_between(odin, burr) });
+    REQUIRE(g.pathCount() == 1);
+
+    auto describe = [&](auto path)
+    {
+        std::string res;
+        g.forNodesInPath(path, [&](auto n) { res += " " + n->data; });
+        g.forEdgesInPath(path, [&](auto e) { res += " " + e->data; });
+        return res;
+    };
+    CHECK(describe(path) == " thor odin burr parents parents");
+
+    SECTION( "paths must be connected" )
+    {
+        CHECK_THROWS_AS(g.addPath("bad", { }, { }), graph_error);
+        CHECK_THROWS_AS(g.addPath("bad", { thor, odin }, { }), graph_error);
+        CHECK_THROWS_AS(g.addPath("bad", { thor, burr }, { edge_between(thor, odin) }), graph_error);
+        CHECK(g.pathCount() == 1);
+        CHECK(g.addPath("single", { thor }, { }) != nullptr);
+    }
+
+    SECTION( "removing what a path visits removes the path" )
+    {
+        g.addPath("other", { thor }, { });
+        g.removeEdge(edge_between(odin, burr));
+        CHECK(g.pathCount() == 1);
+
+        size_t visited = 0;
+        g.forAllPaths([&](auto p) { visited += 1; CHECK(p->data == "other"); });
+        CHECK(visited == 1);
+
+        // listed once under thor, though it visits thor twice
+        auto thor_odin = edge_between(thor, odin);
+        g.addPath("round trip", { thor, odin, thor }, { thor_odin, thor_odin });
+        CHECK(g.pathCount() == 2);
+
+        g.removeNode(thor);
+        CHECK(g.pathCount() == 0);
+    }
+
+    SECTION( "compaction keeps paths" )
+    {
+        g.removeNode(findNode(g, "tyr"));
+        g.compact();
+
+        CHECK(g.pathCount() == 1);
+        CHECK(describe(path) == " thor odin burr parents parents");
+        CHECK(*g.nodesInPath(path).begin() == findNode(g, "thor"));
+
+        g.reorder(model::NodeOrder::DegreeDescending);
+        CHECK(describe(path) == " thor odin burr parents parents");
+
+        // the paths are indexed under the moved nodes
+        g.removeNode(findNode(g, "burr"));
+        CHECK(g.pathCount() == 0);
+    }
+}
+
+TEST_CASE( "::ugly::model::GraphBulkLoader builds batches", "[ugly::model::GraphBulkLoader]" )
+{
+    // everything reachable from a node's data, to compare loaded graphs with added ones
+    auto describe = [](auto& g)
+    {
+        std::set<std::string> res;
+        g.forAllNodes([&](auto n)
+        {
+            g.forPropsOnNode(n, [&](auto p) { res.insert(n->data + " prop " + p->data); });
+            for (auto e : g.outEdgesOnNode(n))
+            {
+                std::string nodes;
+                g.forNodesInEdge(e, [&](auto o) { nodes += " " + o->data; });
+                res.insert(n->data + " out " + e->data + nodes);
+                g.forPropsOnEdge(e, [&](auto p) { res.insert(n->data + " " + e->data + " prop " + p->data); });
+            }
+            for (auto e : g.inEdgesOnNode(n))
+                res.insert(n->data + " in " + e->data);
+        });
+        return res;
+    };
+
+    // a star around odin, one edge inverted, and a hyperedge
+    auto fill = [](auto& g)
+    {
+        auto odin = g.addNode("odin");
+        g.addProp("allfather", odin);
+        for (auto name : { "thor", "baldr", "vidar", "vali" })
+            g.addEdge("parents", { g.addNode(name), odin });
+        auto frigg = g.addNode("frigg");
+        g.addEdge("married", { frigg, odin }, true);
+        g.addProp("wed", g.addEdge("creator", { g.addNode("ask"), odin, frigg }));
+    };
+
+    auto load = [](auto& loader)
+    {
+        loader.addNode(0, "odin");
+        loader.addNodeProp(0, "allfather");
+        std::vector<std::string> names = { "thor", "baldr", "vidar", "vali" };
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            loader.addNode(i + 1, names[i]);
+            loader.addEdge("parents", { i + 1, 0 });
+        }
+        loader.addNode(10, "frigg");
+        loader.addEdge("married", { 10, 0 }, true);
+        loader.addNode(11, "ask");
+        loader.addEdgeProp(loader.addEdge("creator", { 11, 0, 10 }), "wed");
+    };
+
+    SECTION( "a loaded graph matches an added one" )
+    {
+        test_help::StrGraph added;
+        fill(added);
+
+        test_help::StrGraph g;
+        model::GraphBulkLoader<test_help::StrGraph> loader(g);
+        load(loader);
+        REQUIRE(g.nodeCount() == 0);
+
+        loader.build();
+        CHECK(loader.empty());
+        CHECK(g.nodeCount() == added.nodeCount());
+        CHECK(g.edgeCount() == added.edgeCount());
+        CHECK(g.propCount() == added.propCount());
+        CHECK(describe(g) == describe(added));
+        CHECK(loader.resolve(0)->data == "odin");
+        CHECK(loader.resolve(42) == nullptr);
+    }
+
+    SECTION( "node edge lists are allocated exactly" )
+    {
+        test_help::StrGraph added;
+        auto hub = added.addNode("odin");
+        for (auto name : { "thor", "baldr", "vidar", "vali", "hodr" })
+            added.addEdge("parents", { added.addNode(name), hub });
+        CHECK(added.memoryStats().adjacencySlackBytes > 0);
+
+        test_help::StrGraph g;
+        model::GraphBulkLoader<test_help::StrGraph> loader(g);
+        loader.addNode(0, "odin");
+        for (uint64_t i = 1; i <= 5; ++i)
+        {
+            loader.addNode(i, "child");
+            loader.addEdge("parents", { i, 0 });
+        }
+        loader.build();
+        CHECK(g.memoryStats().adjacencySlackBytes == 0);
+
+        // a later batch appends to the lists, still exactly
+        loader.addNode(6, "hodr");
+        loader.addEdge("parents", { 6, 0 });
+        loader.build();
+        CHECK(g.memoryStats().adjacencySlackBytes == 0);
+        CHECK(g.edgesOnNode(loader.resolve(0)).size() == 6);
+        CHECK(g.inEdgesOnNode(loader.resolve(0)).size() == 6);
+    }
+
+    SECTION( "duplicate nodes are resolved" )
+    {
+        test_help::EdgeIndexedStrGraph g;
+        auto odin = g.addNode("odin");
+
+        model::GraphBulkLoader<test_help::EdgeIndexedStrGraph> loader(g);
+        loader.addNode(0, "odin");
+        loader.addNode(1, "thor");
+        loader.addNode(1, "ignored");
+        loader.addNode(2, "thor");
+        loader.addEdge("parents", { 1, 0 });
+        loader.addEdge("parents", { 2, 0 });
+        loader.build();
+
+        CHECK(g.nodeCount() == 2);
+        CHECK(loader.resolve(0) == odin);
+        CHECK(loader.resolve(1) == loader.resolve(2));
+        CHECK(g.edgesWithData("parents").size() == 2);
+        CHECK(g.inEdgesOnNode(odin).size() == 2);
+        CHECK(g.outEdgesOnNode(loader.resolve(1)).size() == 2);
+    }
+
+    SECTION( "storages without bulk adjacency add edges one by one" )
+    {
+        test_help::HandleStrGraph added;
+        fill(added);
+
+        test_help::HandleStrGraph g;
+        model::GraphBulkLoader<test_help::HandleStrGraph> loader(g);
+        load(loader);
+        loader.build();
+        CHECK(describe(g) == describe(added));
+    }
+
+    SECTION( "parallel builds match a single threaded one" )
+    {
+        // a ring with chords, every node gets a mix of outgoing and incoming edges
+        auto load_ring = [](auto& loader)
+        {
+            const uint64_t n = 200;
+            for (uint64_t i = 0; i < n; ++i)
+                loader.addNode(i, "n" + std::to_string(i));
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                loader.addEdge("next", { i, (i + 1) % n });
+                loader.addEdge("chord", { i, (i * 7) % n, (i * 13) % n }, i % 3 == 0);
+                loader.addNodeProp(i, "p" + std::to_string(i % 5));
+            }
+        };
+        auto edge_lists = [](auto& g)
+        {
+            std::vector<std::vector<std::string>> res;
+            g.forAllNodes([&](auto n)
+            {
+                res.emplace_back();
+                for (auto e : g.edgesOnNode(n))
+                {
+                    std::string nodes = e->data;
+                    g.forNodesInEdge(e, [&](auto o) { nodes += " " + o->data; });
+                    res.back().push_back(nodes);
+                }
+            });
+            return res;
+        };
+
+        test_help::StrGraph serial;
+        model::GraphBulkLoader<test_help::StrGraph> serial_loader(serial);
+        load_ring(serial_loader);
+        serial_loader.build();
+
+        for (size_t threads : { 2, 4, 7 })
+        {
+            test_help::StrGraph g;
+            model::GraphBulkLoader<test_help::StrGraph> loader(g);
+            load_ring(loader);
+            loader.build(threads);
+
+            CHECK(g.edgeCount() == serial.edgeCount());
+            CHECK(edge_lists(g) == edge_lists(serial));
+            CHECK(describe(g) == describe(serial));
+            CHECK(g.memoryStats().adjacencySlackBytes == serial.memoryStats().adjacencySlackBytes);
+        }
+    }
+
+    SECTION( "a loaded csr graph freezes into the compact layout" )
+    {
+        test_help::CsrStrGraph added;
+        fill(added);
+        added.freeze();
+
+        test_help::CsrStrGraph g;
+        model::GraphBulkLoader<test_help::CsrStrGraph> loader(g);
+        load(loader);
+        loader.build(0);
+        g.freeze();
+
+        CHECK(g.storage().isFrozen());
+        CHECK(describe(g) == describe(added));
+    }
+
+    SECTION( "unknown ids throw before anything is added" )
+    {
+        test_help::StrGraph g;
+        model::GraphBulkLoader<test_help::StrGraph> loader(g);
+        loader.addNode(0, "odin");
+        loader.addEdge("parents", { 1, 0 });
+
+        CHECK_THROWS_AS(loader.build(), graph_error);
+        CHECK(g.nodeCount() == 0);
+        CHECK_THROWS_AS(loader.addEdge("parents", { 0 }), graph_error);
+    }
+}
+
+TEST_CASE( "::ugly::SmallVector keeps short lists inline", "[ugly::SmallVector]" )
+{
+    int values[5];
+    SmallVector<void*, 2> list;
+
+    list.push_back(&values[0]);
+    list.push_back(&values[2]);
+    CHECK(list.inlined());
+    list.insert(list.begin() + 1, &values[1]);
+    CHECK_FALSE(list.inlined());
+    CHECK_THAT(std::vector<void*>(list.begin(), list.end()), Equals(std::vector<void*> { &values[0], &values[1], &values[2] }));
+
+    auto copy = list;
+    list.erase(list.begin());
+    CHECK(list.size() == 2);
+    CHECK(list[0] == &values[1]);
+    CHECK(copy.size() == 3);
+
+    auto moved = std::move(copy);
+    CHECK(moved.size() == 3);
+    CHECK(copy.empty());
+    CHECK(copy.inlined());
+
+    SmallVector<void*, 0> lazy;
+    CHECK(sizeof(lazy) < sizeof(std::vector<void*>));
+    CHECK(lazy.begin() == lazy.end());
+    lazy.push_back(&values[4]);
+    CHECK(lazy.back() == &values[4]);
+
+    SECTION( "edges keep two nodes inline and spill hyperedges" )
+    {
+        test_help::StrGraph g;
+        test_help::fillStrGraphWithNorse(g);
+
+        CHECK(sizeof(storage::SimpleStorage::PerEdge) <= 2 * sizeof(std::vector<void*>));
+
+        size_t binary = 0, hyper = 0;
+        g.forAllEdges([&](auto e)
+        {
+            auto& nodes = e->store._nodes;
+            CHECK(nodes.inlined() == (nodes.size() <= 2));
+            (nodes.size() <= 2 ? binary : hyper)++;
+        });
+        CHECK(binary > 0);
+        CHECK(hyper > 0);
+    }
+
+    SECTION( "edge props are allocated with the first one" )
+    {
+        test_help::StrGraph g;
+        test_help::fillStrGraphWithNorse(g);
+
+        CHECK(sizeof(SmallVector<void*, 0>) == 2 * sizeof(void*));
+
+        auto e = const_cast<test_help::StrGraph::Edge*>(*g.edgesOnNode(findNode(g, "thor")).begin());
+        REQUIRE(g.propsOnEdge(e).empty());
+        CHECK(e->store._props.capacity() == 0);
+
+        g.addProp("famous", e);
+        CHECK(e->store._props.capacity() > 0);
+        CHECK((*g.propsOnEdge(e).begin())->data == "famous");
+    }
+}
@@ -44,3 +44,84 @@ TEST_CASE( "graph filters usable in ugly::query() builders", "[ugly::filters]" )
     }
 }
 
+TEST_CASE( "value filters use the edge partition index", "[ugly::filters]" )
+{
+    test_help::PartitionedStrGraph g;
+
+    test_help::fillStrGraphWithNorse(g);
+
+    auto thor = findNode(g, "thor");
+
+    CHECK(g.findEdgePredicate("parents") != test_help::PartitionedStrGraph::noPredicate);
+    CHECK(g.findEdgePredicate("not-a-predicate") == test_help::PartitionedStrGraph::noPredicate);
+
+    SECTION( ".in() jumps to the partition" )
+    {
+        auto r = query(&g)
+            .v(thor)
+            .in(f::byValue("parents"))
+            .run();
+
+        CHECK(r.size() == 3); // Thor has 3 children
+    }
+
+    SECTION( ".out() jumps to the partition" )
+    {
+        auto r = query(&g)
+            .v(thor)
+            .out(f::byValue("parents"))
+            .run();
+
+        CHECK(r.size() == 2); // Thor has 2 parents
+    }
+
+    SECTION( "unknown values match nothing" )
+    {
+        auto r = query(&g)
+            .v(thor)
+            .e(f::byValue("not-a-predicate"))
+            .run();
+
+        CHECK(r.size() == 0);
+    }
+
+    SECTION( "partitions follow removal and compaction" )
+    {
+        g.removeNode(findNode(g, "modi"));
+        g.compact();
+
+        auto r = query(&g)
+            .v(findNode(g, "thor"))
+            .in(f::byValue("parents"))
+            .run();
+
+        CHECK(r.size() == 2); // Thor has 2 children left
+        CHECK(findNode(g, "modi") == nullptr);
+    }
+
+    SECTION( "partitions follow attached nodes" )
+    {
+        auto loki = g.addNode("loki");
+        auto e = g.addEdge("parents", { thor, loki });
+        g.attachEdge(g.addNode("hel"), e, 0);
+
+        CHECK(g.outEdgesOnNodeWithPredicate(thor, g.findEdgePredicate("parents")).size() == 1);
+        CHECK(g.inEdgesOnNodeWithPredicate(loki, g.findEdgePredicate("parents")).size() == 1);
+    }
+
+    SECTION( "predicates without edges are released" )
+    {
+        auto creator = g.findEdgePredicate("creator");
+        std::vector<test_help::PartitionedStrGraph::Edge const*> edges;
+        g.forEdgesWithData("creator", [&](auto e) { edges.push_back(e); });
+        for (auto e : edges)
+            g.removeEdge(e);
+
+        CHECK(g.findEdgePredicate("creator") == test_help::PartitionedStrGraph::noPredicate);
+        CHECK(g.edgesOnNodeWithPredicate(findNode(g, "buri"), creator).empty());
+
+        g.addEdge("forged", { thor, findNode(g, "odin") });
+        CHECK(g.findEdgePredicate("forged") == creator);
+        CHECK(g.outEdgesOnNodeWithPredicate(thor, creator).size() == 1);
+    }
+}
@@ -10,6 +10,7 @@
 
 #include <string>
 #include <iostream>
+#include <set>
 
 using namespace ugly;
 using namespace Catch::Matchers;
@@ -585,3 +586,238 @@ TEST_CASE( "ugly::query() sub-queries", "[ugly::GraphQuery]" )
         REQUIRE(r.size() == 0);  // frigg is not related to someone licked into being
     }
 }
+
+TEST_CASE( "ugly::query() starting from the prop value index", "[ugly::GraphQuery]" )
+{
+    test_help::PropIndexedStrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    g.forAllNodes([&](auto n) { g.setProp(n, "status", n->data); });
+
+    SECTION( "equality lookups" )
+    {
+        auto r = query(&g)
+            .vWithProp("cow")
+            .run();
+        REQUIRE(r.size() == 1);
+        CHECK(r[0]->data == "audumbla");
+
+        auto parents = query(&g)
+            .vWithProp("status", "thor")
+            .out(filter::byValue("parents"))
+            .run();
+        CHECK(parents.size() == 2);
+    }
+
+    SECTION( "range and prefix lookups" )
+    {
+        auto r = query(&g)
+            .vWithPropInRange("status", "f", "g")
+            .run();
+        CHECK(r.size() == 6);
+
+        auto prefixed = query(&g)
+            .vWithPropPrefix("status", "th")
+            .run();
+        CHECK(prefixed.size() == 2);
+    }
+
+    SECTION( "lookups walk the index as they are pulled" )
+    {
+        auto first = query(&g)
+            .vWithPropInRange("status", "a", "z")
+            .take(2)
+            .run();
+        REQUIRE(first.size() == 2);
+        CHECK(first[0]->data == "annar");
+        CHECK(first[1]->data == "audumbla");
+
+        auto missing = query(&g)
+            .vWithProp("unknown", "thor")
+            .run();
+        CHECK(missing.size() == 0);
+    }
+}
+
+TEST_CASE( "ugly::query() starting from edges", "[ugly::GraphQuery]" )
+{
+    test_help::EdgeIndexedStrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto husbands = query(&g)
+        .vSourcesOf("married")
+        .run();
+    CHECK(husbands.size() == 6);
+
+    // the parents of every child, once each
+    auto parents = query(&g)
+        .vTargetsOf("parents")
+        .unique()
+        .run();
+
+    std::set<test_help::EdgeIndexedStrGraph::Node const*> expected;
+    g.forEdgesWithData("parents", [&](auto e)
+    {
+        for (auto n : g.targetNodesInEdge(e))
+            expected.insert(n);
+    });
+    CHECK(parents.size() == expected.size());
+}
+
+TEST_CASE( "ugly::query() paths", "[ugly::GraphQuery]" )
+{
+    test_help::StrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto is_parents = [](auto e) { return e->data == "parents"; };
+
+    auto describe = [&](auto path)
+    {
+        std::string res;
+        g.forNodesInPath(path, [&](auto n) { res += (res.empty() ? "" : " ") + n->data; });
+        return res;
+    };
+
+    SECTION( "queries without .path() store no paths" )
+    {
+        auto r = query(&g)
+            .v(findNode(g, "thor"))
+            .out(is_parents)
+            .out(is_parents)
+            .run();
+
+        CHECK(r.size() == 4);
+        CHECK(g.pathCount() == 0);
+    }
+
+    SECTION( ".path() materializes the walked paths" )
+    {
+        auto paths = query(&g)
+            .v(findNode(g, "thor"))
+            .out(is_parents)
+            .out(is_parents)
+            .path("lineage")
+            .runPaths();
+
+        REQUIRE(paths.size() == 4);
+        CHECK(g.pathCount() == 4);
+
+        std::set<std::string> described;
+        for (auto path : paths)
+        {
+            CHECK(path->data == "lineage");
+            CHECK(g.edgesInPath(path).size() == 2);
+            described.insert(describe(path));
+        }
+        CHECK(described == std::set<std::string> { "thor jord annar", "thor jord nott", "thor odin bestla", "thor odin burr" });
+
+        // the prefix is walked once, every path took the same first edge
+        CHECK(*g.edgesInPath(paths[0]).begin() == *g.edgesInPath(paths[3]).begin());
+    }
+
+    SECTION( ".path() results still run as their last node" )
+    {
+        auto r = query(&g)
+            .v(findNode(g, "frigg"))
+            .in(is_parents)
+            .path()
+            .run();
+
+        std::set<std::string> children;
+        for (auto n : r)
+            children.insert(n->data);
+        CHECK(children == std::set<std::string> { "hodr", "bragi" });
+        CHECK(g.pathCount() == 0);
+    }
+
+    SECTION( ".path() follows repeats" )
+    {
+        auto paths = query(&g)
+            .v(findNode(g, "thor"))
+            .repeat_breadth(
+                [&](auto _) { return _.out(is_parents); },
+                [](auto n) { return true; })
+            .path()
+            .runPaths();
+
+        std::set<std::string> described;
+        for (auto path : paths)
+        {
+            auto nodes = g.nodesInPath(path);
+            auto edges = g.edgesInPath(path);
+            CHECK(nodes.size() == edges.size() + 1);
+            described.insert(describe(path));
+        }
+        CHECK(described.count("thor odin") == 1);
+        CHECK(described.count("thor odin burr buri") == 1);
+        CHECK(described.count("thor jord nott") == 1);
+    }
+
+    SECTION( ".path() inside a repeat starts where the query starts" )
+    {
+        auto paths = query(&g)
+            .v(findNode(g, "thor"))
+            .out(is_parents)
+            .repeat_breadth(
+                [&](auto _) { return _.out(is_parents).path(); },
+                [](auto n) { return true; })
+            .runPaths();
+
+        REQUIRE(paths.size() > 0);
+        std::set<std::string> described;
+        for (auto path : paths)
+            described.insert(describe(path));
+        for (auto const& d : described)
+            CHECK(d.rfind("thor ", 0) == 0);
+        CHECK(described.count("thor odin burr buri") == 1);
+    }
+
+    SECTION( ".path() continues from the mark after jumping back" )
+    {
+        auto paths = query(&g)
+            .v(findNode(g, "thor"))
+            .out(is_parents)
+            .as("parent")
+            .out(is_parents)
+            .back("parent")
+            .path()
+            .runPaths();
+
+        REQUIRE(paths.size() == 4);
+        std::multiset<std::string> described;
+        for (auto path : paths)
+            described.insert(describe(path));
+        CHECK(described == std::multiset<std::string> { "thor jord", "thor jord", "thor odin", "thor odin" });
+    }
+
+    SECTION( ".path() continues from the mark after merging" )
+    {
+        auto paths = query(&g)
+            .v(findNode(g, "thor"))
+            .as("child")
+            .out(is_parents)
+            .as("parent")
+            .merge({ "child", "parent" })
+            .path()
+            .runPaths();
+
+        REQUIRE(paths.size() == 4);
+        std::multiset<std::string> described;
+        for (auto path : paths)
+            described.insert(describe(path));
+        CHECK(described == std::multiset<std::string> { "thor", "thor", "thor jord", "thor odin" });
+    }
+
+    SECTION( ".path() starts over on steps that jump to other nodes" )
+    {
+        auto paths = query(&g)
+            .v(findNode(g, "thor"))
+            .out(is_parents)
+            .v(findNode(g, "frigg"))
+            .path()
+            .runPaths();
+
+        REQUIRE(paths.size() == 1);
+        CHECK(describe(paths[0]) == "frigg");
+    }
+}
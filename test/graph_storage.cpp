@@ -0,0 +1,605 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "catch2/catch.hpp"
+
+#include "shared.h"
+
+#include "graph/graph.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <filesystem>
+
+using namespace ugly;
+using namespace Catch::Matchers;
+
+TEST_CASE( "::ugly::storage::CsrStorage behaves as a drop in storage", "[ugly::storage::CsrStorage]" )
+{
+    test_help::CsrStrGraph g;
+
+    test_help::fillStrGraphWithNorse(g);
+
+    auto thor = findNode(g, "thor");
+    auto buri = findNode(g, "buri");
+    REQUIRE(thor != nullptr);
+    REQUIRE(buri != nullptr);
+
+    auto run_queries = [&]()
+    {
+        auto r_parents = query(&g)
+            .v(thor)
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("parent")
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("grand-parent")
+            .merge({ "parent", "grand-parent" })
+            .unique()
+            .run();
+
+        CHECK(r_parents.size() == 6); // Thor has 2 + 4 parents-esque
+
+        auto r_children = query(&g)
+            .v(thor)
+            .in( [](auto e) { return e->data == "parents"; } )
+            .run();
+
+        CHECK(r_children.size() == 3); // Thor has 3 children
+
+        std::vector<std::string> props;
+        g.forEdgesOnNode(buri, [&](auto e)
+        {
+            g.forPropsOnEdge(e, [&](auto p) { props.push_back(p->data); });
+        });
+        CHECK_THAT(props, Equals(std::vector<std::string> { "licked-into-being" }));
+    };
+
+    SECTION( "while loading" )
+    {
+        run_queries();
+    }
+
+    SECTION( "once frozen" )
+    {
+        g.freeze();
+
+        CHECK(g.nodeCount() == 35);
+        run_queries();
+    }
+
+    SECTION( "once frozen, after attaching edges while loading" )
+    {
+        auto odin = findNode(g, "odin");
+        auto loki = g.addNode("loki");
+
+        auto e = g.addEdge("married", { odin, thor });
+        g.attachEdge(loki, e, 1);
+
+        g.freeze();
+
+        std::vector<std::string> nodes;
+        g.forNodesInEdge(e, [&](auto n) { nodes.push_back(n->data); });
+        CHECK_THAT(nodes, Equals(std::vector<std::string> { "odin", "loki", "thor" }));
+    }
+
+    SECTION( "once frozen, edges keep their roles" )
+    {
+        auto odin = findNode(g, "odin");
+        auto loki = g.addNode("loki");
+
+        auto e = g.addEdge("married", { odin, thor });
+        g.attachEdge(loki, e, 0);
+
+        g.freeze();
+
+        CHECK(*g.outEdgesOnNode(loki).begin() == e);
+
+        bool found = false;
+        g.forEdgesOnNode(odin, [&](auto edge) { found = found || edge == e; });
+        CHECK(found == true);
+
+        auto out = g.outEdgesOnNode(odin);
+        CHECK(std::find(out.begin(), out.end(), e) == out.end());
+        auto in = g.inEdgesOnNode(odin);
+        CHECK(std::find(in.begin(), in.end(), e) != in.end());
+    }
+
+    SECTION( "frozen storage rejects mutation" )
+    {
+        g.freeze();
+
+        REQUIRE_THROWS_AS( g.addNode("loki"), graph_error );
+        REQUIRE_THROWS_AS( g.addEdge("married", { thor, buri }), graph_error );
+
+        CHECK(g.nodeCount() == 35);
+        CHECK(g.edgeCount() == 24);
+    }
+
+    SECTION( "elements only carry their index" )
+    {
+        CHECK(sizeof(ugly::storage::CsrStorage::PerNode) == sizeof(uint32_t));
+        CHECK(sizeof(ugly::storage::CsrStorage::PerEdge) == sizeof(uint32_t));
+
+        g.freeze();
+
+        auto odin = findNode(g, "odin");
+        CHECK(g.outEdgesOnNode(odin).size() + g.inEdgesOnNode(odin).size() == g.edgesOnNode(odin).size());
+    }
+
+    SECTION( "props know their parent" )
+    {
+        auto audumbla = findNode(g, "audumbla");
+        g.freeze();
+
+        auto& storage = g.storage();
+        g.forPropsOnNode(audumbla, [&](auto p) { CHECK(storage.nodeOfProp<test_help::CsrStrGraph::Node>(p->store) == audumbla); });
+        g.forEdgesOnNode(buri, [&](auto e)
+        {
+            g.forPropsOnEdge(e, [&](auto p) { CHECK(storage.nodeOfProp<test_help::CsrStrGraph::Node>(p->store) == nullptr); });
+        });
+    }
+}
+
+TEST_CASE( "::ugly::storage::HandleStorage behaves as a drop in storage", "[ugly::storage::HandleStorage]" )
+{
+    test_help::HandleStrGraph g;
+
+    test_help::fillStrGraphWithNorse(g);
+
+    REQUIRE(g.nodeCount() == 35);
+
+    SECTION( "handles are dense and resolve to their nodes" )
+    {
+        size_t expected = 0;
+        g.forAllNodes([&](auto n)
+        {
+            CHECK(g.nodeHandle(n) == expected++);
+            CHECK(g.nodeFromHandle(g.nodeHandle(n)) == n);
+        });
+    }
+
+    SECTION( "relationships resolve through handles" )
+    {
+        auto audumbla = findNode(g, "audumbla");
+
+        std::vector<std::string> props;
+        g.forPropsOnNode(audumbla, [&](auto p) { props.push_back(p->data); });
+        CHECK_THAT(props, Equals(std::vector<std::string> { "animal", "cow" }));
+
+        std::vector<std::string> nodes;
+        g.forEdgesOnNode(audumbla, [&](auto e) { g.forNodesInEdge(e, [&](auto n) { nodes.push_back(n->data); }); });
+        CHECK_THAT(nodes, Equals(std::vector<std::string> { "buri", "audumbla" }));
+    }
+
+    SECTION( "props resolve their parent node" )
+    {
+        auto audumbla = findNode(g, "audumbla");
+
+        auto& storage = g.storage();
+        g.forPropsOnNode(audumbla, [&](auto p) { CHECK(storage.nodeOfProp<test_help::HandleStrGraph::Node>(p->store) == audumbla); });
+    }
+
+    SECTION( "queries run unchanged, unique uses a bitmap" )
+    {
+        auto r = query(&g)
+            .v(findNode(g, "thor"))
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("parent")
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("grand-parent")
+            .merge({ "parent", "grand-parent" })
+            .unique()
+            .run();
+
+        CHECK(r.size() == 6); // Thor has 2 + 4 parents-esque
+    }
+}
+
+TEST_CASE( "::ugly::storage::ArchetypeStorage behaves as a drop in storage", "[ugly::storage::ArchetypeStorage]" )
+{
+    test_help::ArchetypeStrGraph g;
+
+    test_help::fillStrGraphWithNorse(g);
+
+    REQUIRE(g.nodeCount() == 35);
+
+    auto& storage = g.storage();
+
+    SECTION( "every node is swept once" )
+    {
+        std::set<test_help::ArchetypeStrGraph::Node const*> seen;
+        size_t count = 0;
+        g.forAllNodes([&](auto n) { seen.insert(n); count++; });
+        CHECK(count == 35);
+        CHECK(seen.size() == 35);
+    }
+
+    SECTION( "nodes with the same signature share a table" )
+    {
+        auto a = g.addNode("a");
+        auto b = g.addNode("b");
+        auto c = g.addNode("c");
+        CHECK(storage.tableOfNode(a->store) == storage.tableOfNode(c->store));
+
+        g.addProp("x", a);
+        g.addProp("y", b);
+        CHECK(storage.tableOfNode(a->store) == storage.tableOfNode(b->store));
+        CHECK(storage.tableOfNode(a->store) != storage.tableOfNode(c->store));
+
+        auto label = g.addLabel("giant");
+        g.attachLabel(a, label);
+        g.attachLabel(a, label);
+        CHECK(storage.tableOfNode(a->store) != storage.tableOfNode(b->store));
+
+        std::vector<std::string> nodes;
+        g.forNodesInLabel(label, [&](auto n) { nodes.push_back(n->data); });
+        CHECK_THAT(nodes, Equals(std::vector<std::string> { "a" }));
+    }
+
+    SECTION( "attaching moves the row, not the node" )
+    {
+        auto audumbla = const_cast<test_help::ArchetypeStrGraph::Node*>(findNode(g, "audumbla"));
+        auto buri = findNode(g, "buri");
+        auto tables = storage.tableCount();
+
+        g.addProp("mother", audumbla);
+        g.attachLabel(audumbla, g.addLabel("primordial"));
+        CHECK(storage.tableCount() > tables);
+
+        CHECK(findNode(g, "audumbla") == audumbla);
+        CHECK(findNode(g, "buri") == buri);
+
+        std::vector<std::string> props;
+        g.forPropsOnNode(audumbla, [&](auto p) { props.push_back(p->data); });
+        CHECK_THAT(props, Equals(std::vector<std::string> { "animal", "cow", "mother" }));
+        g.forPropsOnNode(audumbla, [&](auto p) { CHECK(storage.nodeOfProp<test_help::ArchetypeStrGraph::Node>(p->store) == audumbla); });
+
+        std::vector<std::string> nodes;
+        g.forEdgesOnNode(audumbla, [&](auto e) { g.forNodesInEdge(e, [&](auto n) { nodes.push_back(n->data); }); });
+        CHECK_THAT(nodes, Equals(std::vector<std::string> { "buri", "audumbla" }));
+    }
+
+    SECTION( "queries run unchanged" )
+    {
+        auto r = query(&g)
+            .v(findNode(g, "thor"))
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("parent")
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("grand-parent")
+            .merge({ "parent", "grand-parent" })
+            .unique()
+            .run();
+
+        CHECK(r.size() == 6); // Thor has 2 + 4 parents-esque
+    }
+}
+
+TEST_CASE( "::ugly::storage::SegmentedStorage behaves as a drop in storage", "[ugly::storage::SegmentedStorage]" )
+{
+    test_help::SegmentedStrGraph g;
+
+    test_help::fillStrGraphWithNorse(g);
+
+    REQUIRE(g.nodeCount() == 35);
+
+    SECTION( "elements keep their address as blocks are added" )
+    {
+        auto thor = findNode(g, "thor");
+        for (size_t i = 0; i < 100; ++i)
+            g.addNode("filler-" + std::to_string(i));
+
+        CHECK(findNode(g, "thor") == thor);
+        CHECK(thor->data == "thor");
+
+        size_t count = 0;
+        g.forAllNodes([&](auto n) { count++; });
+        CHECK(count == 135);
+    }
+
+    SECTION( "removal and compaction reuse the blocks" )
+    {
+        g.removeNode(findNode(g, "odin"));
+        CHECK(g.nodeCount() == 34);
+        CHECK(findNode(g, "odin") == nullptr);
+
+        g.compact();
+        CHECK(g.nodeCount() == 34);
+        CHECK(findNode(g, "thor") != nullptr);
+        CHECK(g.memoryStats().nodes.slots == 34);
+    }
+
+    SECTION( "blocks are whole huge pages" )
+    {
+        using Store = ugly::storage::SegmentedStore<int, (size_t(2) << 20) / sizeof(int), true>;
+        CHECK(Store::blockBytes == Store::hugePageSize);
+
+        Store store;
+        for (int i = 0; i < 1000; ++i)
+            store.emplace_back(i);
+        CHECK(store[999] == 999);
+        CHECK(store.memoryBytes() >= Store::hugePageSize);
+    }
+
+    SECTION( "queries run unchanged" )
+    {
+        auto r = query(&g)
+            .v(findNode(g, "thor"))
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("parent")
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .as("grand-parent")
+            .merge({ "parent", "grand-parent" })
+            .unique()
+            .run();
+
+        CHECK(r.size() == 6); // Thor has 2 + 4 parents-esque
+    }
+}
+
+TEST_CASE( "::ugly::storage::ConcurrentStorage allows concurrent adds", "[ugly::storage::ConcurrentStorage]" )
+{
+    test_help::ConcurrentStrGraph g;
+
+    const size_t thread_count = 8;
+    const size_t per_thread = 200;
+
+    auto hub = g.addNode("hub");
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t i = 0; i < per_thread; ++i)
+            {
+                auto n = g.addNode("node-" + std::to_string(t) + "-" + std::to_string(i));
+                auto e = g.addEdge("spoke", { hub, n });
+                g.addProp("prop", n);
+                g.addProp("prop", e);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK(g.nodeCount() == thread_count * per_thread + 1);
+    CHECK(g.edgeCount() == thread_count * per_thread);
+    CHECK(g.propCount() == 2 * thread_count * per_thread);
+
+    CHECK(g.outEdgesOnNode(hub).size() == thread_count * per_thread);
+    CHECK(g.outEdgesOnNodeWithPredicate(hub, g.findEdgePredicate("spoke")).size() == thread_count * per_thread);
+    CHECK(findNode(g, "node-3-17") != nullptr);
+}
+
+TEST_CASE( "::ugly::storage storages account their memory", "[ugly::storage]" )
+{
+    auto check = [](auto& g)
+    {
+        test_help::fillStrGraphWithNorse(g);
+
+        auto stats = g.memoryStats();
+        CHECK(stats.nodes.count == g.nodeCount());
+        CHECK(stats.edges.count == g.edgeCount());
+        CHECK(stats.props.count == g.propCount());
+        CHECK(stats.nodes.bytes >= stats.nodes.count * stats.nodes.elementBytes);
+        CHECK(stats.adjacencyBytes > 0);
+        CHECK(stats.maxDegree > 0);
+        CHECK(stats.averageDegree > 0);
+    };
+
+    SECTION( "simple" ) { test_help::StrGraph g; check(g); }
+    SECTION( "csr" ) { test_help::CsrStrGraph g; check(g); }
+    SECTION( "handle" ) { test_help::HandleStrGraph g; check(g); }
+    SECTION( "archetype" ) { test_help::ArchetypeStrGraph g; check(g); }
+    SECTION( "versioned" ) { test_help::VersionedStrGraph g; check(g); }
+
+    SECTION( "frozen csr keeps no slack" )
+    {
+        test_help::CsrStrGraph g;
+        test_help::fillStrGraphWithNorse(g);
+        g.freeze();
+
+        auto stats = g.memoryStats();
+        CHECK(stats.adjacencyBytes > 0);
+        CHECK(stats.adjacencySlackBytes == 0);
+    }
+}
+
+TEST_CASE( "::ugly::storage::VersionedStorage gives readers consistent snapshots", "[ugly::storage::VersionedStorage]" )
+{
+    test_help::VersionedStrGraph g;
+    test_help::fillStrGraphWithNorse(g);
+
+    auto thor = findNode(g, "thor");
+
+    SECTION( "snapshots do not see later adds" )
+    {
+        auto snapshot = g.snapshot();
+
+        auto loki = g.addNode("loki");
+        g.addEdge("friends", { thor, loki });
+        g.addProp("trickster", loki);
+
+        CHECK(snapshot.nodeCount() == 35);
+        CHECK(snapshot.edgeCount() == 24);
+        CHECK(g.nodeCount() == 36);
+        CHECK(g.edgeCount() == 25);
+
+        CHECK(findNode(snapshot, "loki") == nullptr);
+
+        size_t snapshot_edges = 0;
+        snapshot.forAllEdges([&](auto e) { ++snapshot_edges; });
+        CHECK(snapshot_edges == 24);
+        CHECK(snapshot.edgesOnNode(thor).size() == g.edgesOnNode(thor).size() - 1);
+        CHECK(snapshot.outEdgesOnNode(thor).size() == g.outEdgesOnNode(thor).size() - 1);
+
+        auto later = g.snapshot();
+        CHECK(findNode(later, "loki") == loki);
+        CHECK(later.propsOnNode(loki).size() == 1);
+    }
+
+    SECTION( "queries run on snapshots" )
+    {
+        auto snapshot = g.snapshot();
+        g.addEdge("parents", { thor, g.addNode("bor") });
+
+        auto r = query(&snapshot)
+            .v(thor)
+            .out( [](auto n, auto e) { return e->data == "parents"; } )
+            .run();
+
+        CHECK(r.size() == 2);
+    }
+
+    SECTION( "replaced blocks are freed once no snapshot can see them" )
+    {
+        auto sif = g.addNode("sif-the-second");
+        {
+            auto snapshot = g.snapshot();
+            for (size_t i = 0; i < 64; ++i)
+                g.addProp("prop-" + std::to_string(i), sif);
+
+            CHECK(g.storage().retiredCount() > 0);
+            CHECK(snapshot.propsOnNode(sif).size() == 0);
+        }
+
+        g.addProp("last", sif);
+        CHECK(g.storage().retiredCount() == 0);
+    }
+
+    SECTION( "readers walk snapshots while a writer adds" )
+    {
+        const size_t added = 2000;
+        const size_t thor_out = g.outEdgesOnNode(thor).size();
+
+        std::thread writer([&]()
+        {
+            for (size_t i = 0; i < added; ++i)
+            {
+                auto n = g.addNode("node-" + std::to_string(i));
+                g.addEdge("spoke", { thor, n });
+            }
+        });
+
+        bool consistent = true;
+        while (consistent)
+        {
+            auto snapshot = g.snapshot();
+
+            // every node past the norse ones brings exactly one edge, added right after it
+            size_t nodes = 0;
+            snapshot.forAllNodes([&](auto n) { ++nodes; });
+            auto edges = snapshot.edgeCount();
+            auto spokes = snapshot.outEdgesOnNode(thor).size() - thor_out;
+            consistent = nodes == snapshot.nodeCount() && spokes == edges - 24 && (nodes - 35 == spokes || nodes - 35 == spokes + 1);
+
+            if (spokes == added)
+                break;
+        }
+        writer.join();
+
+        CHECK(consistent);
+        CHECK(g.snapshot().edgeCount() == 24 + added);
+    }
+}
+
+TEST_CASE( "::ugly::storage::MmapStorage keeps the graph in a file", "[ugly::storage::MmapStorage]" )
+{
+    auto path = (std::filesystem::temp_directory_path() / "ugly-mmap-storage-test.graph").string();
+    std::filesystem::remove(path);
+
+    const size_t spokes = 5000;
+    {
+        test_help::MmapIdGraph g(path);
+
+        auto hub = g.addNode(0);
+        for (uint64_t i = 1; i <= spokes; ++i)
+        {
+            auto n = g.addNode(i);
+            auto e = g.addEdge(i % 2, { hub, n }, i % 3 == 0);
+            g.addProp(i * 10, n);
+            g.addProp(i * 100, e);
+        }
+        g.addLabel(42);
+    }
+
+    SECTION( "reopening maps the graph back" )
+    {
+        test_help::MmapIdGraph g(path);
+
+        CHECK(g.nodeCount() == spokes + 1);
+        CHECK(g.edgeCount() == spokes);
+        CHECK(g.propCount() == 2 * spokes);
+        CHECK(g.labelCount() == 1);
+
+        // the node data index is built on first use
+        auto hub = findNode(g, 0);
+        auto n = findNode(g, 3);
+        REQUIRE(hub != nullptr);
+        REQUIRE(n != nullptr);
+
+        CHECK(g.edgesOnNode(hub).size() == spokes);
+        CHECK(g.outEdgesOnNode(hub).size() == spokes - spokes / 3);
+        CHECK(g.inEdgesOnNode(n).size() == 0);
+        CHECK(g.outEdgesOnNode(n).size() == 1);
+
+        auto e = *g.edgesOnNode(n).begin();
+        CHECK(g.isEdgeInverted(e));
+        CHECK((*g.propsOnEdge(e).begin())->data == 300);
+        CHECK((*g.propsOnNode(n).begin())->data == 30);
+        CHECK(*g.targetNodesInEdge(e).begin() == hub);
+
+        size_t edges = 0, odd_edges = 0;
+        g.forAllEdges([&](auto e) { ++edges; });
+        g.forEdgesWithData(1, [&](auto e) { ++odd_edges; });
+        CHECK(edges == spokes);
+        CHECK(odd_edges == spokes / 2);
+
+        auto stats = g.memoryStats();
+        CHECK(stats.nodes.count == spokes + 1);
+        CHECK(stats.edges.bytes >= spokes * stats.edges.elementBytes);
+        CHECK(stats.maxDegree == spokes);
+        CHECK(stats.storeBytes() + stats.adjacencyBytes + stats.adjacencySlackBytes + stats.reservedBytes <= std::filesystem::file_size(path));
+
+        g.addNode(spokes + 1);
+        CHECK(g.nodeCount() == spokes + 2);
+    }
+
+    SECTION( "adds right after reopening see the existing nodes" )
+    {
+        test_help::MmapIdGraph g(path);
+
+        CHECK_THROWS_AS(g.addNode(3), graph_error);
+        CHECK(g.nodeCount() == spokes + 1);
+    }
+
+    SECTION( "read only graphs can be queried" )
+    {
+        test_help::MmapIdGraph g(path, true);
+
+        auto r = query(&g)
+            .v(findNode(g, 0))
+            .out( [](auto n, auto e) { return e->data == 1; } )
+            .run();
+        CHECK(r.size() == 1667); // odd spokes not inverted
+
+        CHECK_THROWS_AS(g.addNode(spokes + 1), graph_error);
+    }
+
+    SECTION( "files of other graphs are rejected" )
+    {
+        using OtherConfig = model::ConfigBuilder<
+            model::DataCoreConfigBuilder<uint32_t, uint32_t>,
+            model::StorageConfigBuilder<storage::MmapStorage>
+        >;
+
+        CHECK_THROWS_AS(model::PathPropertyGraph<OtherConfig>(path), graph_error);
+    }
+
+    std::filesystem::remove(path);
+}